@@ -0,0 +1,823 @@
+#include <string.h>
+
+#include "aead.h"
+
+#if !defined(IAEAD_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IAEAD_X86 1
+#include <immintrin.h>
+#define IAEAD_TARGET(x) __attribute__((target(x)))
+#endif
+
+//---------------------------------------------------------------------
+// 工具函数
+//---------------------------------------------------------------------
+static IUINT32 iaead_load32(const unsigned char *p)
+{
+	return (IUINT32)p[0] | ((IUINT32)p[1] << 8) | ((IUINT32)p[2] << 16) | ((IUINT32)p[3] << 24);
+}
+
+static void iaead_store32(unsigned char *p, IUINT32 x)
+{
+	p[0] = (unsigned char)x;
+	p[1] = (unsigned char)(x >> 8);
+	p[2] = (unsigned char)(x >> 16);
+	p[3] = (unsigned char)(x >> 24);
+}
+
+static void iaead_store64(unsigned char *p, IUINT64 x)
+{
+	iaead_store32(p, (IUINT32)x);
+	iaead_store32(p + 4, (IUINT32)(x >> 32));
+}
+
+// 常数时间比较认证标签
+static int iaead_tag_equal(const unsigned char *a, const unsigned char *b)
+{
+	unsigned char diff = 0;
+	int i;
+
+	for (i = 0; i < IAEAD_TAG_SIZE; i++)
+		diff |= a[i] ^ b[i];
+
+	return diff == 0;
+}
+
+//---------------------------------------------------------------------
+// ChaCha20（RFC 8439）
+//---------------------------------------------------------------------
+#define ICHACHA_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define ICHACHA_QR(a, b, c, d) do { \
+		a += b; d ^= a; d = ICHACHA_ROTL(d, 16); \
+		c += d; b ^= c; b = ICHACHA_ROTL(b, 12); \
+		a += b; d ^= a; d = ICHACHA_ROTL(d, 8); \
+		c += d; b ^= c; b = ICHACHA_ROTL(b, 7); \
+	} while (0)
+
+// 初始状态：常量、密钥、块计数器、nonce
+static void ichacha_init(IUINT32 state[16], const IUINT32 key[8], IUINT32 counter, const unsigned char *nonce)
+{
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	memcpy(state + 4, key, 8 * sizeof(IUINT32));
+	state[12] = counter;
+	state[13] = iaead_load32(nonce);
+	state[14] = iaead_load32(nonce + 4);
+	state[15] = iaead_load32(nonce + 8);
+}
+
+// 计算一个64字节的密钥流块
+static void ichacha_block(const IUINT32 state[16], unsigned char out[64])
+{
+	IUINT32 x[16];
+	int i;
+
+	memcpy(x, state, sizeof(x));
+
+	for (i = 0; i < 10; i++)
+	{
+		ICHACHA_QR(x[0], x[4], x[8], x[12]);
+		ICHACHA_QR(x[1], x[5], x[9], x[13]);
+		ICHACHA_QR(x[2], x[6], x[10], x[14]);
+		ICHACHA_QR(x[3], x[7], x[11], x[15]);
+		ICHACHA_QR(x[0], x[5], x[10], x[15]);
+		ICHACHA_QR(x[1], x[6], x[11], x[12]);
+		ICHACHA_QR(x[2], x[7], x[8], x[13]);
+		ICHACHA_QR(x[3], x[4], x[9], x[14]);
+	}
+
+	for (i = 0; i < 16; i++)
+		iaead_store32(out + 4 * i, x[i] + state[i]);
+}
+
+// 可移植实现：data与密钥流异或
+static void ichacha_xor(IUINT32 state[16], unsigned char *data, int len)
+{
+	unsigned char block[64];
+	int i, n;
+
+	while (len > 0)
+	{
+		ichacha_block(state, block);
+		state[12]++;
+		n = len < 64 ? len : 64;
+		for (i = 0; i < n; i++)
+			data[i] ^= block[i];
+		data += n;
+		len -= n;
+	}
+}
+
+#ifdef IAEAD_X86
+// AVX2实现：每个寄存器按行保存两个块，两组寄存器同时计算4个块（256字节）
+IAEAD_TARGET("avx2")
+static void ichacha_xor_avx2(IUINT32 state[16], unsigned char *data, int len)
+{
+	const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+		3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+	__m256i s0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(state + 0)));
+	__m256i s1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(state + 4)));
+	__m256i s2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(state + 8)));
+	__m256i s3 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(state + 12)));
+	const __m256i inc01 = _mm256_setr_epi32(0, 0, 0, 0, 1, 0, 0, 0);
+	const __m256i inc23 = _mm256_setr_epi32(2, 0, 0, 0, 3, 0, 0, 0);
+	const __m256i inc4 = _mm256_setr_epi32(4, 0, 0, 0, 4, 0, 0, 0);
+
+	s3 = _mm256_add_epi32(s3, inc01);
+
+	while (len >= 256)
+	{
+		__m256i a0 = s0, b0 = s1, c0 = s2, d0 = s3;
+		__m256i a1 = s0, b1 = s1, c1 = s2, d1 = _mm256_add_epi32(s3, _mm256_sub_epi32(inc23, inc01));
+		__m256i d1s = d1;
+		int i;
+
+#define ICHACHA_AVX2_HALF(a, b, c, d) \
+		a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = _mm256_shuffle_epi8(d, rot16); \
+		c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); \
+		b = _mm256_or_si256(_mm256_slli_epi32(b, 12), _mm256_srli_epi32(b, 20)); \
+		a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = _mm256_shuffle_epi8(d, rot8); \
+		c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); \
+		b = _mm256_or_si256(_mm256_slli_epi32(b, 7), _mm256_srli_epi32(b, 25))
+
+		for (i = 0; i < 10; i++)
+		{
+			ICHACHA_AVX2_HALF(a0, b0, c0, d0);
+			ICHACHA_AVX2_HALF(a1, b1, c1, d1);
+			b0 = _mm256_shuffle_epi32(b0, _MM_SHUFFLE(0, 3, 2, 1));
+			c0 = _mm256_shuffle_epi32(c0, _MM_SHUFFLE(1, 0, 3, 2));
+			d0 = _mm256_shuffle_epi32(d0, _MM_SHUFFLE(2, 1, 0, 3));
+			b1 = _mm256_shuffle_epi32(b1, _MM_SHUFFLE(0, 3, 2, 1));
+			c1 = _mm256_shuffle_epi32(c1, _MM_SHUFFLE(1, 0, 3, 2));
+			d1 = _mm256_shuffle_epi32(d1, _MM_SHUFFLE(2, 1, 0, 3));
+			ICHACHA_AVX2_HALF(a0, b0, c0, d0);
+			ICHACHA_AVX2_HALF(a1, b1, c1, d1);
+			b0 = _mm256_shuffle_epi32(b0, _MM_SHUFFLE(2, 1, 0, 3));
+			c0 = _mm256_shuffle_epi32(c0, _MM_SHUFFLE(1, 0, 3, 2));
+			d0 = _mm256_shuffle_epi32(d0, _MM_SHUFFLE(0, 3, 2, 1));
+			b1 = _mm256_shuffle_epi32(b1, _MM_SHUFFLE(2, 1, 0, 3));
+			c1 = _mm256_shuffle_epi32(c1, _MM_SHUFFLE(1, 0, 3, 2));
+			d1 = _mm256_shuffle_epi32(d1, _MM_SHUFFLE(0, 3, 2, 1));
+		}
+
+#undef ICHACHA_AVX2_HALF
+
+		a0 = _mm256_add_epi32(a0, s0); b0 = _mm256_add_epi32(b0, s1);
+		c0 = _mm256_add_epi32(c0, s2); d0 = _mm256_add_epi32(d0, s3);
+		a1 = _mm256_add_epi32(a1, s0); b1 = _mm256_add_epi32(b1, s1);
+		c1 = _mm256_add_epi32(c1, s2); d1 = _mm256_add_epi32(d1, d1s);
+
+		// 低128位为第一个块，高128位为第二个块
+#define ICHACHA_AVX2_OUT(off, x, y, sel) \
+		_mm256_storeu_si256((__m256i*)(data + (off)), _mm256_xor_si256( \
+			_mm256_loadu_si256((const __m256i*)(data + (off))), _mm256_permute2x128_si256(x, y, sel)))
+
+		ICHACHA_AVX2_OUT(0, a0, b0, 0x20);
+		ICHACHA_AVX2_OUT(32, c0, d0, 0x20);
+		ICHACHA_AVX2_OUT(64, a0, b0, 0x31);
+		ICHACHA_AVX2_OUT(96, c0, d0, 0x31);
+		ICHACHA_AVX2_OUT(128, a1, b1, 0x20);
+		ICHACHA_AVX2_OUT(160, c1, d1, 0x20);
+		ICHACHA_AVX2_OUT(192, a1, b1, 0x31);
+		ICHACHA_AVX2_OUT(224, c1, d1, 0x31);
+
+#undef ICHACHA_AVX2_OUT
+
+		s3 = _mm256_add_epi32(s3, inc4);
+		state[12] += 4;
+		data += 256;
+		len -= 256;
+	}
+
+	// 剩余不足4个块
+	ichacha_xor(state, data, len);
+}
+#endif
+
+//---------------------------------------------------------------------
+// Poly1305：编译器支持128bit整数时用44bit分组（64bit乘法），否则用26bit分组（32bit乘法）
+//---------------------------------------------------------------------
+#if defined(__SIZEOF_INT128__)
+typedef unsigned __int128 IPOLYWIDE;
+
+static IUINT64 iaead_load64(const unsigned char *p)
+{
+	return (IUINT64)iaead_load32(p) | ((IUINT64)iaead_load32(p + 4) << 32);
+}
+
+typedef struct IPOLY
+{
+	IUINT64 r[3], h[3], pad[2];
+} IPOLY;
+
+static void ipoly_init(IPOLY *p, const unsigned char key[32])
+{
+	IUINT64 t0 = iaead_load64(key + 0);
+	IUINT64 t1 = iaead_load64(key + 8);
+
+	p->r[0] = t0 & 0xffc0fffffffULL;
+	p->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+	p->r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+	memset(p->h, 0, sizeof(p->h));
+	p->pad[0] = iaead_load64(key + 16);
+	p->pad[1] = iaead_load64(key + 24);
+}
+
+// 处理数据，最后不足16字节的部分补0（AEAD的输入都按16字节对齐）
+static void ipoly_update(IPOLY *p, const unsigned char *m, int len)
+{
+	const IUINT64 r0 = p->r[0], r1 = p->r[1], r2 = p->r[2];
+	const IUINT64 s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+	IUINT64 h0 = p->h[0], h1 = p->h[1], h2 = p->h[2];
+	unsigned char block[16];
+
+	while (len > 0)
+	{
+		IPOLYWIDE d0, d1, d2;
+		IUINT64 t0, t1, c;
+
+		if (len < 16)
+		{
+			memset(block, 0, sizeof(block));
+			memcpy(block, m, len);
+			m = block;
+			len = 16;
+		}
+
+		t0 = iaead_load64(m);
+		t1 = iaead_load64(m + 8);
+		h0 += t0 & 0xfffffffffffULL;
+		h1 += ((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL;
+		h2 += ((t1 >> 24) & 0x3ffffffffffULL) | ((IUINT64)1 << 40);
+
+		d0 = (IPOLYWIDE)h0 * r0 + (IPOLYWIDE)h1 * s2 + (IPOLYWIDE)h2 * s1;
+		d1 = (IPOLYWIDE)h0 * r1 + (IPOLYWIDE)h1 * r0 + (IPOLYWIDE)h2 * s2;
+		d2 = (IPOLYWIDE)h0 * r2 + (IPOLYWIDE)h1 * r1 + (IPOLYWIDE)h2 * r0;
+
+		c = (IUINT64)(d0 >> 44); h0 = (IUINT64)d0 & 0xfffffffffffULL;
+		d1 += c; c = (IUINT64)(d1 >> 44); h1 = (IUINT64)d1 & 0xfffffffffffULL;
+		d2 += c; c = (IUINT64)(d2 >> 42); h2 = (IUINT64)d2 & 0x3ffffffffffULL;
+		h0 += c * 5; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+		h1 += c;
+
+		m += 16;
+		len -= 16;
+	}
+
+	p->h[0] = h0; p->h[1] = h1; p->h[2] = h2;
+}
+
+static void ipoly_finish(IPOLY *p, unsigned char mac[16])
+{
+	IUINT64 h0 = p->h[0], h1 = p->h[1], h2 = p->h[2];
+	IUINT64 g0, g1, g2, c, t0, t1;
+
+	c = h1 >> 44; h1 &= 0xfffffffffffULL;
+	h2 += c; c = h2 >> 42; h2 &= 0x3ffffffffffULL;
+	h0 += c * 5; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+	h1 += c; c = h1 >> 44; h1 &= 0xfffffffffffULL;
+	h2 += c; c = h2 >> 42; h2 &= 0x3ffffffffffULL;
+	h0 += c * 5; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+	h1 += c;
+
+	// h - p：没有借位时取h - p
+	g0 = h0 + 5; c = g0 >> 44; g0 &= 0xfffffffffffULL;
+	g1 = h1 + c; c = g1 >> 44; g1 &= 0xfffffffffffULL;
+	g2 = h2 + c - ((IUINT64)1 << 42);
+
+	c = (g2 >> 63) - 1;
+	g0 &= c; g1 &= c; g2 &= c;
+	c = ~c;
+	h0 = (h0 & c) | g0;
+	h1 = (h1 & c) | g1;
+	h2 = (h2 & c) | g2;
+
+	t0 = p->pad[0];
+	t1 = p->pad[1];
+	h0 += t0 & 0xfffffffffffULL; c = h0 >> 44; h0 &= 0xfffffffffffULL;
+	h1 += (((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL) + c; c = h1 >> 44; h1 &= 0xfffffffffffULL;
+	h2 += ((t1 >> 24) & 0x3ffffffffffULL) + c; h2 &= 0x3ffffffffffULL;
+
+	iaead_store64(mac, h0 | (h1 << 44));
+	iaead_store64(mac + 8, (h1 >> 20) | (h2 << 24));
+}
+#else
+typedef struct IPOLY
+{
+	IUINT32 r[5], h[5], pad[4];
+} IPOLY;
+
+static void ipoly_init(IPOLY *p, const unsigned char key[32])
+{
+	p->r[0] = (iaead_load32(key + 0)) & 0x3ffffff;
+	p->r[1] = (iaead_load32(key + 3) >> 2) & 0x3ffff03;
+	p->r[2] = (iaead_load32(key + 6) >> 4) & 0x3ffc0ff;
+	p->r[3] = (iaead_load32(key + 9) >> 6) & 0x3f03fff;
+	p->r[4] = (iaead_load32(key + 12) >> 8) & 0x00fffff;
+	memset(p->h, 0, sizeof(p->h));
+	p->pad[0] = iaead_load32(key + 16);
+	p->pad[1] = iaead_load32(key + 20);
+	p->pad[2] = iaead_load32(key + 24);
+	p->pad[3] = iaead_load32(key + 28);
+}
+
+// 处理数据，最后不足16字节的部分补0（AEAD的输入都按16字节对齐）
+static void ipoly_update(IPOLY *p, const unsigned char *m, int len)
+{
+	const IUINT32 r0 = p->r[0], r1 = p->r[1], r2 = p->r[2], r3 = p->r[3], r4 = p->r[4];
+	const IUINT32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	IUINT32 h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4];
+	unsigned char block[16];
+
+	while (len > 0)
+	{
+		IUINT64 d0, d1, d2, d3, d4;
+		IUINT32 c;
+
+		if (len < 16)
+		{
+			memset(block, 0, sizeof(block));
+			memcpy(block, m, len);
+			m = block;
+			len = 16;
+		}
+
+		h0 += (iaead_load32(m + 0)) & 0x3ffffff;
+		h1 += (iaead_load32(m + 3) >> 2) & 0x3ffffff;
+		h2 += (iaead_load32(m + 6) >> 4) & 0x3ffffff;
+		h3 += (iaead_load32(m + 9) >> 6) & 0x3ffffff;
+		h4 += (iaead_load32(m + 12) >> 8) | (1 << 24);
+
+		d0 = (IUINT64)h0 * r0 + (IUINT64)h1 * s4 + (IUINT64)h2 * s3 + (IUINT64)h3 * s2 + (IUINT64)h4 * s1;
+		d1 = (IUINT64)h0 * r1 + (IUINT64)h1 * r0 + (IUINT64)h2 * s4 + (IUINT64)h3 * s3 + (IUINT64)h4 * s2;
+		d2 = (IUINT64)h0 * r2 + (IUINT64)h1 * r1 + (IUINT64)h2 * r0 + (IUINT64)h3 * s4 + (IUINT64)h4 * s3;
+		d3 = (IUINT64)h0 * r3 + (IUINT64)h1 * r2 + (IUINT64)h2 * r1 + (IUINT64)h3 * r0 + (IUINT64)h4 * s4;
+		d4 = (IUINT64)h0 * r4 + (IUINT64)h1 * r3 + (IUINT64)h2 * r2 + (IUINT64)h3 * r1 + (IUINT64)h4 * r0;
+
+		c = (IUINT32)(d0 >> 26); h0 = (IUINT32)d0 & 0x3ffffff;
+		d1 += c; c = (IUINT32)(d1 >> 26); h1 = (IUINT32)d1 & 0x3ffffff;
+		d2 += c; c = (IUINT32)(d2 >> 26); h2 = (IUINT32)d2 & 0x3ffffff;
+		d3 += c; c = (IUINT32)(d3 >> 26); h3 = (IUINT32)d3 & 0x3ffffff;
+		d4 += c; c = (IUINT32)(d4 >> 26); h4 = (IUINT32)d4 & 0x3ffffff;
+		h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+		h1 += c;
+
+		m += 16;
+		len -= 16;
+	}
+
+	p->h[0] = h0; p->h[1] = h1; p->h[2] = h2; p->h[3] = h3; p->h[4] = h4;
+}
+
+static void ipoly_finish(IPOLY *p, unsigned char mac[16])
+{
+	IUINT32 h0 = p->h[0], h1 = p->h[1], h2 = p->h[2], h3 = p->h[3], h4 = p->h[4];
+	IUINT32 g0, g1, g2, g3, g4, c, mask;
+	IUINT64 f;
+
+	c = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	// h - p：没有借位时取h - p
+	g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + c - (1 << 26);
+
+	mask = (g4 >> 31) - 1;
+	g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	h0 = h0 | (h1 << 26);
+	h1 = (h1 >> 6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 << 8);
+
+	f = (IUINT64)h0 + p->pad[0]; h0 = (IUINT32)f;
+	f = (IUINT64)h1 + p->pad[1] + (f >> 32); h1 = (IUINT32)f;
+	f = (IUINT64)h2 + p->pad[2] + (f >> 32); h2 = (IUINT32)f;
+	f = (IUINT64)h3 + p->pad[3] + (f >> 32); h3 = (IUINT32)f;
+
+	iaead_store32(mac + 0, h0);
+	iaead_store32(mac + 4, h1);
+	iaead_store32(mac + 8, h2);
+	iaead_store32(mac + 12, h3);
+}
+#endif
+
+// ChaCha20-Poly1305的认证标签：Poly1305(AD || pad16 || C || pad16 || len(AD) || len(C))，一次性密钥为第0块
+static void ichapoly_tag(const IUINT32 key[8], const unsigned char *nonce, const void *ad, int adlen,
+	const unsigned char *c, int len, unsigned char *tag)
+{
+	IUINT32 state[16];
+	unsigned char block[64];
+	unsigned char lens[16];
+	IPOLY poly;
+
+	ichacha_init(state, key, 0, nonce);
+	ichacha_block(state, block);
+	ipoly_init(&poly, block);
+
+	ipoly_update(&poly, (const unsigned char*)ad, adlen);
+	ipoly_update(&poly, c, len);
+	iaead_store64(lens, (IUINT64)adlen);
+	iaead_store64(lens + 8, (IUINT64)len);
+	ipoly_update(&poly, lens, 16);
+	ipoly_finish(&poly, tag);
+}
+
+// ChaCha20加密 / 解密（块计数器从1开始）
+static void ichapoly_xor(const IAEAD *ctx, const unsigned char *nonce, unsigned char *data, int len)
+{
+	IUINT32 state[16];
+
+	ichacha_init(state, ctx->key, 1, nonce);
+#ifdef IAEAD_X86
+	if (ctx->impl == IAEAD_IMPL_AVX2)
+	{
+		ichacha_xor_avx2(state, data, len);
+		return;
+	}
+#endif
+	ichacha_xor(state, data, len);
+}
+
+//---------------------------------------------------------------------
+// AES-128-GCM（AES-NI + PCLMULQDQ）
+//---------------------------------------------------------------------
+#ifdef IAEAD_X86
+#define IAES_TARGET IAEAD_TARGET("aes,pclmul,sse4.1")
+
+IAES_TARGET
+static __m128i iaes_expand(__m128i key, __m128i gen)
+{
+	gen = _mm_shuffle_epi32(gen, 0xff);
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+	return _mm_xor_si128(key, gen);
+}
+
+// 轮密钥在结构体中不保证16字节对齐
+IAES_TARGET
+static void iaes_load_rk(const IAEAD *ctx, __m128i rk[11])
+{
+	int i;
+
+	for (i = 0; i < 11; i++)
+		rk[i] = _mm_loadu_si128((const __m128i*)(ctx->rk + 16 * i));
+}
+
+IAES_TARGET
+static __m128i iaes_encrypt(const __m128i *rk, __m128i x)
+{
+	int i;
+
+	x = _mm_xor_si128(x, rk[0]);
+	for (i = 1; i < 10; i++)
+		x = _mm_aesenc_si128(x, rk[i]);
+	return _mm_aesenclast_si128(x, rk[10]);
+}
+
+// GF(2^128)乘法的无约简部分：256bit乘积累加到lo / hi（输入的字节序已反转）
+IAES_TARGET
+static void ighash_clmul(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+	__m128i t3, t4, t5, t6;
+
+	t3 = _mm_clmulepi64_si128(a, b, 0x00);
+	t4 = _mm_clmulepi64_si128(a, b, 0x10);
+	t5 = _mm_clmulepi64_si128(a, b, 0x01);
+	t6 = _mm_clmulepi64_si128(a, b, 0x11);
+	t4 = _mm_xor_si128(t4, t5);
+	t5 = _mm_slli_si128(t4, 8);
+	t4 = _mm_srli_si128(t4, 8);
+	*lo = _mm_xor_si128(*lo, _mm_xor_si128(t3, t5));
+	*hi = _mm_xor_si128(*hi, _mm_xor_si128(t6, t4));
+}
+
+// 约简：移位与约简都是线性的，多个乘积可以先累加再约简一次
+IAES_TARGET
+static __m128i ighash_reduce(__m128i t3, __m128i t6)
+{
+	__m128i t2, t4, t5, t7, t8, t9;
+
+	// 结果左移一位（反转的位序）
+	t7 = _mm_srli_epi32(t3, 31);
+	t8 = _mm_srli_epi32(t6, 31);
+	t3 = _mm_slli_epi32(t3, 1);
+	t6 = _mm_slli_epi32(t6, 1);
+	t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	t3 = _mm_or_si128(t3, t7);
+	t6 = _mm_or_si128(t6, t8);
+	t6 = _mm_or_si128(t6, t9);
+
+	// 模x^128 + x^7 + x^2 + x + 1约简
+	t7 = _mm_slli_epi32(t3, 31);
+	t8 = _mm_slli_epi32(t3, 30);
+	t9 = _mm_slli_epi32(t3, 25);
+	t7 = _mm_xor_si128(t7, t8);
+	t7 = _mm_xor_si128(t7, t9);
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	t3 = _mm_xor_si128(t3, t7);
+	t2 = _mm_srli_epi32(t3, 1);
+	t4 = _mm_srli_epi32(t3, 2);
+	t5 = _mm_srli_epi32(t3, 7);
+	t2 = _mm_xor_si128(t2, t4);
+	t2 = _mm_xor_si128(t2, t5);
+	t2 = _mm_xor_si128(t2, t8);
+	t3 = _mm_xor_si128(t3, t2);
+
+	return _mm_xor_si128(t6, t3);
+}
+
+// GF(2^128)乘法（输入输出的字节序已反转）
+IAES_TARGET
+static __m128i ighash_mul(__m128i a, __m128i b)
+{
+	__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+
+	ighash_clmul(a, b, &lo, &hi);
+	return ighash_reduce(lo, hi);
+}
+
+// GHASH：数据按16字节分组，最后不足16字节的部分补0；每4个分组乘以H^4..H^1后只约简一次
+IAES_TARGET
+static __m128i ighash_update(__m128i x, const __m128i *hp, const unsigned char *p, int len)
+{
+	const __m128i bswap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	__m128i h = hp[0];
+	unsigned char block[16];
+
+	for (; len >= 64; p += 64, len -= 64)
+	{
+		__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		__m128i b0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 0)), bswap);
+		__m128i b1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16)), bswap);
+		__m128i b2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 32)), bswap);
+		__m128i b3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 48)), bswap);
+		ighash_clmul(_mm_xor_si128(x, b0), hp[3], &lo, &hi);
+		ighash_clmul(b1, hp[2], &lo, &hi);
+		ighash_clmul(b2, hp[1], &lo, &hi);
+		ighash_clmul(b3, hp[0], &lo, &hi);
+		x = ighash_reduce(lo, hi);
+	}
+
+	for (; len >= 16; p += 16, len -= 16)
+		x = ighash_mul(_mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), bswap)), h);
+
+	if (len > 0)
+	{
+		memset(block, 0, sizeof(block));
+		memcpy(block, p, len);
+		x = ighash_mul(_mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)block), bswap)), h);
+	}
+
+	return x;
+}
+
+IAES_TARGET
+static void iaes_gcm_init(IAEAD *ctx, const unsigned char *key)
+{
+	const __m128i bswap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	__m128i rk[11], h, h2, h3, h4;
+
+	rk[0] = _mm_loadu_si128((const __m128i*)key);
+	rk[1] = iaes_expand(rk[0], _mm_aeskeygenassist_si128(rk[0], 0x01));
+	rk[2] = iaes_expand(rk[1], _mm_aeskeygenassist_si128(rk[1], 0x02));
+	rk[3] = iaes_expand(rk[2], _mm_aeskeygenassist_si128(rk[2], 0x04));
+	rk[4] = iaes_expand(rk[3], _mm_aeskeygenassist_si128(rk[3], 0x08));
+	rk[5] = iaes_expand(rk[4], _mm_aeskeygenassist_si128(rk[4], 0x10));
+	rk[6] = iaes_expand(rk[5], _mm_aeskeygenassist_si128(rk[5], 0x20));
+	rk[7] = iaes_expand(rk[6], _mm_aeskeygenassist_si128(rk[6], 0x40));
+	rk[8] = iaes_expand(rk[7], _mm_aeskeygenassist_si128(rk[7], 0x80));
+	rk[9] = iaes_expand(rk[8], _mm_aeskeygenassist_si128(rk[8], 0x1b));
+	rk[10] = iaes_expand(rk[9], _mm_aeskeygenassist_si128(rk[9], 0x36));
+
+	memcpy(ctx->rk, rk, sizeof(rk));
+	h = _mm_shuffle_epi8(iaes_encrypt(rk, _mm_setzero_si128()), bswap);
+	h2 = ighash_mul(h, h);
+	h3 = ighash_mul(h2, h);
+	h4 = ighash_mul(h3, h);
+	_mm_storeu_si128((__m128i*)(ctx->h + 0), h);
+	_mm_storeu_si128((__m128i*)(ctx->h + 16), h2);
+	_mm_storeu_si128((__m128i*)(ctx->h + 32), h3);
+	_mm_storeu_si128((__m128i*)(ctx->h + 48), h4);
+}
+
+// CTR模式：计数器块为nonce || 32bit大端计数器（从2开始，1用于认证标签）
+IAES_TARGET
+static void iaes_ctr(const IAEAD *ctx, const unsigned char *nonce, unsigned char *data, int len)
+{
+	unsigned char block[16];
+	__m128i rk[11], j0, ks;
+	IUINT32 ctr = 2;
+	int i;
+
+	iaes_load_rk(ctx, rk);
+
+	memcpy(block, nonce, IAEAD_NONCE_SIZE);
+	memset(block + IAEAD_NONCE_SIZE, 0, 4);
+	j0 = _mm_loadu_si128((const __m128i*)block);
+
+#define IAES_CTR_BLOCK(n) _mm_insert_epi32(j0, (int)(((ctr + (n)) >> 24) | (((ctr + (n)) >> 8) & 0xff00) | \
+		(((ctr + (n)) << 8) & 0xff0000) | ((ctr + (n)) << 24)), 3)
+
+	// 4个块同时计算，隐藏AES指令的延迟
+	for (; len >= 64; data += 64, len -= 64, ctr += 4)
+	{
+		__m128i k0 = _mm_xor_si128(IAES_CTR_BLOCK(0), rk[0]);
+		__m128i k1 = _mm_xor_si128(IAES_CTR_BLOCK(1), rk[0]);
+		__m128i k2 = _mm_xor_si128(IAES_CTR_BLOCK(2), rk[0]);
+		__m128i k3 = _mm_xor_si128(IAES_CTR_BLOCK(3), rk[0]);
+		for (i = 1; i < 10; i++)
+		{
+			k0 = _mm_aesenc_si128(k0, rk[i]);
+			k1 = _mm_aesenc_si128(k1, rk[i]);
+			k2 = _mm_aesenc_si128(k2, rk[i]);
+			k3 = _mm_aesenc_si128(k3, rk[i]);
+		}
+		k0 = _mm_aesenclast_si128(k0, rk[10]);
+		k1 = _mm_aesenclast_si128(k1, rk[10]);
+		k2 = _mm_aesenclast_si128(k2, rk[10]);
+		k3 = _mm_aesenclast_si128(k3, rk[10]);
+		_mm_storeu_si128((__m128i*)(data + 0), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + 0)), k0));
+		_mm_storeu_si128((__m128i*)(data + 16), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + 16)), k1));
+		_mm_storeu_si128((__m128i*)(data + 32), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + 32)), k2));
+		_mm_storeu_si128((__m128i*)(data + 48), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + 48)), k3));
+	}
+
+	for (; len > 0; data += 16, len -= 16, ctr++)
+	{
+		ks = iaes_encrypt(rk, IAES_CTR_BLOCK(0));
+		_mm_storeu_si128((__m128i*)block, ks);
+		for (i = 0; i < 16 && i < len; i++)
+			data[i] ^= block[i];
+	}
+
+#undef IAES_CTR_BLOCK
+}
+
+// 认证标签：GHASH(AD, C, 长度) ^ E(nonce || 1)
+IAES_TARGET
+static void iaes_gcm_tag(const IAEAD *ctx, const unsigned char *nonce, const void *ad, int adlen,
+	const unsigned char *c, int len, unsigned char *tag)
+{
+	const __m128i bswap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	__m128i x = _mm_setzero_si128();
+	__m128i rk[11], hp[4];
+	unsigned char block[16];
+	int i;
+
+	iaes_load_rk(ctx, rk);
+	for (i = 0; i < 4; i++)
+		hp[i] = _mm_loadu_si128((const __m128i*)(ctx->h + 16 * i));
+
+	x = ighash_update(x, hp, (const unsigned char*)ad, adlen);
+	x = ighash_update(x, hp, c, len);
+	// 长度块：大端的位数，字节序反转后高64位为AD长度
+	x = ighash_mul(_mm_xor_si128(x, _mm_set_epi64x((long long)adlen * 8, (long long)len * 8)), hp[0]);
+
+	memcpy(block, nonce, IAEAD_NONCE_SIZE);
+	block[12] = 0; block[13] = 0; block[14] = 0; block[15] = 1;
+	x = _mm_xor_si128(_mm_shuffle_epi8(x, bswap), iaes_encrypt(rk, _mm_loadu_si128((const __m128i*)block)));
+	_mm_storeu_si128((__m128i*)tag, x);
+}
+
+// 检测CPU是否支持AES-NI / PCLMULQDQ / AVX2
+static int iaead_cpu_aes(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+static int iaead_cpu_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+//---------------------------------------------------------------------
+// 接口
+//---------------------------------------------------------------------
+
+/* 初始化，CPU不支持该算法时返回-2（simd：0只使用可移植实现） */
+int iaead_init(IAEAD *ctx, int alg, const void *key, int keylen, int simd)
+{
+	const unsigned char *k = (const unsigned char*)key;
+	int i;
+
+	if (ctx == NULL || key == NULL)
+		return -1;
+
+	memset(ctx, 0, sizeof(IAEAD));
+
+	if (alg == IAEAD_CHACHA20_POLY1305)
+	{
+		if (keylen != 32)
+			return -1;
+		for (i = 0; i < 8; i++)
+			ctx->key[i] = iaead_load32(k + 4 * i);
+		ctx->alg = alg;
+		ctx->impl = IAEAD_IMPL_PORTABLE;
+#ifdef IAEAD_X86
+		if (simd && iaead_cpu_avx2())
+			ctx->impl = IAEAD_IMPL_AVX2;
+#endif
+		return 0;
+	}
+
+	if (alg == IAEAD_AES128_GCM)
+	{
+		if (keylen != 16)
+			return -1;
+#ifdef IAEAD_X86
+		if (simd && iaead_cpu_aes())
+		{
+			iaes_gcm_init(ctx, k);
+			ctx->alg = alg;
+			ctx->impl = IAEAD_IMPL_AESNI;
+			return 0;
+		}
+#endif
+		return -2;
+	}
+
+	return -1;
+}
+
+/* 加密：data原地加密，输出认证标签（IAEAD_TAG_SIZE字节） */
+void iaead_seal(const IAEAD *ctx, const unsigned char *nonce, const void *ad, int adlen, void *data, int len, unsigned char *tag)
+{
+	unsigned char *p = (unsigned char*)data;
+
+	if (ctx->alg == IAEAD_CHACHA20_POLY1305)
+	{
+		ichapoly_xor(ctx, nonce, p, len);
+		ichapoly_tag(ctx->key, nonce, ad, adlen, p, len, tag);
+	}
+#ifdef IAEAD_X86
+	else if (ctx->alg == IAEAD_AES128_GCM)
+	{
+		iaes_ctr(ctx, nonce, p, len);
+		iaes_gcm_tag(ctx, nonce, ad, adlen, p, len, tag);
+	}
+#endif
+}
+
+/* 解密：校验认证标签后原地解密，校验失败返回-1（data不变） */
+int iaead_open(const IAEAD *ctx, const unsigned char *nonce, const void *ad, int adlen, void *data, int len, const unsigned char *tag)
+{
+	unsigned char *p = (unsigned char*)data;
+	unsigned char expect[IAEAD_TAG_SIZE];
+
+	if (ctx->alg == IAEAD_CHACHA20_POLY1305)
+	{
+		ichapoly_tag(ctx->key, nonce, ad, adlen, p, len, expect);
+		if (!iaead_tag_equal(expect, tag))
+			return -1;
+		ichapoly_xor(ctx, nonce, p, len);
+		return 0;
+	}
+#ifdef IAEAD_X86
+	else if (ctx->alg == IAEAD_AES128_GCM)
+	{
+		iaes_gcm_tag(ctx, nonce, ad, adlen, p, len, expect);
+		if (!iaead_tag_equal(expect, tag))
+			return -1;
+		iaes_ctr(ctx, nonce, p, len);
+		return 0;
+	}
+#endif
+
+	return -1;
+}
+
+/* 实现名称 */
+const char* iaead_impl_name(const IAEAD *ctx)
+{
+	switch (ctx->impl)
+	{
+	case IAEAD_IMPL_AVX2: return "avx2";
+	case IAEAD_IMPL_AESNI: return "aesni";
+	}
+	return "portable";
+}
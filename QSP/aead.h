@@ -0,0 +1,57 @@
+#ifndef __AEAD_H_
+#define __AEAD_H_
+
+#include "typedef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// AEAD加密（带认证的加密）
+//=====================================================================
+// ChaCha20-Poly1305（RFC 8439）：可移植的C实现，CPU支持AVX2时ChaCha20
+// 每次并行计算4个块；AES-128-GCM：需要AES-NI与PCLMULQDQ指令，不支持时
+// 初始化失败（请改用ChaCha20-Poly1305）。数据原地加密 / 解密，解密时
+// 先校验认证标签，校验失败不修改数据。编译时定义IAEAD_NO_SIMD只使用
+// 可移植实现。
+//=====================================================================
+#define IAEAD_NONE 0					// 不加密
+#define IAEAD_CHACHA20_POLY1305 1		// ChaCha20-Poly1305，密钥32字节
+#define IAEAD_AES128_GCM 2				// AES-128-GCM，密钥16字节
+
+#define IAEAD_IMPL_PORTABLE 0			// 实现：可移植的C代码
+#define IAEAD_IMPL_AVX2 1				// 实现：AVX2（ChaCha20）
+#define IAEAD_IMPL_AESNI 2				// 实现：AES-NI + PCLMULQDQ（AES-GCM）
+
+#define IAEAD_NONCE_SIZE 12
+#define IAEAD_TAG_SIZE 16
+
+struct IAEAD
+{
+	int alg;							// IAEAD_CHACHA20_POLY1305等
+	int impl;							// IAEAD_IMPL_PORTABLE等
+	IUINT32 key[8];						// ChaCha20密钥（小端32bit字）
+	unsigned char rk[11 * 16];			// AES-128轮密钥
+	unsigned char h[4 * 16];			// GHASH密钥H^1..H^4（字节序已反转）
+};
+
+typedef struct IAEAD IAEAD;
+
+/* 初始化，CPU不支持该算法时返回-2（simd：0只使用可移植实现） */
+int iaead_init(IAEAD *ctx, int alg, const void *key, int keylen, int simd);
+
+/* 加密：data原地加密，输出认证标签（IAEAD_TAG_SIZE字节） */
+void iaead_seal(const IAEAD *ctx, const unsigned char *nonce, const void *ad, int adlen, void *data, int len, unsigned char *tag);
+
+/* 解密：校验认证标签后原地解密，校验失败返回-1（data不变） */
+int iaead_open(const IAEAD *ctx, const unsigned char *nonce, const void *ad, int adlen, void *data, int len, const unsigned char *tag);
+
+/* 实现名称 */
+const char* iaead_impl_name(const IAEAD *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__AEAD_H_
@@ -5,19 +5,19 @@
 extern "C" {
 #endif
 
-// malloc/freeӺĬΪգ
+// malloc/free钩子函数（默认为空）
 static void* (*__malloc_hook)(size_t) = 0;
 static void(*__free_hook)(void *) = 0;
 
-// ÷
+// 设置分配器
 #define set_allocator(malloc, free) \
 	__malloc_hook=malloc,__free_hook=free
 
-// ռ
+// 分配空间
 #define malloc_hook(size) \
 	__malloc_hook ? __malloc_hook(size) : malloc(size)
 
-// ͷſռ
+// 释放空间
 #define free_hook(ptr) \
 	__free_hook ? __free_hook(ptr) : free(ptr)
 
@@ -0,0 +1,54 @@
+#ifndef __ATOMIC_H_
+#define __ATOMIC_H_
+
+#include "typedef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// 原子操作（多个线程共享的计数器）
+//=====================================================================
+// iatomic_add32	32bit原子加，返回相加之前的值
+// iatomic_add64	64bit原子加，返回相加之前的值
+// iatomic_load32	32bit原子读
+// iatomic_load64	64bit原子读
+// iatomic_cas32	32bit比较并交换，成功返回非0
+// iatomic_casptr	指针比较并交换，成功返回非0
+// iatomic_fence	写屏障（之前的写入先于之后的写入对其他线程可见）
+//=====================================================================
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+#define iatomic_add32(ptr, val) \
+	((IUINT32)_InterlockedExchangeAdd((volatile long*)(ptr), (long)(val)))
+#define iatomic_add64(ptr, val) \
+	((IUINT64)_InterlockedExchangeAdd64((volatile __int64*)(ptr), (__int64)(val)))
+#define iatomic_load32(ptr) iatomic_add32(ptr, 0)
+#define iatomic_load64(ptr) iatomic_add64(ptr, 0)
+#define iatomic_cas32(ptr, oldval, newval) \
+	(_InterlockedCompareExchange((volatile long*)(ptr), (long)(newval), (long)(oldval)) == (long)(oldval))
+#define iatomic_casptr(ptr, oldval, newval) \
+	(_InterlockedCompareExchangePointer((void* volatile*)(ptr), (void*)(newval), (void*)(oldval)) == (void*)(oldval))
+#define iatomic_fence() _ReadWriteBarrier()
+
+#elif defined(__GNUC__)
+
+#define iatomic_add32(ptr, val) __sync_fetch_and_add((ptr), (val))
+#define iatomic_add64(ptr, val) __sync_fetch_and_add((ptr), (val))
+#define iatomic_load32(ptr) __sync_fetch_and_add((ptr), 0)
+#define iatomic_load64(ptr) __sync_fetch_and_add((ptr), 0)
+#define iatomic_cas32(ptr, oldval, newval) __sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#define iatomic_casptr(ptr, oldval, newval) __sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#define iatomic_fence() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+#else
+#error "atomic operations are not supported by this compiler"
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__ATOMIC_H_
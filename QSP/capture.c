@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "network.h"
+#include "log.h"
+#include "qsp.h"
+
+#define ICAP_MAGIC 0xa1b2c3d4		// 微秒时间戳
+#define ICAP_MAGIC_NS 0xa1b23c4d	// 纳秒时间戳
+#define ICAP_IP_SIZE 20
+#define ICAP_UDP_SIZE 8
+
+// pcap文件头
+struct ICAPHDR
+{
+	IUINT32 magic;
+	IUINT16 major, minor;
+	IINT32 zone;
+	IUINT32 sigfigs;
+	IUINT32 snaplen;
+	IUINT32 linktype;
+};
+
+// pcap数据包头
+struct ICAPREC
+{
+	IUINT32 sec, usec;
+	IUINT32 caplen, len;
+};
+
+static IUINT32 icap_swap32(IUINT32 x)
+{
+	return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+// 写入大端（网络字节序）整数
+static unsigned char* icap_put16(unsigned char *p, IUINT32 x)
+{
+	p[0] = (unsigned char)(x >> 8);
+	p[1] = (unsigned char)x;
+	return p + 2;
+}
+
+static unsigned char* icap_put32(unsigned char *p, IUINT32 x)
+{
+	p = icap_put16(p, x >> 16);
+	return icap_put16(p, x & 0xffff);
+}
+
+static IUINT32 icap_get16(const unsigned char *p)
+{
+	return ((IUINT32)p[0] << 8) | p[1];
+}
+
+static IUINT32 icap_get32(const unsigned char *p)
+{
+	return (icap_get16(p) << 16) | icap_get16(p + 2);
+}
+
+/* 创建pcap文件（写入） */
+ICAPTURE* icap_create(const char *path)
+{
+	struct ICAPHDR hdr;
+	ICAPTURE *cap;
+	FILE *fp;
+
+	if (path == NULL)
+	{
+		log_error("[icap_create : %d] : error, argument error", __LINE__);
+		return NULL;
+	}
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		log_error("[icap_create : %d] : error, open %s failed", __LINE__, path);
+		return NULL;
+	}
+
+	hdr.magic = ICAP_MAGIC;
+	hdr.major = 2;
+	hdr.minor = 4;
+	hdr.zone = 0;
+	hdr.sigfigs = 0;
+	hdr.snaplen = ICAP_SNAPLEN;
+	hdr.linktype = ICAP_LINKTYPE;
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	cap = (ICAPTURE*)malloc(sizeof(ICAPTURE));
+	memset(cap, 0, sizeof(ICAPTURE));
+	cap->fp = fp;
+	cap->write = 1;
+	return cap;
+}
+
+/* 打开pcap文件（读取） */
+ICAPTURE* icap_open(const char *path)
+{
+	struct ICAPHDR hdr;
+	ICAPTURE *cap;
+	FILE *fp;
+	int swap = 0, nano = 0;
+
+	if (path == NULL)
+	{
+		log_error("[icap_open : %d] : error, argument error", __LINE__);
+		return NULL;
+	}
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		log_error("[icap_open : %d] : error, open %s failed", __LINE__, path);
+		return NULL;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1)
+	{
+		log_error("[icap_open : %d] : error, %s is too short", __LINE__, path);
+		fclose(fp);
+		return NULL;
+	}
+
+	if (hdr.magic == ICAP_MAGIC) {}
+	else if (hdr.magic == ICAP_MAGIC_NS) nano = 1;
+	else if (hdr.magic == icap_swap32(ICAP_MAGIC)) swap = 1;
+	else if (hdr.magic == icap_swap32(ICAP_MAGIC_NS)) swap = 1, nano = 1;
+	else
+	{
+		log_error("[icap_open : %d] : error, %s is not a pcap file", __LINE__, path);
+		fclose(fp);
+		return NULL;
+	}
+
+	if ((swap ? icap_swap32(hdr.linktype) : hdr.linktype) != ICAP_LINKTYPE)
+	{
+		log_error("[icap_open : %d] : error, %s linktype is not raw ip", __LINE__, path);
+		fclose(fp);
+		return NULL;
+	}
+
+	cap = (ICAPTURE*)malloc(sizeof(ICAPTURE));
+	memset(cap, 0, sizeof(ICAPTURE));
+	cap->fp = fp;
+	cap->swap = swap;
+	cap->nano = nano;
+	return cap;
+}
+
+/* 关闭文件 */
+void icap_close(ICAPTURE *cap)
+{
+	if (cap == NULL)
+		return;
+
+	fclose(cap->fp);
+	free(cap);
+}
+
+/* 写入一个数据包 */
+int icap_write(ICAPTURE *cap, int dir, const void *buf, int len, IUINT64 us)
+{
+	unsigned char head[ICAP_IP_SIZE + ICAP_UDP_SIZE], *p = head;
+	struct ICAPREC rec;
+	IUINT32 sum = 0;
+	int i;
+
+	if (cap == NULL || !cap->write || buf == NULL || len < 0 || len > ICAP_SNAPLEN - (int)sizeof(head))
+	{
+		log_error("[icap_write : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	// IPv4头部
+	p = icap_put16(p, 0x4500);
+	p = icap_put16(p, (IUINT32)(sizeof(head) + len));
+	p = icap_put16(p, cap->id++ & 0xffff);
+	p = icap_put16(p, 0x4000);			// 不分片
+	p = icap_put16(p, 0x4011);			// TTL 64，UDP
+	p = icap_put16(p, 0);				// 校验和
+	p = icap_put32(p, dir == ICAP_OUT ? ICAP_LOCAL_ADDR : ICAP_PEER_ADDR);
+	p = icap_put32(p, dir == ICAP_OUT ? ICAP_PEER_ADDR : ICAP_LOCAL_ADDR);
+	for (i = 0; i < ICAP_IP_SIZE; i += 2)
+		sum += icap_get16(head + i);
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	icap_put16(head + 10, ~sum & 0xffff);
+
+	// UDP头部（不计算校验和）
+	p = icap_put16(p, dir == ICAP_OUT ? ICAP_LOCAL_PORT : ICAP_PEER_PORT);
+	p = icap_put16(p, dir == ICAP_OUT ? ICAP_PEER_PORT : ICAP_LOCAL_PORT);
+	p = icap_put16(p, (IUINT32)(ICAP_UDP_SIZE + len));
+	p = icap_put16(p, 0);
+
+	rec.sec = (IUINT32)(us / 1000000);
+	rec.usec = (IUINT32)(us % 1000000);
+	rec.caplen = rec.len = (IUINT32)(sizeof(head) + len);
+
+	fwrite(&rec, sizeof(rec), 1, cap->fp);
+	fwrite(head, sizeof(head), 1, cap->fp);
+	fwrite(buf, 1, len, cap->fp);
+	cap->count++;
+
+	return len;
+}
+
+/* 读取一个数据包 */
+int icap_read(ICAPTURE *cap, int *dir, void *buf, int maxlen, IUINT64 *us)
+{
+	unsigned char data[ICAP_SNAPLEN];
+	struct ICAPREC rec;
+
+	if (cap == NULL || cap->write || buf == NULL)
+	{
+		log_error("[icap_read : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, cap->fp) == 1)
+	{
+		IUINT32 src, ihl, len;
+
+		if (cap->swap)
+		{
+			rec.sec = icap_swap32(rec.sec);
+			rec.usec = icap_swap32(rec.usec);
+			rec.caplen = icap_swap32(rec.caplen);
+			rec.len = icap_swap32(rec.len);
+		}
+
+		if (rec.caplen > sizeof(data) || fread(data, 1, rec.caplen, cap->fp) != rec.caplen)
+		{
+			log_error("[icap_read : %d] : error, file is truncated", __LINE__);
+			return -1;
+		}
+
+		// 只读取IPv4 / UDP、本端与对端之间的数据包
+		ihl = (data[0] & 0x0f) * 4;
+		if (rec.caplen < ihl + ICAP_UDP_SIZE || (data[0] >> 4) != 4 || data[9] != 17)
+			continue;
+		src = icap_get32(data + 12);
+		if (src != ICAP_LOCAL_ADDR && src != ICAP_PEER_ADDR)
+			continue;
+
+		len = rec.caplen - ihl - ICAP_UDP_SIZE;
+		if ((int)len > maxlen)
+		{
+			log_error("[icap_read : %d] : error, packet is too large", __LINE__);
+			return -1;
+		}
+
+		memcpy(buf, data + ihl + ICAP_UDP_SIZE, len);
+		if (dir) *dir = src == ICAP_LOCAL_ADDR ? ICAP_OUT : ICAP_IN;
+		if (us) *us = (IUINT64)rec.sec * 1000000 + (cap->nano ? rec.usec / 1000 : rec.usec);
+		cap->count++;
+		return (int)len;
+	}
+
+	return 0;
+}
+
+// 命令名称
+static const char* icap_cmd_name(IUINT32 cmd)
+{
+	switch (cmd)
+	{
+	case QSP_CMD_PUSH: return "PUSH";
+	case QSP_CMD_ACK: return "ACK";
+	case QSP_CMD_AGAIN: return "AGAIN";
+	case QSP_CMD_WASK: return "WASK";
+	case QSP_CMD_WINS: return "WINS";
+	case QSP_CMD_DGRAM: return "DGRAM";
+	case QSP_CMD_DROP: return "DROP";
+	case QSP_CMD_HELLO: return "HELLO";
+	case QSP_CMD_COOKIE: return "COOKIE";
+	case QSP_CMD_PMTU: return "PMTU";
+	}
+	return "UNKNOWN";
+}
+
+/* 解析QSP数据包，输出一行文本 */
+int icap_dissect(const void *buf, int len, char *text, int size)
+{
+	const char *p = (const char*)buf;
+	IUINT32 conv, frg, ts, sn, msn;
+	IUINT16 cmd, ver, dlen, wnd, sid;
+	IUINT8 mode, flags;
+
+	if (buf == NULL || text == NULL || size <= 0)
+		return -1;
+
+	// 微双工模式的ACK只有一个字节（frg的低8位）
+	if (len == 1)
+		return snprintf(text, size, "WEAK ACK frg=%u", (unsigned)*(const unsigned char*)p);
+
+	if (len < (int)QSP_HEAD_SIZE)
+		return snprintf(text, size, "short packet len=%d", len);
+
+	p = qsp_decode32u(p, &conv);
+	p = qsp_decode32u(p, &frg);
+	p = qsp_decode32u(p, &ts);
+	p = qsp_decode32u(p, &sn);
+	p = qsp_decode16u(p, &cmd);
+	p = qsp_decode8u(p, &mode);
+	p = qsp_decode8u(p, &flags);
+	p = qsp_decode16u(p, &ver);
+	p = qsp_decode16u(p, &dlen);
+	p = qsp_decode16u(p, &wnd);
+	p = qsp_decode16u(p, &sid);
+	p = qsp_decode32u(p, &msn);
+
+	return snprintf(text, size, "conv=0x%08X %s mode=%s%s sid=%u msn=%u frg=%u sn=%u len=%u wnd=%u ts=%u ver=%u%s",
+		conv, icap_cmd_name(cmd),
+		mode == QSP_MODE_HALF ? "half" : mode == QSP_MODE_WEAK ? "weak" : mode == QSP_MODE_SINGLE ? "single" : "?",
+		(flags & QSP_FLAG_ZIP) ? " zip" : "",
+		sid, msn, frg, sn, dlen, wnd, ts, ver,
+		(int)dlen > len - (int)QSP_HEAD_SIZE ? " (truncated)" : "");
+}
@@ -0,0 +1,64 @@
+#ifndef __CAPTURE_H_
+#define __CAPTURE_H_
+
+#include <stdio.h>
+
+#include "typedef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// 数据包抓包（pcap格式）
+//=====================================================================
+// 会话收发的每个数据包加上IPv4 / UDP头部（LINKTYPE_RAW）写入pcap文件，
+// 可以直接用tcpdump / Wireshark打开（tools/qsp.lua解析QSP报文头部）。
+// 本端地址为ICAP_LOCAL_ADDR:ICAP_LOCAL_PORT，对端为ICAP_PEER_ADDR:
+// ICAP_PEER_PORT，读取时按源地址区分方向；时间戳为会话的systime。
+//=====================================================================
+#define ICAP_LOCAL_ADDR 0x0A000001	// 10.0.0.1
+#define ICAP_PEER_ADDR 0x0A000002	// 10.0.0.2
+#define ICAP_LOCAL_PORT 40001
+#define ICAP_PEER_PORT 40002
+#define ICAP_LINKTYPE 101			// LINKTYPE_RAW（IPv4）
+#define ICAP_SNAPLEN 65535
+
+#define ICAP_OUT 0					// 本端发送的数据包
+#define ICAP_IN 1					// 本端接收的数据包
+
+struct ICAPTURE
+{
+	FILE *fp;
+	int write;						// 1：写入，0：读取
+	int swap;						// 读取：文件字节序与本机不同
+	int nano;						// 读取：时间戳为纳秒
+	IUINT32 id;						// 写入：IPv4标识
+	IUINT64 count;					// 已经写入 / 读取的数据包数量
+};
+
+typedef struct ICAPTURE ICAPTURE;
+
+/* 创建pcap文件（写入） */
+ICAPTURE* icap_create(const char *path);
+
+/* 打开pcap文件（读取） */
+ICAPTURE* icap_open(const char *path);
+
+/* 关闭文件 */
+void icap_close(ICAPTURE *cap);
+
+/* 写入一个数据包（dir：ICAP_OUT / ICAP_IN，us：时间戳，微秒） */
+int icap_write(ICAPTURE *cap, int dir, const void *buf, int len, IUINT64 us);
+
+/* 读取一个数据包，返回UDP数据长度，文件结束返回0，错误返回-1（不是QSP抓包的数据包跳过） */
+int icap_read(ICAPTURE *cap, int *dir, void *buf, int maxlen, IUINT64 *us);
+
+/* 解析QSP数据包，输出一行文本，返回文本长度 */
+int icap_dissect(const void *buf, int len, char *text, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__CAPTURE_H_
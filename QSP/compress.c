@@ -0,0 +1,267 @@
+#include <string.h>
+
+#include "compress.h"
+
+#define ILZ_LAST_LITERALS 5			// 最后5个字节只能是字面量
+#define ILZ_MFLIMIT 12				// 最后12个字节内不再开始匹配
+#define ILZ_SKIP 6					// 连续2^6次找不到匹配后步长加1
+
+// 读取4字节（只用于比较与哈希，不关心字节序）
+static IUINT32 ilz_read32(const unsigned char *p)
+{
+	IUINT32 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// 从p与ref开始的相同字节数（不超过limit - p），每次比较8字节
+static int ilz_count(const unsigned char *p, const unsigned char *ref, const unsigned char *limit)
+{
+	const unsigned char *start = p;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+	while (limit - p >= 8)
+	{
+		IUINT64 a, b;
+		memcpy(&a, p, 8);
+		memcpy(&b, ref, 8);
+		if (a != b)
+			return (int)(p - start) + (__builtin_ctzll(a ^ b) >> 3);
+		p += 8;
+		ref += 8;
+	}
+#endif
+
+	while (p < limit && *p == *ref)
+	{
+		p++;
+		ref++;
+	}
+
+	return (int)(p - start);
+}
+
+static IUINT32 ilz_hash(IUINT32 v)
+{
+	return (v * 2654435761U) >> (32 - ILZ_HASH_LOG);
+}
+
+// 写入扩展长度（len已经减去15）
+static unsigned char* ilz_write_length(unsigned char *op, int len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+/* 压缩，返回压缩后的长度，cap不够（压缩后不小于cap）返回0 */
+int ilz_compress(const void *src, int len, void *dst, int cap)
+{
+	const unsigned char *base = (const unsigned char*)src;
+	const unsigned char *ip = base, *anchor = base, *end = base + len;
+	unsigned char *op = (unsigned char*)dst, *oend = op + cap;
+	IUINT32 table[1 << ILZ_HASH_LOG];
+	unsigned misses = 0;
+	int litlen;
+
+	if (src == NULL || dst == NULL || len < 0 || cap <= 0)
+		return 0;
+
+	memset(table, 0, sizeof(table));
+
+	// 太短的数据全部是字面量
+	if (len > ILZ_MFLIMIT)
+	{
+		const unsigned char *mflimit = end - ILZ_MFLIMIT, *matchlimit = end - ILZ_LAST_LITERALS;
+
+		ip++;
+		while (ip < mflimit)
+		{
+			const unsigned char *ref;
+			IUINT32 h = ilz_hash(ilz_read32(ip));
+			int mlen;
+
+			ref = base + table[h];
+			table[h] = (IUINT32)(ip - base);
+
+			if (ref >= ip || ip - ref > ILZ_MAX_OFFSET || ilz_read32(ref) != ilz_read32(ip))
+			{
+				ip += 1 + (misses++ >> ILZ_SKIP);
+				continue;
+			}
+			misses = 0;
+
+			// 向前、向后扩展匹配
+			while (ip > anchor && ref > base && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+			mlen = ILZ_MIN_MATCH + ilz_count(ip + ILZ_MIN_MATCH, ref + ILZ_MIN_MATCH, matchlimit);
+
+			// 序列的最大长度：token + 扩展长度 + 字面量 + 偏移 + 扩展长度
+			litlen = (int)(ip - anchor);
+			if ((oend - op) <= 1 + litlen / 255 + 1 + litlen + 2 + mlen / 255 + 1)
+				return 0;
+
+			{
+				unsigned char *token = op++;
+				*token = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+				if (litlen >= 15)
+					op = ilz_write_length(op, litlen - 15);
+				memcpy(op, anchor, litlen);
+				op += litlen;
+
+				*op++ = (unsigned char)(ip - ref);
+				*op++ = (unsigned char)((ip - ref) >> 8);
+
+				*token |= (unsigned char)(mlen - ILZ_MIN_MATCH >= 15 ? 15 : mlen - ILZ_MIN_MATCH);
+				if (mlen - ILZ_MIN_MATCH >= 15)
+					op = ilz_write_length(op, mlen - ILZ_MIN_MATCH - 15);
+			}
+
+			ip += mlen;
+			anchor = ip;
+
+			// 匹配的末尾也放入哈希表，提高下一次命中的概率
+			if (ip < mflimit)
+				table[ilz_hash(ilz_read32(ip - 2))] = (IUINT32)(ip - 2 - base);
+		}
+	}
+
+	// 最后的字面量
+	litlen = (int)(end - anchor);
+	if ((oend - op) <= 1 + litlen / 255 + 1 + litlen)
+		return 0;
+
+	*op++ = (unsigned char)((litlen >= 15 ? 15 : litlen) << 4);
+	if (litlen >= 15)
+		op = ilz_write_length(op, litlen - 15);
+	memcpy(op, anchor, litlen);
+	op += litlen;
+
+	return (int)(op - (unsigned char*)dst);
+}
+
+// 读取扩展长度，数据错误或者超过limit返回-1
+static int ilz_read_length(const unsigned char **ip, const unsigned char *iend, int len, int limit)
+{
+	unsigned char b;
+
+	do
+	{
+		if (*ip >= iend)
+			return -1;
+		b = *(*ip)++;
+		len += b;
+		if (len > limit)
+			return -1;
+	} while (b == 255);
+
+	return len;
+}
+
+/* 解压，返回解压后的长度，数据错误或者cap不够返回-1 */
+int ilz_decompress(const void *src, int len, void *dst, int cap)
+{
+	const unsigned char *ip = (const unsigned char*)src, *iend = ip + len;
+	unsigned char *base = (unsigned char*)dst, *op = base, *oend = base + cap;
+
+	if (src == NULL || dst == NULL || len <= 0 || cap < 0)
+		return -1;
+
+	while (1)
+	{
+		unsigned token = *ip++;
+		int litlen = token >> 4;
+		int mlen, offset;
+		const unsigned char *ref;
+
+		// 快速路径：短字面量 + 短匹配（最常见），整块复制，不逐项检查
+		if (litlen < 15 && (token & 15) < 15 && iend - ip >= 16 + 2 + 1 && oend - op >= 16 + 32)
+		{
+			memcpy(op, ip, 8);
+			memcpy(op + 8, ip + 8, 8);
+			op += litlen;
+			ip += litlen;
+
+			offset = ip[0] | (ip[1] << 8);
+			mlen = (token & 15) + ILZ_MIN_MATCH;
+			if (offset >= 8 && offset <= op - base)
+			{
+				ip += 2;
+				ref = op - offset;
+				memcpy(op, ref, 8);
+				memcpy(op + 8, ref + 8, 8);
+				memcpy(op + 16, ref + 16, 2);
+				op += mlen;
+				continue;
+			}
+
+			// 偏移小于8或者错误，按一般路径处理匹配
+			goto match;
+		}
+
+		if (litlen == 15 && (litlen = ilz_read_length(&ip, iend, litlen, cap)) < 0)
+			return -1;
+		if (litlen > iend - ip || litlen > oend - op)
+			return -1;
+
+		// 短字面量按16字节整块复制（输入与输出后面都有余量时）
+		if (litlen <= 16 && iend - ip >= 16 && oend - op >= 16)
+		{
+			memcpy(op, ip, 8);
+			memcpy(op + 8, ip + 8, 8);
+		}
+		else
+		{
+			memcpy(op, ip, litlen);
+		}
+		op += litlen;
+		ip += litlen;
+
+		// 最后一个序列只有字面量
+		if (ip == iend)
+			break;
+
+	match:
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - base)
+			return -1;
+
+		mlen = token & 15;
+		if (mlen == 15 && (mlen = ilz_read_length(&ip, iend, mlen, cap)) < 0)
+			return -1;
+		mlen += ILZ_MIN_MATCH;
+		if (mlen > oend - op)
+			return -1;
+
+		// 匹配可能与输出重叠（偏移小于长度时重复最近的数据），偏移不小于8时按8字节整块复制
+		ref = op - offset;
+		if (offset >= 8 && oend - op >= mlen + 8)
+		{
+			unsigned char *target = op + mlen;
+			do
+			{
+				memcpy(op, ref, 8);
+				op += 8;
+				ref += 8;
+			} while (op < target);
+			op = target;
+		}
+		else
+		{
+			while (mlen-- > 0)
+				*op++ = *ref++;
+		}
+
+		if (ip >= iend)
+			return -1;
+	}
+
+	return (int)(op - base);
+}
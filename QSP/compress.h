@@ -0,0 +1,34 @@
+#ifndef __COMPRESS_H_
+#define __COMPRESS_H_
+
+#include "typedef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// LZ压缩（LZ4块格式）
+//=====================================================================
+// 序列：token（高4位字面量长度，低4位匹配长度 - 4，为15时后面跟着
+// 255累加的扩展长度） + 字面量 + 2字节小端偏移 + 扩展匹配长度；最后
+// 一个序列只有字面量。压缩只做一次哈希查找（单遍、贪心），连续找不到
+// 匹配时加大步长，不可压缩的数据也很快；哈希表在栈上（16KB），不分配
+// 内存。解压检查所有边界，可以直接处理对端发来的数据。
+//=====================================================================
+#define ILZ_HASH_LOG 12				// 哈希表：2^12项
+#define ILZ_MIN_MATCH 4				// 最短匹配长度
+#define ILZ_MAX_OFFSET 65535		// 最大匹配距离
+#define ILZ_RATIO_MAX 255			// 最大压缩比（解压长度的合法上限）
+
+/* 压缩，返回压缩后的长度，cap不够（压缩后不小于cap）返回0 */
+int ilz_compress(const void *src, int len, void *dst, int cap);
+
+/* 解压，返回解压后的长度，数据错误或者cap不够返回-1 */
+int ilz_decompress(const void *src, int len, void *dst, int cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__COMPRESS_H_
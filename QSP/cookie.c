@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cookie.h"
+#include "network.h"
+#include "systime.h"
+
+#define ISIP_ROTL(x, b) (IUINT64)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define ISIP_ROUND(v0, v1, v2, v3) do { \
+		v0 += v1; v1 = ISIP_ROTL(v1, 13); v1 ^= v0; v0 = ISIP_ROTL(v0, 32); \
+		v2 += v3; v3 = ISIP_ROTL(v3, 16); v3 ^= v2; \
+		v0 += v3; v3 = ISIP_ROTL(v3, 21); v3 ^= v0; \
+		v2 += v1; v1 = ISIP_ROTL(v1, 17); v1 ^= v2; v2 = ISIP_ROTL(v2, 32); \
+	} while (0)
+
+// 读取64bit小端整数
+static IUINT64 isip_load64(const unsigned char *p)
+{
+	return (IUINT64)p[0] | ((IUINT64)p[1] << 8) | ((IUINT64)p[2] << 16) | ((IUINT64)p[3] << 24) |
+		((IUINT64)p[4] << 32) | ((IUINT64)p[5] << 40) | ((IUINT64)p[6] << 48) | ((IUINT64)p[7] << 56);
+}
+
+/* SipHash-2-4 */
+IUINT64 isiphash(const IUINT64 key[2], const void *data, int len)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	const unsigned char *end = p + (len & ~7);
+	IUINT64 v0 = key[0] ^ 0x736f6d6570736575ULL;
+	IUINT64 v1 = key[1] ^ 0x646f72616e646f6dULL;
+	IUINT64 v2 = key[0] ^ 0x6c7967656e657261ULL;
+	IUINT64 v3 = key[1] ^ 0x7465646279746573ULL;
+	IUINT64 m, b = (IUINT64)len << 56;
+	int i;
+
+	for (; p != end; p += 8)
+	{
+		m = isip_load64(p);
+		v3 ^= m;
+		ISIP_ROUND(v0, v1, v2, v3);
+		ISIP_ROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+
+	for (i = len & 7; i > 0; i--)
+		b |= (IUINT64)p[i - 1] << (8 * (i - 1));
+
+	v3 ^= b;
+	ISIP_ROUND(v0, v1, v2, v3);
+	ISIP_ROUND(v0, v1, v2, v3);
+	v0 ^= b;
+
+	v2 ^= 0xff;
+	ISIP_ROUND(v0, v1, v2, v3);
+	ISIP_ROUND(v0, v1, v2, v3);
+	ISIP_ROUND(v0, v1, v2, v3);
+	ISIP_ROUND(v0, v1, v2, v3);
+
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// 生成密钥：指定的secret经过哈希压缩为128bit，没有指定时读取系统随机源
+static void icookie_genkey(IUINT64 key[2], const void *secret, int len)
+{
+	static const IUINT64 seed[2] = { 0x5153502d636f6f6bULL, 0x69652d6b65792d30ULL };
+	unsigned char rnd[16];
+	FILE *fp;
+
+	if (secret != NULL && len > 0)
+	{
+		key[0] = isiphash(seed, secret, len);
+		key[1] = isiphash(key, secret, len);
+		return;
+	}
+
+	fp = fopen("/dev/urandom", "rb");
+	if (fp != NULL && fread(rnd, 1, sizeof(rnd), fp) == sizeof(rnd))
+	{
+		key[0] = isip_load64(rnd);
+		key[1] = isip_load64(rnd + 8);
+	}
+	else
+	{
+		// 没有系统随机源：混合时钟与地址（只能防止简单的猜测）
+		IUINT64 mix[2];
+		mix[0] = iclock_us();
+		mix[1] = (IUINT64)(size_t)key ^ (IUINT64)(size_t)&mix;
+		key[0] = isiphash(seed, mix, sizeof(mix));
+		mix[0] = iclock_us();
+		key[1] = isiphash(seed, mix, sizeof(mix));
+	}
+
+	if (fp != NULL)
+		fclose(fp);
+}
+
+/* 初始化密钥（secret为NULL时从系统随机源生成） */
+void icookie_init(ICOOKIE *ck, const void *secret, int len)
+{
+	memset(ck, 0, sizeof(ICOOKIE));
+	icookie_genkey(ck->key[0], secret, len);
+	ck->key[1][0] = ck->key[0][0];
+	ck->key[1][1] = ck->key[0][1];
+}
+
+/* 更换密钥，上一个密钥保留到下一次更换（secret为NULL时随机生成） */
+void icookie_rekey(ICOOKIE *ck, const void *secret, int len)
+{
+	ck->key[1][0] = ck->key[0][0];
+	ck->key[1][1] = ck->key[0][1];
+	icookie_genkey(ck->key[0], secret, len);
+}
+
+// 计算MAC：时间戳、会话编号、对端地址（超过ICOOKIE_ADDR_MAX的部分不参与计算）
+static IUINT64 icookie_mac(const IUINT64 key[2], IUINT32 conv, const void *addr, int addrlen, IUINT32 ts)
+{
+	char msg[8 + ICOOKIE_ADDR_MAX];
+	char *p = msg;
+
+	if (addr == NULL || addrlen < 0)
+		addrlen = 0;
+	if (addrlen > ICOOKIE_ADDR_MAX)
+		addrlen = ICOOKIE_ADDR_MAX;
+
+	p = qsp_encode32u(p, ts);
+	p = qsp_encode32u(p, conv);
+	if (addrlen > 0)
+		memcpy(p, addr, addrlen);
+
+	return isiphash(key, msg, 8 + addrlen);
+}
+
+/* 签发cookie（out：ICOOKIE_SIZE字节，ts：当前时间，毫秒） */
+void icookie_make(const ICOOKIE *ck, IUINT32 conv, const void *addr, int addrlen, IUINT32 ts, char *out)
+{
+	IUINT64 mac = icookie_mac(ck->key[0], conv, addr, addrlen, ts);
+
+	out = qsp_encode32u(out, ts);
+	out = qsp_encode32u(out, (IUINT32)mac);
+	qsp_encode32u(out, (IUINT32)(mac >> 32));
+}
+
+/* 校验cookie，返回ICOOKIE_OK / ICOOKIE_BAD / ICOOKIE_EXPIRED */
+int icookie_check(const ICOOKIE *ck, IUINT32 conv, const void *addr, int addrlen, IUINT32 current, const char *cookie)
+{
+	IUINT32 ts, lo, hi;
+	IUINT64 mac;
+	long age;
+
+	cookie = qsp_decode32u(cookie, &ts);
+	cookie = qsp_decode32u(cookie, &lo);
+	qsp_decode32u(cookie, &hi);
+	mac = ((IUINT64)hi << 32) | lo;
+
+	// 全0为对端还没有cookie
+	if (ts == 0 && mac == 0)
+		return ICOOKIE_EXPIRED;
+
+	if (mac != icookie_mac(ck->key[0], conv, addr, addrlen, ts) &&
+		mac != icookie_mac(ck->key[1], conv, addr, addrlen, ts))
+		return ICOOKIE_BAD;
+
+	// 只允许很小的时钟回退（时间戳是本端签发的）
+	age = _itimediff(current, ts);
+	if (age < -1000 || age > ICOOKIE_LIFE)
+		return ICOOKIE_EXPIRED;
+
+	return ICOOKIE_OK;
+}
@@ -0,0 +1,56 @@
+#ifndef __COOKIE_H_
+#define __COOKIE_H_
+
+#include "typedef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// 无状态准入cookie
+//=====================================================================
+// 服务端收到未知会话的数据包时不创建会话，只回复一个cookie：时间戳加上
+// 用服务端密钥对（时间戳、会话编号、对端地址）计算的MAC（SipHash-2-4，
+// 64bit）。对端原样带回cookie才创建会话，伪造源地址的对端收不到cookie。
+// 校验只需要一次哈希计算，不分配内存；更换密钥后上一个密钥签发的cookie
+// 在有效期内仍然可用。
+//=====================================================================
+#define ICOOKIE_SIZE 12				// cookie长度：时间戳（4字节） + MAC（8字节）
+#define ICOOKIE_LIFE 10000			// cookie的有效期，单位：毫秒
+#define ICOOKIE_ADDR_MAX 64			// 参与计算的对端地址最大长度（字节）
+
+#define ICOOKIE_OK 0				// 校验通过
+#define ICOOKIE_BAD -1				// MAC不符（伪造或者地址 / 会话编号不符）
+#define ICOOKIE_EXPIRED -2			// 超过有效期（或者为空），需要重新签发
+
+struct ICOOKIE
+{
+	IUINT64 key[2][2];				// 当前 / 上一个密钥（SipHash 128bit）
+	IUINT64 issued;					// 签发的cookie数量
+	IUINT64 accepted;				// 校验通过的数量
+	IUINT64 invalid;				// 校验失败或者格式错误而丢弃的数据包数量
+};
+
+typedef struct ICOOKIE ICOOKIE;
+
+/* 初始化密钥（secret为NULL时从系统随机源生成） */
+void icookie_init(ICOOKIE *ck, const void *secret, int len);
+
+/* 更换密钥，上一个密钥保留到下一次更换（secret为NULL时随机生成） */
+void icookie_rekey(ICOOKIE *ck, const void *secret, int len);
+
+/* 签发cookie（out：ICOOKIE_SIZE字节，ts：当前时间，毫秒） */
+void icookie_make(const ICOOKIE *ck, IUINT32 conv, const void *addr, int addrlen, IUINT32 ts, char *out);
+
+/* 校验cookie，返回ICOOKIE_OK / ICOOKIE_BAD / ICOOKIE_EXPIRED */
+int icookie_check(const ICOOKIE *ck, IUINT32 conv, const void *addr, int addrlen, IUINT32 current, const char *cookie);
+
+/* SipHash-2-4 */
+IUINT64 isiphash(const IUINT64 key[2], const void *data, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__COOKIE_H_
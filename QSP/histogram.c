@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "histogram.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// 最高有效位的位置（value != 0）
+static int ihist_msb(IUINT32 value)
+{
+#if defined(__GNUC__)
+	return 31 - __builtin_clz(value);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return (int)index;
+#else
+	int n = 0;
+	while (value >>= 1) n++;
+	return n;
+#endif
+}
+
+// 值所在的桶
+static int ihist_index(IUINT32 value)
+{
+	int shift;
+
+	if (value < IHIST_SUB_COUNT)
+		return (int)value;
+
+	shift = ihist_msb(value) - IHIST_SUB_BITS;
+	return ((shift + 1) << IHIST_SUB_BITS) + (int)((value >> shift) & (IHIST_SUB_COUNT - 1));
+}
+
+// 桶的上界（桶内的最大值）
+static IUINT32 ihist_upper(int index)
+{
+	int shift;
+
+	if (index < IHIST_SUB_COUNT)
+		return (IUINT32)index;
+
+	shift = (index >> IHIST_SUB_BITS) - 1;
+	return (IUINT32)((((IUINT64)(IHIST_SUB_COUNT + (index & (IHIST_SUB_COUNT - 1))) + 1) << shift) - 1);
+}
+
+/* 清空直方图 */
+void ihist_init(IHISTOGRAM *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+/* 记录一个值 */
+void ihist_record(IHISTOGRAM *h, IUINT32 value)
+{
+	if (h->count == 0 || value < h->min) h->min = value;
+	if (value > h->max) h->max = value;
+	h->count++;
+	h->sum += value;
+	h->bucket[ihist_index(value)]++;
+}
+
+/* 把src加到dst中 */
+void ihist_merge(IHISTOGRAM *dst, const IHISTOGRAM *src)
+{
+	int i;
+
+	if (src->count == 0)
+		return;
+
+	if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+	if (src->max > dst->max) dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+	for (i = 0; i < IHIST_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+}
+
+/* 百分位（p：0 ~ 100），返回所在桶的上界（不超过最大值），没有记录返回0 */
+IUINT32 ihist_percentile(const IHISTOGRAM *h, double p)
+{
+	IUINT64 rank, seen = 0;
+	int i;
+
+	if (h->count == 0)
+		return 0;
+
+	if (p < 0) p = 0;
+	if (p > 100) p = 100;
+
+	rank = (IUINT64)(p / 100 * h->count + 0.5);
+	if (rank < 1) rank = 1;
+
+	for (i = 0; i < IHIST_BUCKETS; i++)
+	{
+		seen += h->bucket[i];
+		if (seen >= rank)
+		{
+			IUINT32 upper = ihist_upper(i);
+			return upper < h->max ? upper : h->max;
+		}
+	}
+
+	return h->max;
+}
+
+/* 平均值 */
+IUINT32 ihist_mean(const IHISTOGRAM *h)
+{
+	return h->count ? (IUINT32)(h->sum / h->count) : 0;
+}
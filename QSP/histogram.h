@@ -0,0 +1,51 @@
+#ifndef __HISTOGRAM_H_
+#define __HISTOGRAM_H_
+
+#include "typedef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// 对数线性直方图（HDR风格）
+//=====================================================================
+// 小于2^IHIST_SUB_BITS的值每个值一个桶，更大的值每个2的幂次区间再平均
+// 分成2^IHIST_SUB_BITS个桶，相对误差不超过1/2^IHIST_SUB_BITS（6.25%）。
+// 记录是常数时间、不分配内存；直方图之间可以直接相加（合并多个会话、
+// 多个线程的数据之后再计算百分位）。
+//=====================================================================
+#define IHIST_SUB_BITS 4
+#define IHIST_SUB_COUNT (1 << IHIST_SUB_BITS)
+#define IHIST_BUCKETS ((32 - IHIST_SUB_BITS + 1) << IHIST_SUB_BITS)
+
+struct IHISTOGRAM
+{
+	IUINT64 count;					// 记录的数量
+	IUINT64 sum;					// 记录的值之和
+	IUINT32 min, max;				// 最小值 / 最大值
+	IUINT32 bucket[IHIST_BUCKETS];	// 各个桶的计数
+};
+
+typedef struct IHISTOGRAM IHISTOGRAM;
+
+/* 清空直方图 */
+void ihist_init(IHISTOGRAM *h);
+
+/* 记录一个值 */
+void ihist_record(IHISTOGRAM *h, IUINT32 value);
+
+/* 把src加到dst中 */
+void ihist_merge(IHISTOGRAM *dst, const IHISTOGRAM *src);
+
+/* 百分位（p：0 ~ 100），返回所在桶的上界（不超过最大值），没有记录返回0 */
+IUINT32 ihist_percentile(const IHISTOGRAM *h, double p);
+
+/* 平均值 */
+IUINT32 ihist_mean(const IHISTOGRAM *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__HISTOGRAM_H_
@@ -1,28 +1,287 @@
 #include "log.h"
+#include "atomic.h"
+#include "systime.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 
-// Զ־ص
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// 队列中的一条日志（seq：有界无锁队列的序号，等于写入位置 + 1时可读，等于读取位置 + 队列长度时可写）
+struct ILOGSLOT
+{
+	volatile IUINT32 seq;
+	int level;
+	char text[ILOG_TEXT_SIZE];
+};
+
+typedef struct ILOGSLOT ILOGSLOT;
+
+volatile int ilog_level = ILOG_INFO;
+
+// 自定义日志输出回调函数
 void(*__write_log)(const char *log) = NULL;
 
-// logĻص
+static const char *ilog_names[ILOG_NONE] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+static ILOGSLOT ilog_queue[ILOG_QUEUE_SIZE];
+static volatile IUINT32 ilog_head = 0;			// 下一个写入位置（多个线程竞争）
+static volatile IUINT32 ilog_tail = 0;			// 下一个读取位置（只有后台线程读取）
+static volatile IUINT64 ilog_ndropped = 0;
+static volatile IUINT32 ilog_state = 0;			// 0：没有初始化，1：正在初始化，2：后台线程运行中，3：已经停止
+static volatile int ilog_async = 1;
+
+#if defined(_WIN32)
+static HANDLE ilog_thread;
+#else
+static pthread_t ilog_thread;
+#endif
+
+// 输出一条日志
+static void ilog_output(int level, const char *text)
+{
+	if (__write_log)
+		__write_log(text);
+	else
+		printf("[default log] [%s] : %s\n", ilog_names[level], text);
+}
+
+// 输出队列中所有可读的日志（只在后台线程中调用，或者后台线程停止之后）
+static int ilog_drain(void)
+{
+	int n = 0;
+
+	while (1)
+	{
+		IUINT32 tail = iatomic_load32(&ilog_tail);
+		ILOGSLOT *slot = &ilog_queue[tail & (ILOG_QUEUE_SIZE - 1)];
+		if (iatomic_load32(&slot->seq) != tail + 1)
+			break;
+
+		// 输出之后释放位置：seq从读取位置 + 1变为读取位置 + 队列长度
+		ilog_output(slot->level, slot->text);
+		iatomic_add32(&slot->seq, ILOG_QUEUE_SIZE - 1);
+		iatomic_add32(&ilog_tail, 1);
+		n++;
+	}
+
+	return n;
+}
+
+// 后台线程：队列为空时睡眠1毫秒
+#if defined(_WIN32)
+static DWORD WINAPI ilog_worker(LPVOID arg)
+#else
+static void* ilog_worker(void *arg)
+#endif
+{
+	(void)arg;
+
+	while (iatomic_load32(&ilog_state) == 2)
+	{
+		if (ilog_drain() == 0)
+			isleep(1);
+	}
+	ilog_drain();
+	return 0;
+}
+
+// 进程退出时停止后台线程，输出剩余的日志
+static void ilog_stop(void)
+{
+	if (!iatomic_cas32(&ilog_state, 2, 3))
+		return;
+
+#if defined(_WIN32)
+	WaitForSingleObject(ilog_thread, INFINITE);
+	CloseHandle(ilog_thread);
+#else
+	pthread_join(ilog_thread, NULL);
+#endif
+}
+
+// 第一次输出日志时初始化队列，启动后台线程（启动失败时在调用线程中直接输出）
+static int ilog_start(void)
+{
+	IUINT32 i;
+
+	if (iatomic_load32(&ilog_state) != 0 || !iatomic_cas32(&ilog_state, 0, 1))
+		return iatomic_load32(&ilog_state) == 2;
+
+	for (i = 0; i < ILOG_QUEUE_SIZE; i++)
+		ilog_queue[i].seq = i;
+
+	// 后台线程在状态为2时运行，先设置状态再创建线程
+	iatomic_cas32(&ilog_state, 1, 2);
+#if defined(_WIN32)
+	ilog_thread = CreateThread(NULL, 0, ilog_worker, NULL, 0, NULL);
+	if (ilog_thread == NULL)
+		iatomic_cas32(&ilog_state, 2, 3);
+#else
+	if (pthread_create(&ilog_thread, NULL, ilog_worker, NULL) != 0)
+		iatomic_cas32(&ilog_state, 2, 3);
+#endif
+
+	if (iatomic_load32(&ilog_state) != 2)
+		return 0;
+
+	atexit(ilog_stop);
+	return 1;
+}
+
+// 原子地把计数器清零，返回清零之前的值
+static unsigned int ilog_take32(volatile unsigned int *ptr)
+{
+	unsigned int value;
+
+	do
+	{
+		value = iatomic_load32(ptr);
+	} while (!iatomic_cas32(ptr, value, 0));
+
+	return value;
+}
+
+// 限速：返回是否输出，*suppressed为之前被限速的条数（多个线程同时调用时各字段都是原子操作）
+static int ilog_site_allow(ILOGSITE *site, IUINT32 *suppressed)
+{
+	IUINT32 now = iclock(), ts;
+
+	*suppressed = 0;
+	if (site == NULL)
+		return 1;
+
+	// 新的统计周期：只有交换成功的线程把计数清零
+	ts = iatomic_load32(&site->ts);
+	if ((now - ts >= 1000 || ts == 0) && iatomic_cas32(&site->ts, ts, now ? now : 1))
+		ilog_take32(&site->count);
+
+	if (iatomic_add32(&site->count, 1) >= ILOG_SITE_RATE)
+	{
+		iatomic_add32(&site->suppressed, 1);
+		return 0;
+	}
+
+	*suppressed = ilog_take32(&site->suppressed);
+	return 1;
+}
+
+// 格式化一条日志
+static void ilog_format(char *text, IUINT32 suppressed, const char *fmt, va_list argptr)
+{
+	int len = vsnprintf(text, ILOG_TEXT_SIZE, fmt, argptr);
+
+	if (len < 0)
+		len = 0;
+	if (suppressed && len < ILOG_TEXT_SIZE - 1)
+		snprintf(text + len, ILOG_TEXT_SIZE - len, " (suppressed %u)", suppressed);
+}
+
+// 格式化并放入队列，队列满时丢弃
+static void ilog_vwrite(int level, ILOGSITE *site, const char *fmt, va_list argptr)
+{
+	IUINT32 suppressed, pos;
+	ILOGSLOT *slot;
+
+	if (level < ilog_level || level >= ILOG_NONE)
+		return;
+
+	if (!ilog_site_allow(site, &suppressed))
+		return;
+
+	// 同步输出（关闭了后台线程，或者后台线程启动失败）
+	if (!ilog_async || !ilog_start())
+	{
+		char text[ILOG_TEXT_SIZE];
+		ilog_format(text, suppressed, fmt, argptr);
+		ilog_output(level, text);
+		return;
+	}
+
+	// 占用一个可写的位置
+	pos = iatomic_load32(&ilog_head);
+	while (1)
+	{
+		IUINT32 seq;
+		slot = &ilog_queue[pos & (ILOG_QUEUE_SIZE - 1)];
+		seq = iatomic_load32(&slot->seq);
+		if (seq == pos)
+		{
+			if (iatomic_cas32(&ilog_head, pos, pos + 1))
+				break;
+		}
+		else if ((IINT32)(seq - pos) < 0)
+		{
+			iatomic_add64(&ilog_ndropped, 1);
+			return;
+		}
+		pos = iatomic_load32(&ilog_head);
+	}
+
+	// 写入之后发布：seq从写入位置变为写入位置 + 1
+	slot->level = level;
+	ilog_format(slot->text, suppressed, fmt, argptr);
+	iatomic_add32(&slot->seq, 1);
+}
+
+// 设置log输出的回调函数
 void set_outlog(void(*write_log_func)(const char *log))
 {
 	__write_log = write_log_func;
 }
 
-// ӡlog־
+// 打印log日志
 void write_log(const char * fmt, ...)
 {
-	char buffer[4096];
 	va_list argptr;
 	va_start(argptr, fmt);
-	vsprintf(buffer, fmt, argptr);
+	ilog_vwrite(ILOG_ERROR, NULL, fmt, argptr);
 	va_end(argptr);
+}
 
-	if (__write_log)
-		__write_log(buffer);
-	else
-		printf("[default log] : %s\n", buffer);
+// 打印指定级别的日志
+void ilog_write(int level, ILOGSITE *site, const char *fmt, ...)
+{
+	va_list argptr;
+	va_start(argptr, fmt);
+	ilog_vwrite(level, site, fmt, argptr);
+	va_end(argptr);
+}
+
+// 设置运行时的最低级别
+void ilog_setlevel(int level)
+{
+	ilog_level = level < ILOG_DEBUG ? ILOG_DEBUG : level > ILOG_NONE ? ILOG_NONE : level;
+}
+
+// 设置是否使用后台线程输出
+void ilog_setasync(int async)
+{
+	if (!async)
+		ilog_flush();
+	ilog_async = async ? 1 : 0;
+}
+
+// 等待队列中的日志全部输出（后台线程已经停止时直接输出）
+void ilog_flush(void)
+{
+	if (iatomic_load32(&ilog_state) == 3)
+	{
+		ilog_drain();
+		return;
+	}
+
+	while (iatomic_load32(&ilog_state) == 2 && iatomic_load32(&ilog_tail) != iatomic_load32(&ilog_head))
+		isleep(1);
+}
+
+// 队列满而丢弃的日志条数
+unsigned long long ilog_dropped(void)
+{
+	return (unsigned long long)iatomic_load64(&ilog_ndropped);
 }
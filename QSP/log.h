@@ -1,17 +1,105 @@
 #ifndef __LOG_H_
 #define __LOG_H_
 
-// VSֹ
+// VS编译器禁止警告
 #ifdef _MSC_VER
 #pragma warning(disable:4311)
 #pragma warning(disable:4312)
 #pragma warning(disable:4996)
 #endif
 
-// logĻص
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// 分级日志
+//=====================================================================
+// 调用线程只做级别判断、限速与格式化，格式化后的日志放入有界无锁队列，
+// 由后台线程交给输出回调函数（set_outlog），队列满时丢弃并计数，
+// 调用线程不会被输出阻塞。
+// 低于ILOG_MIN_LEVEL（编译时定义）的日志编译为空，低于ilog_setlevel
+// 设置的级别在运行时跳过；同一调用位置每秒最多输出ILOG_SITE_RATE条，
+// 被限速的条数附在下一条输出的日志后面。
+//=====================================================================
+#define ILOG_DEBUG 0
+#define ILOG_INFO 1
+#define ILOG_WARN 2
+#define ILOG_ERROR 3
+#define ILOG_NONE 4
+
+#ifndef ILOG_MIN_LEVEL
+#define ILOG_MIN_LEVEL ILOG_DEBUG	// 编译时保留的最低级别
+#endif
+
+#define ILOG_SITE_RATE 10			// 同一调用位置每秒最多输出的日志条数
+#define ILOG_QUEUE_SIZE 1024		// 队列长度（2的幂）
+#define ILOG_TEXT_SIZE 256			// 每条日志的最大长度（超过截断）
+
+// 调用位置的限速状态（由日志宏定义为静态变量，多个线程通过原子操作更新）
+struct ILOGSITE
+{
+	volatile unsigned int ts;			// 当前统计周期开始的时间（毫秒）
+	volatile unsigned int count;		// 当前统计周期已经请求输出的条数
+	volatile unsigned int suppressed;	// 被限速的条数
+};
+
+typedef struct ILOGSITE ILOGSITE;
+
+extern volatile int ilog_level;
+
+// 设置log输出的回调函数（在后台线程中调用）
 void set_outlog(void(*write_log)(const char *log));
 
-// ӡlog־
+// 打印log日志（错误级别，不限速）
 void write_log(const char *fmt, ...);
 
+// 打印指定级别的日志（site为NULL不限速，一般通过log_error等宏调用）
+void ilog_write(int level, ILOGSITE *site, const char *fmt, ...);
+
+// 设置运行时的最低级别
+void ilog_setlevel(int level);
+
+// 设置是否使用后台线程输出（默认开启，关闭时在调用线程中直接输出）
+void ilog_setasync(int async);
+
+// 等待队列中的日志全部输出
+void ilog_flush(void);
+
+// 队列满而丢弃的日志条数
+unsigned long long ilog_dropped(void);
+
+#define ILOG_AT(level, ...) do { \
+		static ILOGSITE __ilog_site; \
+		if ((level) >= ilog_level) ilog_write((level), &__ilog_site, __VA_ARGS__); \
+	} while (0)
+
+#if ILOG_MIN_LEVEL <= ILOG_DEBUG
+#define log_debug(...) ILOG_AT(ILOG_DEBUG, __VA_ARGS__)
+#else
+#define log_debug(...) ((void)0)
+#endif
+
+#if ILOG_MIN_LEVEL <= ILOG_INFO
+#define log_info(...) ILOG_AT(ILOG_INFO, __VA_ARGS__)
+#else
+#define log_info(...) ((void)0)
+#endif
+
+#if ILOG_MIN_LEVEL <= ILOG_WARN
+#define log_warn(...) ILOG_AT(ILOG_WARN, __VA_ARGS__)
+#else
+#define log_warn(...) ((void)0)
+#endif
+
+#if ILOG_MIN_LEVEL <= ILOG_ERROR
+#define log_error(...) ILOG_AT(ILOG_ERROR, __VA_ARGS__)
+#else
+#define log_error(...) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // !__LOG_H_
@@ -6,6 +6,8 @@ using namespace std;
 #include "qsp.h"
 #include "systime.h"
 #include "wrap.h"
+#include "simulator.h"
+#include "network.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -23,314 +25,70 @@ using namespace std;
 #include <sys/types.h>
 #endif
 
-#include <list>
-#include <vector>
-
-// ģ
-#if 0
-// ӳٵݰ
-class DelayPacket
+// 模拟网络：回射测试，qsp1每隔20ms发送一个包，qsp2收到后原样返回，统计rtt
+// 使用虚拟时钟，单线程驱动两个非阻塞的端点（微双工模式只能回复一个字节，不能回射）
+void test(int mode, IUINT32 seed = 1)
 {
-public:
-	virtual ~DelayPacket() {
-		if (_ptr) delete _ptr;
-		_ptr = NULL;
-	}
-
-	DelayPacket(int size, const void *src = NULL) {
-		_ptr = new unsigned char[size];
-		_size = size;
-		if (src) {
-			memcpy(_ptr, src, size);
-		}
-	}
-
-	unsigned char* ptr() { return _ptr; }
-	const unsigned char* ptr() const { return _ptr; }
-
-	int size() const { return _size; }
-	IUINT32 ts() const { return _ts; }
-	void setts(IUINT32 ts) { _ts = ts; }
-
-protected:
-	unsigned char *_ptr;
-	int _size;
-	IUINT32 _ts;
-};
-
-// ȷֲ
-class Random
-{
-public:
-	Random(int size) {
-		this->size = 0;
-		seeds.resize(size);
-	}
-
-	int random() {
-		int x, i;
-		if (seeds.size() == 0) return 0;
-		if (size == 0) {
-			for (i = 0; i < (int)seeds.size(); i++) {
-				seeds[i] = i;
-			}
-			size = (int)seeds.size();
-		}
-		i = rand() % size;
-		x = seeds[i];
-		seeds[i] = seeds[--size];
-		return x;
-	}
-
-protected:
-	int size;
-	std::vector<int> seeds;
-};
+	// 创建模拟网络：丢包率10%，Rtt 60ms~125ms
+	LatencySimulator *vnet = new LatencySimulator(10, 60, 125, 1000, seed);
 
-// ӳģ
-class LatencySimulator
-{
-public:
-
-	virtual ~LatencySimulator() {
-		clear();
-	}
-
-	// lostrate: һܶʵİٷֱȣĬ 10%
-	// rttminrttСֵĬ 60
-	// rttmaxrttֵĬ 125
-	LatencySimulator(int lostrate = 10, int rttmin = 60, int rttmax = 125, int nmax = 1000) :
-		r12(100), r21(100) {
-		current = iclock();
-		this->lostrate = lostrate / 2;	// ʣ̳2
-		this->rttmin = rttmin / 2;
-		this->rttmax = rttmax / 2;
-		this->nmax = nmax;
-		tx1 = tx2 = 0;
-	}
-
-	// 
-	void clear() {
-		DelayTunnel::iterator it;
-		for (it = p12.begin(); it != p12.end(); it++) {
-			delete *it;
-		}
-		for (it = p21.begin(); it != p21.end(); it++) {
-			delete *it;
-		}
-		p12.clear();
-		p21.clear();
-	}
-
-	// 
-	// peer - ˵0/10ͣ1գ1ʹ0
-	void send(int peer, const void *data, int size) {
-		if (peer == 0) {
-			tx1++;
-			if (r12.random() < lostrate) return;
-			if ((int)p12.size() >= nmax) return;
-		}
-		else {
-			tx2++;
-			if (r21.random() < lostrate) return;
-			if ((int)p21.size() >= nmax) return;
-		}
-		DelayPacket *pkt = new DelayPacket(size, data);
-		current = iclock();
-		IUINT32 delay = rttmin;
-		if (rttmax > rttmin) delay += rand() % (rttmax - rttmin);
-		pkt->setts(current + delay);
-		if (peer == 0) {
-			p12.push_back(pkt);
-		}
-		else {
-			p21.push_back(pkt);
-		}
-	}
-
-	// 
-	int recv(int peer, void *data, int maxsize) {
-		DelayTunnel::iterator it;
-		if (peer == 0) {
-			it = p21.begin();
-			if (p21.size() == 0) return -1;
-		}
-		else {
-			it = p12.begin();
-			if (p12.size() == 0) return -1;
-		}
-		DelayPacket *pkt = *it;
-		current = iclock();
-		if (current < pkt->ts()) return -2;
-		if (maxsize < pkt->size()) return -3;
-		if (peer == 0) {
-			p21.erase(it);
-		}
-		else {
-			p12.erase(it);
-		}
-		maxsize = pkt->size();
-		memcpy(data, pkt->ptr(), maxsize);
-		delete pkt;
-		return maxsize;
-	}
-
-public:
-	int tx1;
-	int tx2;
-
-protected:
-	IUINT32 current;
-	int lostrate;
-	int rttmin;
-	int rttmax;
-	int nmax;
-	typedef std::list<DelayPacket*> DelayTunnel;
-	DelayTunnel p12;
-	DelayTunnel p21;
-	Random r12;
-	Random r21;
-};
-
-// ģ
-LatencySimulator *vnet;
-
-// ģ磺ģⷢһ udp
-int udp_output(const char *buf, int len, QSP *qsp, void *user)
-{
-	union { int id; void *ptr; } parameter;
-	parameter.ptr = user;
-	vnet->send(parameter.id, buf, len);
-	return len;
-}
-// ģ磺ģһ udp
-int udp_input(char *buf, int len, QSP *qsp, void *user)
-{
-	union { int id; void *ptr; } parameter;
-	parameter.ptr = user;
-
-	return vnet->recv(parameter.id, buf, len);
-}
-
-
-void test(int mode)
-{
-	// ģ磺10%Rtt 60ms~125ms
-	vnet = new LatencySimulator(10, 60, 125);
-
-	// ˵ kcp󣬵һ convǻỰţͬһỰҪͬ
-	// һ userݱʶ
+	// 创建两个端点的 qsp对象，第一个参数 conv是会话编号，同一个会话需要相同
+	// 最后一个是 user参数，用来传递端点编号
 	QSP *qsp1 = qsp_create(0x11223344, (void*)0);
 	QSP *qsp2 = qsp_create(0x11223344, (void*)1);
 
-	// kcp²Ϊ udp_outputģudp
-	qsp1->input = udp_input;
-	qsp2->input = udp_input;
-	qsp1->output = udp_output;
-	qsp2->output = udp_output;
-	qsp1->systime = iclock;
-	qsp2->systime = iclock;
+	QSP *peers[2] = { qsp1, qsp2 };
+	for (int i = 0; i < 2; i++) {
+		qsp_setinput(peers[i], LatencySimulator::input);
+		qsp_setoutput(peers[i], LatencySimulator::output);
+		qsp_setsystime(peers[i], LatencySimulator::systime);
+		qsp_setmode(peers[i], mode);
+		qsp_setnonblock(peers[i], 1);
+	}
 
-	IUINT32 current = iclock();
-	IUINT32 slap = current - 100;
+	IUINT32 current = vnet->clock();
+	IUINT32 slap = current + 20;
 	IUINT32 index = 0;
 	IUINT32 next = 0;
 	IINT64 sumrtt = 0;
 	int count = 0;
 	int maxrtt = 0;
 
-	// ôڴСƽӳ200msÿ20msһ
-	// ǵطշΪ128
-	//ikcp_wndsize(kcp1, 128, 128);
-	//ikcp_wndsize(kcp2, 128, 128);
-
-#if 0
-	// жϲģʽ
-	if (mode == 0) {
-		// Ĭģʽ
-		ikcp_nodelay(kcp1, 0, 10, 0, 0);
-		ikcp_nodelay(kcp2, 0, 10, 0, 0);
-	}
-	else if (mode == 1) {
-		// ͨģʽرص
-		ikcp_nodelay(kcp1, 0, 10, 0, 1);
-		ikcp_nodelay(kcp2, 0, 10, 0, 1);
-	}
-	else {
-		// ģʽ
-		// ڶ nodelay-Ժɳٽ
-		//  intervalΪڲʱӣĬΪ 10ms
-		// ĸ resendΪشָ꣬Ϊ2
-		//  ΪǷóأֹ
-		ikcp_nodelay(kcp1, 1, 10, 2, 1);
-		ikcp_nodelay(kcp2, 1, 10, 2, 1);
-		kcp1->rx_minrto = 10;
-		kcp1->fastresend = 1;
-	}
-#endif
-
 	char buffer[2000];
 	int hr;
 
 	IUINT32 ts1 = iclock();
 
-	while (1) {
-		cout << "----" << endl;
-		isleep(1);
-		current = iclock();
-		//ikcp_update(kcp1, iclock());
-		//ikcp_update(kcp2, iclock());
+	while (next < 1000) {
+		vnet->advance(1);
+		current = vnet->clock();
 
-		// ÿ 20mskcp1
-		for (; current >= slap; slap += 20) {
+		// 每隔 20ms，qsp1发送数据
+		for (; _itimediff(current, slap) >= 0; slap += 20) {
 			((IUINT32*)buffer)[0] = index++;
 			((IUINT32*)buffer)[1] = current;
 
-			// ϲЭ
+			// 发送上层协议包
 			qsp_send(qsp1, buffer, 8);
-			qsp_print(&qsp1->snd_queue);
-			sleep(20);
 		}
 
-		// 磺Ƿudpp1->p2
-		while (1) {
-			hr = qsp_recv(qsp2, buffer, 2000);
-			//hr = vnet->recv(1, buffer, 2000);
-			if (hr < 0) break;
-			//  p2յudpΪ²Э뵽kcp2
-			//ikcp_input(kcp2, buffer, hr);
-		}
-
-		// 磺Ƿudpp2->p1
-		while (1) {
-			hr = qsp_recv(qsp1, buffer, 2000);
-			//hr = vnet->recv(0, buffer, 2000);
-			if (hr < 0) break;
-			//  p1յudpΪ²Э뵽kcp1
-			//ikcp_input(kcp1, buffer, hr);
-		}
+		qsp_update(qsp1);
+		qsp_update(qsp2);
 
-		// kcp2յκΰػȥ
-		while (1) {
-			hr = qsp_recv(qsp2, buffer, 10);
-			// ûյ˳
-			if (hr < 0) break;
-			// յͻ
+		// qsp2接收到任何包都返回回去
+		while ((hr = qsp_recv(qsp2, buffer, 10)) > 0) {
 			qsp_send(qsp2, buffer, hr);
 		}
 
-		// kcp1յkcp2Ļ
-		while (1) {
-			hr = qsp_recv(qsp1, buffer, 10);
-			// ûյ˳
-			if (hr < 0) break;
+		// qsp1收到qsp2的回射数据
+		while ((hr = qsp_recv(qsp1, buffer, 10)) > 0) {
 			IUINT32 sn = *(IUINT32*)(buffer + 0);
 			IUINT32 ts = *(IUINT32*)(buffer + 4);
 			IUINT32 rtt = current - ts;
 
 			if (sn != next) {
-				// յİ
-				printf("ERROR sn %d<->%d\n", (int)count, (int)next);
+				// 如果收到的包不连续
+				printf("ERROR sn %d<->%d\n", (int)sn, (int)next);
 				return;
 			}
 
@@ -338,10 +96,7 @@ void test(int mode)
 			sumrtt += rtt;
 			count++;
 			if (rtt > (IUINT32)maxrtt) maxrtt = rtt;
-
-			printf("[RECV] mode=%d sn=%d rtt=%d\n", mode, (int)sn, (int)rtt);
 		}
-		if (next > 1000) break;
 	}
 
 	ts1 = iclock() - ts1;
@@ -349,16 +104,13 @@ void test(int mode)
 	qsp_release(qsp1);
 	qsp_release(qsp2);
 
-	const char *names[3] = { "default", "normal", "fast" };
-	printf("%s mode result (%dms):\n", names[mode], (int)ts1);
+	printf("mode %d result (simulated %dms, real %dms):\n", mode, (int)vnet->clock(), (int)ts1);
 	printf("avgrtt=%d maxrtt=%d tx=%d\n", (int)(sumrtt / count), (int)maxrtt, (int)vnet->tx1);
-	printf("press enter to next ...\n");
-	char ch; scanf("%c", &ch);
-}
 
-#endif
+	delete vnet;
+}
 
-// 
+// 测试用例
 #if 0
 void qsp_print(struct IQUEUEHEAD *head);
 
@@ -414,7 +166,6 @@ int udp_output(const char *buf, int len, QSP *qsp, void *user)
 	//printf("sendto data : %d byte\n", ret);
 	//printf("sendto data:\n");
 	//print_mem(buf, ret);
-	printf("[send][%s][send to is ok]\n", len == 24 || len == 1 ? "ACK" : "DATA");
 
 	return ret;
 }
@@ -429,17 +180,9 @@ int udp_input(char *buf, int len, QSP *qsp, void *user)
 	//print_mem(buf, ret);
 	if (ret == -1 && errno == EAGAIN)
 	{
-		//isleep(1);
-		return 0;
-		for (int i = 0; i < rand() % 10 + 10; i++)
-		{
-			printf("--");
-		}
-		printf("\n");
 		return 0;
 	}
 
-	printf("[recv][%s][recv from is ok]\n", ret == 24 || ret == 1 ? "ACK" : "DATA");
 	return ret;
 }
 
@@ -2,7 +2,7 @@
 
 
 //---------------------------------------------------------------------
-// encode / decode    루ֵ&var + 1/루תΪСݣ
+// encode / decode    编码（返回值：&var + 1）/解码（转为小端数据）
 //---------------------------------------------------------------------
 
 /* encode 8 bits unsigned int */
@@ -75,23 +75,23 @@ const char* qsp_decode32u(const char *p, IUINT32 *l)
 	return p;
 }
 
-/* Сֵ */
+/* 返回最小值 */
 IUINT32 _imin_(IUINT32 a, IUINT32 b) {
 	return a <= b ? a : b;
 }
 
-/* ֵ */
+/* 返回最大值 */
 IUINT32 _imax_(IUINT32 a, IUINT32 b) {
 	return a >= b ? a : b;
 }
 
-/* мֵ */
+/* 返回中间值 */
 IUINT32 _ibound_(IUINT32 lower, IUINT32 middle, IUINT32 upper)
 {
 	return _imin_(_imax_(lower, middle), upper);
 }
 
-/* زֵ */
+/* 返回差值 */
 long _itimediff(IUINT32 later, IUINT32 earlier)
 {
 	return ((IINT32)(later - earlier));
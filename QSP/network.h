@@ -8,7 +8,7 @@ extern "C" {
 #endif
 
 //---------------------------------------------------------------------
-// ֽ궨   IWORDS_BIG_ENDIAN Ϊ 1 ǴˣΪ 0 С
+// 字节序宏定义   IWORDS_BIG_ENDIAN 为 1 则是大端，为 0 则是小端
 //---------------------------------------------------------------------
 #ifndef IWORDS_BIG_ENDIAN
 #ifdef _BIG_ENDIAN_
@@ -49,16 +49,16 @@ char* qsp_encode32u(char *p, IUINT32 l);
 /* decode 32 bits unsigned int (lsb) */
 const char* qsp_decode32u(const char *p, IUINT32 *l);
 
-/* Сֵ */
+/* 返回最小值 */
 IUINT32 _imin_(IUINT32 a, IUINT32 b);
 
-/* ֵ */
+/* 返回最大值 */
 IUINT32 _imax_(IUINT32 a, IUINT32 b);
 
-/* мֵ */
+/* 返回中间值 */
 IUINT32 _ibound_(IUINT32 lower, IUINT32 middle, IUINT32 upper);
 
-/* زֵ */
+/* 返回差值 */
 long _itimediff(IUINT32 later, IUINT32 earlier);
 
 #ifdef __cplusplus
@@ -1,782 +1,3797 @@
 #include "qsp.h"
+#include "systime.h"
 
-// һµqspĽڵ㣨sizedataݴС 
+// 进程内所有会话的内存占用统计 / 内存软限制 / 硬限制（字节，0为不限制）
+static QSPMEM qsp_mem_global;
+static IUINT64 qsp_mem_soft = 0, qsp_mem_hard = 0;
+
+// 进程内所有会话的统计之和（各个会话定期把增量原子地加到这里）
+static QSPSTATS qsp_stats_global;
+
+// 分配一个新的qsp报文节点（size：data的数据大小 ）
 static QSPNODE* qsp_segment_new(int size)
 {
 	if (size < 0)
 	{
-		write_log("[qsp_segment_new : %d] : error, argument error", __LINE__);
+		log_error("[qsp_segment_new : %d] : error, argument error", __LINE__);
 		return NULL;
 	}
 
 	QSPNODE *qnode = (QSPNODE*)malloc_hook(sizeof(QSPNODE) + size);
+	if (qnode == NULL)
+	{
+		log_error("[qsp_segment_new : %d] : error, malloc_hook function return NULL", __LINE__);
+		return NULL;
+	}
+
 	memset(qnode, 0, sizeof(QSPNODE) + size);
 	iqueue_init(&qnode->node);
+	qnode->size = sizeof(QSPNODE) + size;
 
 	return qnode;
 }
 
-// ͷһqsp
+// 释放一个qsp报文
 static void qsp_segment_delete(QSPNODE *segnode)
 {
 	if (segnode == NULL)
 	{
-		write_log("[qsp_segment_delete : %d] : error, argument error", __LINE__);
+		log_error("[qsp_segment_delete : %d] : error, argument error", __LINE__);
 		return;
 	}
 
 	free_hook(segnode);
 }
 
-// ݡִлصinputصжݣ
-static int qsp_input(QSP *qsp, void*buf, int len)
+// 节点进入队列，统计内存占用（que：QSP_MEM_SND_QUEUE等）
+static void qsp_mem_inc(QSP *qsp, int que, const QSPNODE *qnode)
 {
 	assert(qsp);
-	assert(buf);
+	assert(qnode);
 
-	if (qsp->input == NULL)
+	qsp->mem.bytes[que] += qnode->size;
+	qsp->mem.total += qnode->size;
+	iatomic_add64(&qsp_mem_global.bytes[que], qnode->size);
+	iatomic_add64(&qsp_mem_global.total, qnode->size);
+}
+
+// 节点离开队列，统计内存占用
+static void qsp_mem_dec(QSP *qsp, int que, const QSPNODE *qnode)
+{
+	assert(qsp);
+	assert(qnode);
+
+	qsp->mem.bytes[que] -= qnode->size;
+	qsp->mem.total -= qnode->size;
+	iatomic_add64(&qsp_mem_global.bytes[que], (IUINT64)0 - qnode->size);
+	iatomic_add64(&qsp_mem_global.total, (IUINT64)0 - qnode->size);
+}
+
+// 释放队列中的所有节点
+static void qsp_queue_release(QSP *qsp, struct IQUEUEHEAD *head, int que)
+{
+	assert(qsp);
+	assert(head);
+
+	while (!iqueue_is_empty(head))
 	{
-		write_log("[qsp_input : %d] : error, input callback is NULL", __LINE__);
-		return -1;
+		QSPNODE *qnode = iqueue_entry(head->next, QSPNODE, node);
+		iqueue_del(&qnode->node);
+		qsp_mem_dec(qsp, que, qnode);
+		qsp_segment_delete(qnode);
 	}
-	return qsp->input((char*)buf, len, qsp, qsp->user);
 }
 
-// ݡִлصoutputصУ
-static int qsp_output(QSP *qsp, const void*buf, int len)
+// 释放所有逻辑流的收发队列与正在分块发送的片段，队列计数清零
+static void qsp_queues_release(QSP *qsp)
 {
 	assert(qsp);
-	assert(buf);
 
-	if (qsp->output == NULL)
+	for (int i = 0; i < QSP_LANE_NUM; i++)
 	{
-		write_log("[qsp_output : %d] : error, output callback is NULL", __LINE__);
-		return -1;
+		qsp_queue_release(qsp, &qsp->lane[i].snd_queue, QSP_MEM_SND_QUEUE);
+		qsp_queue_release(qsp, &qsp->lane[i].rcv_buf, QSP_MEM_RCV_BUF);
+		qsp_queue_release(qsp, &qsp->lane[i].rcv_queue, QSP_MEM_RCV_QUEUE);
+		qsp->lane[i].nsnd_que = qsp->lane[i].nsnd_buf = qsp->lane[i].nrcv_que = 0;
 	}
+	qsp_queue_release(qsp, &qsp->snd_buf, QSP_MEM_SND_BUF);
 
-	return qsp->output((const char*)buf, len, qsp, qsp->user);
+	qsp->nsnd_que = qsp->nsnd_buf = qsp->nrcv_buf = qsp->nrcv_que = 0;
+
+	if (qsp->chk_node != NULL)
+	{
+		qsp_segment_delete(qsp->chk_node);
+		qsp->chk_node = NULL;
+	}
+	qsp->chk_count = 0;
 }
 
-// ʱӣȡǰϵͳʱ䣺룩
-static IUINT32 qsp_click(QSP *qsp)
+// 判断再占用size字节后是否超过限制（level：0软限制 / 1硬限制 / 2硬限制的一半）
+static int qsp_mem_exceed(const QSP *qsp, IUINT64 size, int level)
 {
 	assert(qsp);
 
-	if (qsp->systime == NULL)
+	IUINT64 limit = level ? qsp->mem_hard : qsp->mem_soft;
+	IUINT64 global = level ? qsp_mem_hard : qsp_mem_soft;
+
+	if (level == 2)
 	{
-		write_log("[qsp_click : %d] : error, systime callback is NULL", __LINE__);
-		return 0;
+		limit = (limit + 1) / 2;
+		global = (global + 1) / 2;
 	}
 
-	return qsp->systime();
+	if (limit && qsp->mem.total + size > limit)
+		return 1;
+
+	if (global && iatomic_load64(&qsp_mem_global.total) + size > global)
+		return 1;
+
+	return 0;
 }
 
-// Աͷݱ/תΪСˣرͷβַ + 1
-static char* qsp_encode_seg(char *ptr, const QSPNODE *qnode)
+// 判断逻辑流的rcv_queue中是否有可以读取的数据（消息模式需要接收完整的报文）
+static int qsp_lane_ready(const QSPLANE *lane)
 {
-	assert(ptr);
-	assert(qnode);
+	assert(lane);
 
-	ptr = qsp_encode32u(ptr, qnode->seg.conv);
-	ptr = qsp_encode32u(ptr, qnode->seg.frg);
-	ptr = qsp_encode32u(ptr, qnode->seg.ts);
-	ptr = qsp_encode32u(ptr, qnode->seg.sn);
-	ptr = qsp_encode16u(ptr, qnode->seg.cmd);
-	ptr = qsp_encode16u(ptr, qnode->seg.mode);
-	ptr = qsp_encode16u(ptr, qnode->seg.ver);
-	ptr = qsp_encode16u(ptr, qnode->seg.len);
+	struct IQUEUEHEAD *p;
 
-	return ptr;
+	for (p = lane->rcv_queue.next; p != &lane->rcv_queue; p = p->next)
+	{
+		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		if (qnode->seg.sn == QSP_STREAM_SN || qnode->seg.frg == 0)
+			return 1;
+	}
+
+	return 0;
 }
 
-// ACKACKӦɾsnd_bufеĽڵ㣩
-static void qsp_parse_ack(QSP *qsp, IUINT32 frg)
+// 丢弃最早的一组不可靠（单工模式）数据：先rcv_queue中未读取的报文，再snd_queue中未发送的报文
+// 返回值：丢弃的字节数，0为没有可丢弃的数据
+static IUINT64 qsp_mem_drop(QSP *qsp)
 {
 	assert(qsp);
 
 	struct IQUEUEHEAD *p, *next;
+	IUINT64 dropped = 0;
+	QSPNODE *qnode;
+	QSPLANE *lane;
+	int i;
 
-	// ɾsnd_bufеfrgڵ
-	for (p = qsp->snd_buf.next; p != &qsp->snd_buf; p = next)
+	// rcv_queue队首完整的单工报文（字节流片段单独丢弃）
+	for (i = 0; dropped == 0 && i < QSP_LANE_NUM; i++)
 	{
-		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
-		next = p->next;
-		if (frg == qnode->seg.frg)
+		lane = &qsp->lane[i];
+		if (iqueue_is_empty(&lane->rcv_queue))
+			continue;
+
+		// 报文还没有接收完整，不能丢弃
+		qnode = iqueue_entry(lane->rcv_queue.next, QSPNODE, node);
+		if (qnode->seg.mode != QSP_MODE_SINGLE || !qsp_lane_ready(lane))
+			continue;
+
+		for (p = lane->rcv_queue.next; ; p = next)
 		{
+			int last;
+			next = p->next;
+			qnode = iqueue_entry(p, QSPNODE, node);
+			last = qnode->seg.sn == QSP_STREAM_SN || qnode->seg.frg == 0;
 			iqueue_del(p);
+			qsp_mem_dec(qsp, QSP_MEM_RCV_QUEUE, qnode);
+			dropped += qnode->size;
 			qsp_segment_delete(qnode);
-			qsp->nsnd_buf--;
-			break;
+			lane->nrcv_que--;
+			qsp->nrcv_que--;
+			if (last)
+				break;
+		}
+	}
+
+	// snd_queue队首未发送的单工报文片段
+	for (i = 0; dropped == 0 && i < QSP_LANE_NUM; i++)
+	{
+		lane = &qsp->lane[i];
+		while (!iqueue_is_empty(&lane->snd_queue))
+		{
+			qnode = iqueue_entry(lane->snd_queue.next, QSPNODE, node);
+			if (qnode->seg.mode != QSP_MODE_SINGLE)
+				break;
+
+			iqueue_del(&qnode->node);
+			qsp_mem_dec(qsp, QSP_MEM_SND_QUEUE, qnode);
+			dropped += qnode->size;
+			qsp_segment_delete(qnode);
+			lane->nsnd_que--;
+			qsp->nsnd_que--;
 		}
 	}
+
+	qsp->mem.dropped += dropped;
+	iatomic_add64(&qsp_mem_global.dropped, dropped);
+
+	return dropped;
 }
 
-// ӦACKACKĲͣreturn 0single
-static int qsp_respond_ack(QSP *qsp, QSPNODE *qnode)
+// 检查内存预算：超过软限制时丢弃最早的不可靠数据，丢弃后仍超过硬限制返回非0
+// half：只允许使用硬限制的一半（乱序接收的片段，保证有序的片段总能被接收）
+static int qsp_mem_check(QSP *qsp, IUINT64 size, int half)
 {
 	assert(qsp);
-	assert(qnode);
 
-	if (qnode->seg.mode == QSP_MODE_HALF)
+	while (qsp_mem_exceed(qsp, size, 0))
 	{
-		QSPNODE *qnode_ack = qsp->buff;
-		qnode_ack->seg.conv = qnode->seg.conv;
-		qnode_ack->seg.frg = qnode->seg.frg;
-		qnode_ack->seg.ts = qsp->systime();
-		qnode_ack->seg.sn = 1;
-		qnode_ack->seg.cmd = QSP_CMD_ACK;
-		qnode_ack->seg.mode = qnode->seg.mode;
-		qnode_ack->seg.ver = QSP_VERSION;
-		qnode_ack->seg.len = 0;
-		qsp_encode_seg(qnode_ack, qnode_ack);
+		if (qsp_mem_drop(qsp) == 0)
+			break;
+	}
 
-		QSPSEG *seg = (QSPSEG *)qnode_ack;
+	return qsp_mem_exceed(qsp, size, half ? 2 : 1);
+}
 
-		return qsp_output(qsp, qsp->buff, QSP_HEAD_SIZE);
-	}
-	else if (qnode->seg.mode == QSP_MODE_WEAK)
-	{
-		IUINT8 ack = (IUINT8)qnode->seg.frg;
-		qsp_encode8u((char*)(&ack), ack);
-		return qsp_output(qsp, &ack, 1);
-	}
-	else
+// 读取一次系统时间（毫秒）：每次调用（事件循环的一轮）开始时执行，之后使用缓存的时间
+static IUINT32 qsp_tick(QSP *qsp)
+{
+	assert(qsp);
+
+	if (qsp->systime == NULL)
 	{
-		//write_log("[qsp_respond_ack : %d] : warning, mode are not allowed to respond ack", __LINE__);
-		return 0;
+		log_error("[qsp_tick : %d] : error, systime callback is NULL", __LINE__);
+		return qsp->current;
 	}
-	return 0;
+
+	qsp->current = qsp->systime();
+	return qsp->current;
 }
 
-// طƬΣֻڰ˫ʱã
-static int qsp_request_again(QSP *qsp, IUINT32 frg)
+// 时钟（本轮缓存的当前时间：毫秒）
+static IUINT32 qsp_click(QSP *qsp)
 {
 	assert(qsp);
 
-	QSPNODE *qnode_ack = qsp->buff;
+	return qsp->current;
+}
 
-	qnode_ack->seg.conv = qsp->conv;
-	qnode_ack->seg.frg = frg;
-	qnode_ack->seg.ts = qsp->systime();
-	qnode_ack->seg.sn = 1;
-	qnode_ack->seg.cmd = QSP_CMD_AGAIN;
-	qnode_ack->seg.mode = qsp->mode;
-	qnode_ack->seg.ver = qsp->ver;
-	qnode_ack->seg.len = 0;
+// 加密：nonce为会话编号 + 包号（最高位为发送方的角色，两个方向不会重复）
+static void qsp_nonce(const QSP *qsp, IUINT64 pn, unsigned char *nonce)
+{
+	char *p = (char*)nonce;
 
-	qsp_encode_seg(qnode_ack, qnode_ack);
+	p = qsp_encode32u(p, qsp->conv);
+	p = qsp_encode32u(p, (IUINT32)pn);
+	qsp_encode32u(p, (IUINT32)(pn >> 32));
+}
 
-	return qsp_output(qsp, qsp->buff, QSP_HEAD_SIZE);
+// 握手报文不加密（服务端在创建会话前做准入检查）
+static int qsp_is_handshake(const char *buf, int len)
+{
+	IUINT16 cmd;
+
+	if (len < (int)QSP_HEAD_SIZE)
+		return 0;
+
+	qsp_decode16u(buf + IOFFSETOF(QSPSEG, cmd) - IOFFSETOF(QSPSEG, conv), &cmd);
+	return cmd == QSP_CMD_HELLO || cmd == QSP_CMD_COOKIE;
 }
 
-// һڵ㣨ӡʱ
-static int qsp_send_node(QSP *qsp, QSPNODE *qnode)
+// 原地加密：[报文头部（明文，参与认证）][数据（密文）][认证标签][包号]，返回加密后的长度
+static int qsp_seal(QSP *qsp, char *buf, int len)
 {
 	assert(qsp);
-	assert(qnode);
-
-	char *buf = qsp->buff;
-	int datalen = qnode->seg.len;
-	int size = 0;
+	assert(buf);
 
-	memcpy(buf, &qnode->seg, QSP_HEAD_SIZE);
-	size = QSP_HEAD_SIZE;
+	unsigned char nonce[IAEAD_NONCE_SIZE];
+	IUINT64 pn;
+	char *p;
 
-	buf = qsp_encode_seg(buf, qnode);
+	if (qsp_is_handshake(buf, len))
+		return len;
 
-	memcpy(buf, qnode->seg.data, datalen);
-	size += datalen;
+	pn = qsp->aead_snd++ | ((IUINT64)qsp->aead_role << 63);
+	qsp_nonce(qsp, pn, nonce);
+	iaead_seal(qsp->aead, nonce, buf, QSP_HEAD_SIZE, buf + QSP_HEAD_SIZE, len - QSP_HEAD_SIZE, (unsigned char*)buf + len);
 
-	qnode->ts = qsp_click(qsp);					// ýڵ㷢͵ʱ
+	p = qsp_encode32u(buf + len + IAEAD_TAG_SIZE, (IUINT32)pn);
+	qsp_encode32u(p, (IUINT32)(pn >> 32));
 
-	return qsp_output(qsp, qsp->buff, size);	// ûݻص
+	return len + QSP_CRYPTO_OVERHEAD;
 }
 
-// :жϸýڵ㣬ظͷrcv_bufУrev_queueһݣƶrecv_queue
-// ֵ0ñĲظı 0ظı
-int qsp_parse_data(QSP *qsp, QSPNODE *newnode)
+// 原地解密并检查重放，返回明文长度，认证失败或者重放返回-1
+static int qsp_open(QSP *qsp, char *buf, int len)
 {
 	assert(qsp);
-	assert(newnode);
+	assert(buf);
 
-	int repeat = 0;	//Ƿظı
-	struct IQUEUEHEAD *p, *prev;
-	IUINT32 sn = newnode->seg.sn;
+	unsigned char nonce[IAEAD_NONCE_SIZE];
+	IUINT32 lo, hi;
+	IUINT64 pn, diff;
+	int datalen;
 
-	// жϱǷظ
-	if (qsp->last.frg == newnode->seg.frg && qsp->last.sn == newnode->seg.sn && qsp->last.ts == newnode->seg.ts)
-		repeat = 1;
-	else
-		qsp->last = newnode->seg;	//汨ͷϢ
+	if (qsp_is_handshake(buf, len))
+		return len;
 
-									// Ƿǵһ
-	if (newnode->seg.sn - newnode->seg.frg == 1 && qsp->rcv_nxt == 0)
-		qsp->rcv_nxt = newnode->seg.frg;
+	if (len < (int)(QSP_HEAD_SIZE + QSP_CRYPTO_OVERHEAD))
+		return -1;
+
+	datalen = len - QSP_CRYPTO_OVERHEAD - QSP_HEAD_SIZE;
+	qsp_decode32u(qsp_decode32u(buf + len - 8, &lo), &hi);
+	pn = ((IUINT64)hi << 32) | lo;
+
+	// 只接受对端角色发送的数据包（拒绝反射回来的本端数据包）
+	if ((IUINT32)(pn >> 63) == qsp->aead_role)
+		return -1;
+	pn &= ~((IUINT64)1 << 63);
 
-	// ٴжϱƬǷظжϣ֤ݵ
-	for (p = qsp->rcv_buf.prev; p != &qsp->rcv_buf; p = prev)
+	// 防重放：认证前先检查窗口（不必计算被重放的数据包）
+	if (pn <= qsp->aead_rcv)
 	{
-		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
-		prev = p->prev;
-		if (qnode->seg.sn == sn)
-		{
-			repeat = 1;	//ظı
-			break;
-		}
+		diff = qsp->aead_rcv - pn;
+		if (diff >= 64 || (qsp->aead_win & ((IUINT64)1 << diff)))
+			return -1;
 	}
 
-	// ظı
-	if (repeat == 1)
+	qsp_nonce(qsp, pn | ((IUINT64)(qsp->aead_role ^ 1) << 63), nonce);
+	if (iaead_open(qsp->aead, nonce, buf, QSP_HEAD_SIZE, buf + QSP_HEAD_SIZE, datalen,
+		(const unsigned char*)buf + len - QSP_CRYPTO_OVERHEAD))
+		return -1;
+
+	if (pn > qsp->aead_rcv)
 	{
-		qsp_segment_delete(newnode);
+		diff = pn - qsp->aead_rcv;
+		qsp->aead_win = diff >= 64 ? 1 : (qsp->aead_win << diff) | 1;
+		qsp->aead_rcv = pn;
 	}
 	else
 	{
-		iqueue_init(&newnode->node);
-		iqueue_add(&newnode->node, p);
-		qsp->nrcv_buf++;
+		qsp->aead_win |= (IUINT64)1 << (qsp->aead_rcv - pn);
+	}
+
+	return len - QSP_CRYPTO_OVERHEAD;
+}
+
+// 输入数据、执行回调函数（从input回调函数中读入数据）
+static int qsp_input(QSP *qsp, void*buf, int len)
+{
+	assert(qsp);
+	assert(buf);
+
+	if (qsp->input == NULL)
+	{
+		log_error("[qsp_input : %d] : error, input callback is NULL", __LINE__);
+		return -1;
 	}
 
-	// ƶЧrev_queueĽڵһݵrev_queue
-	while (!iqueue_is_empty(&qsp->rcv_buf))
+	while (1)
 	{
-		QSPNODE *qnode = iqueue_entry(qsp->rcv_buf.next, QSPNODE, node);
-		if (qnode->seg.frg == qsp->rcv_nxt)
+		int ret = qsp->input((char*)buf, len, qsp, qsp->user);
+		if (ret <= 0 || qsp->aead == NULL)
 		{
-			iqueue_del(&qnode->node);
-			qsp->nrcv_buf--;
-			iqueue_add_tail(&qnode->node, &qsp->rcv_queue);
-			qsp->nrcv_que++;
-			qsp->rcv_nxt--;
+			len = ret;
+			break;
 		}
-		else
+
+		// 认证失败或者重放的数据包丢弃，继续读取下一个
+		ret = qsp_open(qsp, (char*)buf, ret);
+		if (ret >= 0)
 		{
-			write_log("[qsp_parse_data %d]: error", __LINE__);
+			len = ret;
 			break;
 		}
+		qsp->stats.pkt_unauth++;
 	}
 
-	return repeat;
+	// 抓包：时间戳为会话时钟（加密会话记录解密后的数据包）
+	if (qsp->capture != NULL && len > 0)
+		icap_write(qsp->capture, ICAP_IN, buf, len, (IUINT64)qsp_click(qsp) * 1000);
+
+	return len;
 }
 
-// 鿴ջеݴС
-int qsp_peeksize(const QSP *qsp)
+// 输出数据、执行回调函数（输出到output回调函数中），加密会话在buf中原地加密（buf要留出QSP_CRYPTO_OVERHEAD字节）
+static int qsp_output(QSP *qsp, void*buf, int len)
 {
 	assert(qsp);
+	assert(buf);
 
-	struct IQUEUEHEAD *p;
-	QSPNODE *qnode;
-	int length = 0;
+	int size = len;
+	int ret;
 
-	// Ϊ
-	if (iqueue_is_empty(&qsp->rcv_queue))
-		return length;
+	if (qsp->output == NULL)
+	{
+		log_error("[qsp_output : %d] : error, output callback is NULL", __LINE__);
+		return -1;
+	}
 
-	// ֻһڵ㣬ûкƬ
-	qnode = iqueue_entry(qsp->rcv_queue.next, QSPNODE, node);
-	if (qnode->seg.frg == 0) return qnode->seg.len;
+	qsp->stats.pkt_sent++;
+	qsp->stats.byte_sent += len;
 
-	// жƬΣۼƸƬγܺ
-	for (p = qsp->rcv_queue.next; p != &qsp->rcv_queue; p = p->next) {
-		qnode = iqueue_entry(p, QSPNODE, node);
-		length += qnode->seg.len;
-		if (qnode->seg.frg == 0) break;
-	}
+	if (qsp->capture != NULL)
+		icap_write(qsp->capture, ICAP_OUT, buf, len, (IUINT64)qsp_click(qsp) * 1000);
 
-	return length;
+	if (qsp->aead != NULL)
+		size = qsp_seal(qsp, (char*)buf, len);
+
+	ret = qsp->output((const char*)buf, size, qsp, qsp->user);
+
+	// 调用者按明文长度判断是否发送成功
+	return ret == size ? len : ret;
 }
 
-// Ͷ -> һݣsnd_bufУACKȷϣ
-int qsp_send_flush(QSP *qsp)
+// 把会话统计的增量汇总到进程统计（热路径上只做普通的自增，在每次调用结束时汇总一次）
+static void qsp_stats_sync(QSP *qsp)
 {
 	assert(qsp);
 
-	printf("--in qsp_send_flush()\n");
+	IUINT64 *cur = (IUINT64*)&qsp->stats;
+	IUINT64 *sync = (IUINT64*)&qsp->stats_sync;
+	IUINT64 *global = (IUINT64*)&qsp_stats_global;
+	int i, n = (int)(IOFFSETOF(QSPSTATS, srtt) / sizeof(IUINT64));
 
-	// Ͷ -> ݣsnd_bufУACKȷϣ
-	QSPNODE *qnode;
-	for (qnode = qsp->snd_queue.next; qnode != &qsp->snd_queue; qnode = qsp->snd_queue.next)
-	{
-		// ͨģʽжϷʹ
-		int count = qsp->mode == QSP_MODE_SINGLE ? QSP_SINGLE_NUM : 1;
-		for (int i = 0; i < count; i++)
-		{
-			if (qsp_send_node(qsp, qnode) != qnode->seg.len + QSP_HEAD_SIZE)
-				write_log("[qsp_send_flush : %d] : error, qsp_send_node return length error", __LINE__);
-		}
+	qsp->stats.snd_que = qsp->nsnd_que;
+	qsp->stats.snd_buf = qsp->nsnd_buf;
+	qsp->stats.rcv_buf = qsp->nrcv_buf;
+	qsp->stats.rcv_que = qsp->nrcv_que;
 
-		// ͨģʽҪʱطACKȷ
-		if (qsp->mode != QSP_MODE_SINGLE)
-		{
-			iqueue_del(&qnode->node);
-			iqueue_add_tail(&qnode->node, &qsp->snd_buf);
-		}
-		else
+	for (i = 0; i < n; i++)
+	{
+		if (cur[i] != sync[i])
 		{
-			iqueue_del(&qnode->node);
-			qsp_segment_delete(qnode);
+			iatomic_add64(&global[i], cur[i] - sync[i]);
+			sync[i] = cur[i];
 		}
 	}
+}
 
-	// ͨģʽҪACKӦ
-	if (qsp->mode == QSP_MODE_SINGLE)
-		return 0;
+// 根据RTT采样更新平滑RTT与重传超时（RFC 6298），下限为rto_min
+static void qsp_update_rtt(QSP *qsp, IINT32 rtt)
+{
+	assert(qsp);
 
-	// ACKӦ
-	while (qsp->snd_buf.next != &qsp->snd_buf)
-	{
-		// ˢ½ջ
-		if (qsp_recv_flush(qsp))
-			write_log("[qsp_send_flush : %d] : error, qsp_recv_flush return < 0", __LINE__);
+	if (rtt < 0)
+		return;
 
-		// snd_bufУûлӦACKʱĽڵ·͡
-		QSPNODE *qn;
-		for (qn = qsp->snd_buf.next; qn != &qsp->snd_buf; qn = qn->node.next)
-		{
-			// ʱط
-			if (qn->ts + QSP_TIME_OUT < qsp->systime())
-			{
-				write_log("ack is timeout...");
-				if (qsp_send_node(qsp, qn) != qn->seg.len + QSP_HEAD_SIZE)
-					write_log("[qsp_send_flush : %d] : error, qsp_send_node return length error", __LINE__);
-			}
-		}
+	if (qsp->rx_srtt == 0)
+	{
+		qsp->rx_srtt = rtt > 0 ? rtt : 1;
+		qsp->rx_rttvar = rtt / 2;
+	}
+	else
+	{
+		IINT32 delta = rtt - (IINT32)qsp->rx_srtt;
+		if (delta < 0) delta = -delta;
+		qsp->rx_rttvar = (3 * qsp->rx_rttvar + delta) / 4;
+		qsp->rx_srtt = (7 * qsp->rx_srtt + rtt) / 8;
+		if (qsp->rx_srtt < 1) qsp->rx_srtt = 1;
 	}
-	printf("--out qsp_send_flush()\n");
 
-	return 0;
+	qsp->rx_rto = _ibound_(qsp->rto_min, qsp->rx_srtt + _imax_(1, 4 * qsp->rx_rttvar), QSP_RTO_MAX);
 }
 
-// һ -> ȷϽնУrecv_bufУrecv_queue
-int qsp_recv_flush(QSP *qsp)
+// 拥塞控制：确认一个报文片段，慢启动阶段拥塞窗口加1，拥塞避免阶段每确认一个窗口的片段加1（不超过发送窗口）
+static void qsp_cc_ack(QSP *qsp)
 {
 	assert(qsp);
 
-	//  -> жcmdͣQSP_CMD_ACKQSP_CMD_PUSHQSP_CMD_AGAIN
-	while (1)
+	if (!qsp->cc || qsp->cwnd >= qsp->snd_wnd)
+		return;
+
+	if (qsp->cwnd < qsp->ssthresh)
 	{
-		char *buf = qsp->buff;
-		int ret = qsp_input(qsp, qsp->buff, QSP_BUF_SIZE);
+		qsp->cwnd++;
+	}
+	else if (++qsp->cwnd_acked >= qsp->cwnd)
+	{
+		qsp->cwnd++;
+		qsp->cwnd_acked = 0;
+	}
+}
 
-		if (ret < 0)
-		{
-			write_log("[qsp_recv_flush.qsp_input : %d] : error, ret < 0", __LINE__);
-			return -1;
-		}
-		else if (ret == 0)	// ûж
-		{
-			break;
-		}
-		else if (ret == 1)	// QSP_MODE_WEAKACKģ
-		{
-			IUINT8 ack;
-			qsp_decode8u(qsp->buff, &ack);
-			qsp_parse_ack(qsp, ack);
-			break;
-		}
-		else if (ret > 1)	// QSP_MODE_HALF  QSP_MODE_SINGLE ģʽ
-		{
-			IUINT32 conv, frg, ts, sn;
-			IUINT16 cmd, mode, ver, len;
-			QSPNODE *qnode;
+// 拥塞控制：丢包后减小拥塞窗口（每个RTT最多一次），超时重传重新慢启动，收到重传请求时减半（快速恢复）
+static void qsp_cc_loss(QSP *qsp, int timeout)
+{
+	assert(qsp);
 
-			// жϱıʶ
-			buf = qsp_decode32u(buf, &conv);
-			if (conv != qsp->conv)
-			{
-				write_log("[qsp_recv_flush : %d] : error, recv conv != qsp->conv", __LINE__);
-				return -2;
-			}
+	IUINT32 current = qsp_click(qsp);
 
-			buf = qsp_decode32u(buf, &frg);
-			buf = qsp_decode32u(buf, &ts);
-			buf = qsp_decode32u(buf, &sn);
-			buf = qsp_decode16u(buf, &cmd);
-			buf = qsp_decode16u(buf, &mode);
-			buf = qsp_decode16u(buf, &ver);
-			buf = qsp_decode16u(buf, &len);
+	if (!qsp->cc || _itimediff(current, qsp->cc_ts) < (long)qsp->rx_srtt)
+		return;
 
-			// жcmd
-			if (cmd != QSP_CMD_PUSH && cmd != QSP_CMD_ACK &&
-				cmd != QSP_CMD_AGAIN)
-			{
-				write_log("[qsp_recv_flush : %d] : error, cmd is unknow", __LINE__);
+	qsp->ssthresh = _imax_(qsp->nsnd_buf / 2, QSP_CWND_MIN);
+	qsp->cwnd = timeout ? 1 : qsp->ssthresh;
+	qsp->cwnd_acked = 0;
+	qsp->cc_ts = current;
+}
+
+// 第n次超时重传前的等待时间：重传超时按次数加倍（指数退避），不超过QSP_RTO_MAX
+static IUINT32 qsp_backoff(const QSP *qsp, IUINT32 n)
+{
+	IUINT32 rto = qsp->rx_rto;
+
+	while (n-- > 0 && rto < QSP_RTO_MAX)
+		rto <<= 1;
+
+	return _imin_(rto, QSP_RTO_MAX);
+}
+
+// 报文大小分类（按片段数，字节流模式的片段为0类）
+static int qsp_size_class(IUINT32 sn)
+{
+	if (sn <= 1) return 0;
+	if (sn <= 16) return 1;
+	if (sn <= 256) return 2;
+	return 3;
+}
+
+// 记录延迟直方图（没有开启统计时直接返回）
+static void qsp_hist_record(QSP *qsp, int metric, IUINT32 sn, IINT32 value)
+{
+	assert(qsp);
+
+	if (qsp->hist == NULL || value < 0)
+		return;
+
+	ihist_record(&qsp->hist[metric * QSP_SIZE_CLASS_NUM + qsp_size_class(sn)], (IUINT32)value);
+}
+
+// 报文的所有片段是否都已经被确认（snd_queue与snd_buf中都没有该报文的片段）
+static int qsp_msg_acked(const QSP *qsp, IUINT16 sid, IUINT32 msn)
+{
+	assert(qsp);
+
+	const QSPLANE *lane = &qsp->lane[sid];
+	struct IQUEUEHEAD *p;
+
+	// 分块发送还没有写完的报文
+	if (sid == 0 && qsp->chk_count != 0 && qsp->chk_msn == msn)
+		return 0;
+
+	// snd_queue按报文顺序排列，只需要看队头
+	if (!iqueue_is_empty(&lane->snd_queue) && iqueue_entry(lane->snd_queue.next, QSPNODE, node)->seg.msn == msn)
+		return 0;
+
+	for (p = qsp->snd_buf.next; p != &qsp->snd_buf; p = p->next)
+	{
+		const QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		if (qnode->seg.sid == sid && qnode->seg.msn == msn)
+			return 0;
+	}
+
+	return 1;
+}
+
+// 对报文头部数据编码/转为小端（返回报文头部的尾地址 + 1）
+static char* qsp_encode_seg(char *ptr, const QSPNODE *qnode)
+{
+	assert(ptr);
+	assert(qnode);
+
+	ptr = qsp_encode32u(ptr, qnode->seg.conv);
+	ptr = qsp_encode32u(ptr, qnode->seg.frg);
+	ptr = qsp_encode32u(ptr, qnode->seg.ts);
+	ptr = qsp_encode32u(ptr, qnode->seg.sn);
+	ptr = qsp_encode16u(ptr, qnode->seg.cmd);
+	ptr = qsp_encode8u(ptr, qnode->seg.mode);
+	ptr = qsp_encode8u(ptr, qnode->seg.flags);
+	ptr = qsp_encode16u(ptr, qnode->seg.ver);
+	ptr = qsp_encode16u(ptr, qnode->seg.len);
+	ptr = qsp_encode16u(ptr, qnode->seg.wnd);
+	ptr = qsp_encode16u(ptr, qnode->seg.sid);
+	ptr = qsp_encode32u(ptr, qnode->seg.msn);
+
+	return ptr;
+}
+
+// 对报文头部数据解码/从小端转换（返回报文头部的尾地址 + 1）
+static const char* qsp_decode_seg(const char *ptr, QSPSEG *seg)
+{
+	assert(ptr);
+	assert(seg);
+
+	ptr = qsp_decode32u(ptr, &seg->conv);
+	ptr = qsp_decode32u(ptr, &seg->frg);
+	ptr = qsp_decode32u(ptr, &seg->ts);
+	ptr = qsp_decode32u(ptr, &seg->sn);
+	ptr = qsp_decode16u(ptr, &seg->cmd);
+	ptr = qsp_decode8u(ptr, &seg->mode);
+	ptr = qsp_decode8u(ptr, &seg->flags);
+	ptr = qsp_decode16u(ptr, &seg->ver);
+	ptr = qsp_decode16u(ptr, &seg->len);
+	ptr = qsp_decode16u(ptr, &seg->wnd);
+	ptr = qsp_decode16u(ptr, &seg->sid);
+	ptr = qsp_decode32u(ptr, &seg->msn);
+
+	return ptr;
+}
+
+// rcv_queue中还没有接收完整的报文的片段数（qsp_recv只读取完整的报文，这些片段在报文完整之前不会被读取，不计入接收窗口）
+static IUINT32 qsp_rcv_partial(const QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 count = 0;
+	int i;
+
+	for (i = 0; i < QSP_LANE_NUM; i++)
+	{
+		const QSPLANE *lane = &qsp->lane[i];
+		const QSPNODE *qnode;
+
+		if (lane->rcv_nxt == (IUINT32)-1 || iqueue_is_empty(&lane->rcv_queue))
+			continue;
+
+		// 分块接收时当前报文的片段不在rcv_queue中，队尾是之前的报文
+		qnode = iqueue_entry(lane->rcv_queue.prev, QSPNODE, node);
+		if (qnode->seg.sn == QSP_STREAM_SN || qnode->seg.msn != lane->rcv_msn)
+			continue;
+
+		count += qnode->seg.sn - 1 - lane->rcv_nxt;
+	}
+
+	return count;
+}
+
+// 正在拼接的报文中最大的片段总数（没有正在拼接的报文返回0）
+static IUINT32 qsp_rcv_pending(const QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 count = 0;
+	int i;
+
+	for (i = 0; i < QSP_LANE_NUM; i++)
+	{
+		const QSPLANE *lane = &qsp->lane[i];
+		const QSPNODE *qnode = NULL;
+
+		// 已经有片段移动到rcv_queue中，或者片段在rcv_buf中等待前面的片段
+		if (lane->rcv_nxt != (IUINT32)-1 && !iqueue_is_empty(&lane->rcv_queue))
+			qnode = iqueue_entry(lane->rcv_queue.prev, QSPNODE, node);
+		if ((qnode == NULL || qnode->seg.msn != lane->rcv_msn) && !iqueue_is_empty(&lane->rcv_buf))
+			qnode = iqueue_entry(lane->rcv_buf.next, QSPNODE, node);
+
+		if (qnode == NULL || qnode->seg.sn == QSP_STREAM_SN || qnode->seg.cmd != QSP_CMD_PUSH || qnode->seg.msn != lane->rcv_msn)
+			continue;
+
+		count = _imax_(count, qnode->seg.sn);
+	}
+
+	return count;
+}
+
+// 接收窗口的剩余大小（rcv_buf与rcv_queue中还能缓存的报文片段数，正在拼接的报文已经有序的片段除外）
+static IUINT16 qsp_wnd_unused(const QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 count = qsp->nrcv_que - qsp_rcv_partial(qsp) + qsp->nrcv_buf;
+
+	if (count >= qsp->rcv_wnd)
+		return 0;
+
+	return (IUINT16)_imin_(qsp->rcv_wnd - count, QSP_WND_MAX);
+}
+
+// 发送窗口（最多同时等待ACK的报文片段数，不超过对端通告的接收窗口）
+static IUINT32 qsp_wnd_send(const QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 wnd;
+
+	// 微双工模式的ACK只有一个字节，不携带窗口
+	if (qsp->mode == QSP_MODE_WEAK)
+		wnd = _imin_(qsp->snd_wnd, QSP_WEAK_MAX);
+	else
+		wnd = _imin_(qsp->snd_wnd, qsp->rmt_wnd);
+
+	// 开启拥塞控制时不超过拥塞窗口
+	if (qsp->cc)
+		wnd = _imin_(wnd, qsp->cwnd);
+
+	return wnd;
+}
+
+// 报文片段距下一个待接收片段的偏移（已经接收过的片段返回-1）
+static long qsp_rcv_offset(const QSP *qsp, const QSPLANE *lane, IUINT32 frg, IUINT32 sn, IUINT32 msn)
+{
+	assert(qsp);
+	assert(lane);
+
+	if (sn == QSP_STREAM_SN)
+		return _itimediff(frg, lane->rcv_nxt) < 0 ? -1 : (long)(frg - lane->rcv_nxt);
+
+	if (_itimediff(msn, lane->rcv_msn) < 0)
+		return -1;						// 已经接收完整的报文
+
+	if (msn != lane->rcv_msn)
+		return (long)qsp->nrcv_buf + 1;	// 后续报文的片段，排在所有已缓存的片段之后
+
+	if (lane->rcv_nxt == (IUINT32)-1)
+		return (long)(sn - 1 - frg);	// 报文的第一个片段还没有到达（包号从sn - 1递减）
+
+	if (frg > lane->rcv_nxt)
+		return -1;						// 当前报文已经接收过的片段
+
+	return (long)(lane->rcv_nxt - frg);
+}
+
+// 判断接收窗口是否允许接收该报文片段（片段的偏移不能超过rcv_queue之外的剩余窗口，已经接收过的片段需要重新回应ACK）
+// 正在拼接的报文已经有序的片段不占用窗口：片段数超过接收窗口的报文仍然可以按窗口滑动接收完整
+static int qsp_wnd_accept(const QSP *qsp, long offset)
+{
+	assert(qsp);
+
+	IUINT32 queued = qsp->nrcv_que - qsp_rcv_partial(qsp);
+	IUINT32 unused = qsp->rcv_wnd > queued ? qsp->rcv_wnd - queued : 0;
+
+	return offset < 0 || (IUINT32)offset < unused;
+}
+
+// 根据读取速度自动调整接收窗口（每个统计周期内读取片段数的两倍，不小于正在拼接的报文的片段总数）
+static void qsp_wnd_update(QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 current = qsp_click(qsp);
+
+	if (!qsp->wnd_auto || _itimediff(current, qsp->wnd_ts) < QSP_WND_INTERVAL)
+		return;
+
+	qsp->rcv_wnd = _ibound_(QSP_WND_MIN, qsp->wnd_drain * 2, qsp->wnd_max);
+	qsp->rcv_wnd = _imax_(qsp->rcv_wnd, _imin_(qsp_rcv_pending(qsp), QSP_WND_MAX));
+	qsp->wnd_ts = current;
+	qsp->wnd_drain = 0;
+}
+
+// 解析ACK，处理ACK回应（删除snd_buf队列中的节点，mask：微双工模式只比较frg的低8位，不比较报文序号）
+static void qsp_parse_ack(QSP *qsp, IUINT16 sid, IUINT32 msn, IUINT32 frg, IUINT32 mask)
+{
+	assert(qsp);
+
+	struct IQUEUEHEAD *p, *next;
+
+	// 删除snd_buf队列中的frg节点
+	for (p = qsp->snd_buf.next; p != &qsp->snd_buf; p = next)
+	{
+		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		next = p->next;
+		if (sid == qnode->seg.sid && frg == (qnode->seg.frg & mask) && (mask != 0xffffffff || msn == qnode->seg.msn))
+		{
+			IUINT32 now = qsp_click(qsp);
+			IUINT32 seg_sn = qnode->seg.sn, seg_msn = qnode->seg.msn, seg_ts = qnode->seg.ts;
+			int push = qnode->seg.cmd == QSP_CMD_PUSH;
+
+			// 只用没有重传过的片段采样RTT（Karn算法）
+			if (qnode->xmit == 1)
+			{
+				qsp_update_rtt(qsp, _itimediff(now, qnode->ts));
+				qsp_hist_record(qsp, QSP_HIST_ACK_RTT, seg_sn, _itimediff(now, qnode->ts));
+			}
+			ITRACE(ITRACE_ACK_RECV, qsp->conv, sid, seg_msn, qnode->seg.frg, qnode->xmit == 1 ? (IUINT32)_itimediff(now, qnode->ts) : (IUINT32)-1);
+			iqueue_del(p);
+			qsp_mem_dec(qsp, QSP_MEM_SND_BUF, qnode);
+			qsp_segment_delete(qnode);
+			qsp->lane[sid].nsnd_buf--;
+			qsp->nsnd_buf--;
+			qsp_cc_ack(qsp);
+
+			// 报文的最后一个未确认片段：记录报文从进入发送队列到全部确认的时间
+			if (qsp->hist != NULL && push && seg_sn != QSP_STREAM_SN && qsp_msg_acked(qsp, sid, seg_msn))
+				qsp_hist_record(qsp, QSP_HIST_MSG_ACKED, seg_sn, _itimediff(now, seg_ts));
+			break;
+		}
+	}
+}
+
+// 回应ACK，创建ACK报文并发送（return 0：single）
+static int qsp_respond_ack(QSP *qsp, QSPNODE *qnode)
+{
+	assert(qsp);
+	assert(qnode);
+
+	if (qnode->seg.mode == QSP_MODE_HALF)
+	{
+		QSPNODE *qnode_ack = qsp->buff;
+		qnode_ack->seg.conv = qnode->seg.conv;
+		qnode_ack->seg.frg = qnode->seg.frg;
+		qnode_ack->seg.ts = qsp_click(qsp);
+		qnode_ack->seg.sn = 1;
+		qnode_ack->seg.cmd = QSP_CMD_ACK;
+		qnode_ack->seg.mode = qnode->seg.mode;
+		qnode_ack->seg.ver = QSP_VERSION;
+		qnode_ack->seg.len = 0;
+		qnode_ack->seg.wnd = qsp_wnd_unused(qsp);
+		qnode_ack->seg.sid = qnode->seg.sid;
+		qnode_ack->seg.msn = qnode->seg.msn;
+		qsp_encode_seg(qnode_ack, qnode_ack);
+
+		QSPSEG *seg = (QSPSEG *)qnode_ack;
+
+		qsp->stats.ack_sent++;
+		ITRACE(ITRACE_ACK_SEND, qnode->seg.conv, qnode->seg.sid, qnode->seg.msn, qnode->seg.frg, 0);
+		return qsp_output(qsp, qsp->buff, QSP_HEAD_SIZE);
+	}
+	else if (qnode->seg.mode == QSP_MODE_WEAK)
+	{
+		IUINT8 ack = (IUINT8)qnode->seg.frg;
+		qsp_encode8u((char*)(&ack), ack);
+		qsp->stats.ack_sent++;
+		ITRACE(ITRACE_ACK_SEND, qnode->seg.conv, qnode->seg.sid, qnode->seg.msn, qnode->seg.frg, 0);
+		return qsp_output(qsp, &ack, 1);
+	}
+	else
+	{
+		//log_warn("[qsp_respond_ack : %d] : warning, mode are not allowed to respond ack", __LINE__);
+		return 0;
+	}
+	return 0;
+}
+
+// 发送一个只有报文头的控制报文（AGAIN / WASK / WINS）
+static int qsp_send_cmd(QSP *qsp, IUINT16 cmd, IUINT16 sid, IUINT32 msn, IUINT32 frg)
+{
+	assert(qsp);
+
+	QSPNODE *qnode_ack = qsp->buff;
+
+	qnode_ack->seg.conv = qsp->conv;
+	qnode_ack->seg.frg = frg;
+	qnode_ack->seg.ts = qsp_click(qsp);
+	qnode_ack->seg.sn = 1;
+	qnode_ack->seg.cmd = cmd;
+	qnode_ack->seg.mode = qsp->mode;
+	qnode_ack->seg.ver = qsp->ver;
+	qnode_ack->seg.len = 0;
+	qnode_ack->seg.wnd = qsp_wnd_unused(qsp);
+	qnode_ack->seg.sid = sid;
+	qnode_ack->seg.msn = msn;
+
+	qsp_encode_seg(qnode_ack, qnode_ack);
+
+	return qsp_output(qsp, qsp->buff, QSP_HEAD_SIZE);
+}
+
+// 发送HELLO握手报文（带回cookie，还没有收到cookie时为全0，与COOKIE回复等长，服务端不会放大流量）
+static int qsp_send_hello(QSP *qsp)
+{
+	assert(qsp);
+
+	QSPNODE *qnode_hello = qsp->buff;
+
+	qnode_hello->seg.conv = qsp->conv;
+	qnode_hello->seg.frg = 0;
+	qnode_hello->seg.ts = qsp_click(qsp);
+	qnode_hello->seg.sn = 1;
+	qnode_hello->seg.cmd = QSP_CMD_HELLO;
+	qnode_hello->seg.mode = qsp->mode;
+	qnode_hello->seg.ver = qsp->ver;
+	qnode_hello->seg.len = ICOOKIE_SIZE;
+	qnode_hello->seg.wnd = qsp_wnd_unused(qsp);
+	qnode_hello->seg.sid = 0;
+	qnode_hello->seg.msn = 0;
+
+	qsp_encode_seg(qsp->buff, qnode_hello);
+	if (qsp->hs_state == QSP_HS_DONE)
+		memcpy((char*)qsp->buff + QSP_HEAD_SIZE, qsp->cookie, ICOOKIE_SIZE);
+	else
+		memset((char*)qsp->buff + QSP_HEAD_SIZE, 0, ICOOKIE_SIZE);
+
+	qsp->hs_ts = qsp_click(qsp);
+
+	return qsp_output(qsp, qsp->buff, QSP_HEAD_SIZE + ICOOKIE_SIZE);
+}
+
+// 请求重发报文片段（只有在半双工时调用）
+static int qsp_request_again(QSP *qsp, IUINT16 sid, IUINT32 msn, IUINT32 frg)
+{
+	qsp->stats.again_sent++;
+	ITRACE(ITRACE_AGAIN_SEND, qsp->conv, sid, msn, frg, 0);
+	return qsp_send_cmd(qsp, QSP_CMD_AGAIN, sid, msn, frg);
+}
+
+// 设置MTU，MSS为MTU减去报文头部（加密会话再减去加密开销）
+static void qsp_mtu_apply(QSP *qsp, IUINT32 mtu)
+{
+	assert(qsp);
+
+	qsp->mtu = mtu;
+	qsp->mss = mtu - QSP_HEAD_SIZE - (qsp->aead != NULL ? QSP_CRYPTO_OVERHEAD : 0);
+}
+
+// 缓冲区至少为size字节（只扩大，不缩小），失败时保留原来的缓冲区
+static int qsp_buff_reserve(QSP *qsp, IUINT32 size)
+{
+	assert(qsp);
+
+	void *buff;
+
+	if (size <= qsp->bufsize)
+		return 0;
+
+	buff = malloc_hook(size);
+	if (buff == NULL)
+	{
+		log_error("[qsp_buff_reserve : %d] : error, malloc_hook function return NULL", __LINE__);
+		return -1;
+	}
+
+	free_hook(qsp->buff);
+	qsp->buff = buff;
+	qsp->bufsize = size;
+
+	return 0;
+}
+
+// 发送路径MTU探测包：数据为全0的填充，整个数据包（包括加密开销）为size字节
+static int qsp_send_probe(QSP *qsp, IUINT32 size)
+{
+	assert(qsp);
+
+	QSPNODE *qnode_probe = qsp->buff;
+	int len = (int)size - (int)QSP_HEAD_SIZE - (qsp->aead != NULL ? QSP_CRYPTO_OVERHEAD : 0);
+
+	qnode_probe->seg.conv = qsp->conv;
+	qnode_probe->seg.frg = size;
+	qnode_probe->seg.ts = qsp_click(qsp);
+	qnode_probe->seg.sn = 1;
+	qnode_probe->seg.cmd = QSP_CMD_PMTU;
+	qnode_probe->seg.mode = qsp->mode;
+	qnode_probe->seg.ver = qsp->ver;
+	qnode_probe->seg.len = len;
+	qnode_probe->seg.wnd = qsp_wnd_unused(qsp);
+	qnode_probe->seg.sid = 0;
+	qnode_probe->seg.msn = 0;
+
+	qsp_encode_seg(qsp->buff, qnode_probe);
+	memset((char*)qsp->buff + QSP_HEAD_SIZE, 0, len);
+
+	qsp->stats.pmtu_sent++;
+	ITRACE(ITRACE_PROBE, qsp->conv, 0, 0, 0, size);
+
+	return qsp_output(qsp, qsp->buff, QSP_HEAD_SIZE + len);
+}
+
+// 收到探测包的回应：确认该大小，下一轮探测更大的值
+static void qsp_pmtu_ack(QSP *qsp, IUINT32 size)
+{
+	assert(qsp);
+
+	if (qsp->pmtu_probe == 0 || size != qsp->pmtu_probe)
+		return;
+
+	qsp->stats.pmtu_acked++;
+	qsp->pmtu_lo = size;
+	qsp->pmtu_probe = 0;
+	qsp->pmtu_ts = qsp_click(qsp);
+
+	// 分块发送的报文按开始时的MSS计算片段数，结束后再使用新的MTU
+	if (qsp->chk_count == 0)
+		qsp_mtu_apply(qsp, size);
+}
+
+// 路径MTU探测（RFC 8899 DPLPMTUD）：在已确认的大小与上限之间二分查找，每个探测包按重传超时最多发送
+// QSP_PMTU_PROBES次，没有回应时降低上限；探测包不携带数据，丢失不影响报文的传输（只用于半双工模式）
+static void qsp_pmtu_check(QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 current = qsp_click(qsp);
+
+	if (qsp->pmtu_max == 0 || qsp->mode != QSP_MODE_HALF)
+		return;
+
+	if (qsp->pmtu_lo != qsp->mtu && qsp->chk_count == 0)
+		qsp_mtu_apply(qsp, qsp->pmtu_lo);
+
+	if (qsp->pmtu_probe == 0)
+	{
+		// 搜索已经结束：等待QSP_PMTU_RAISE后重新向上探测（路径可能已经变化）
+		if (qsp->pmtu_hi < qsp->pmtu_lo + QSP_PMTU_STEP)
+		{
+			if (_itimediff(current, qsp->pmtu_ts) < QSP_PMTU_RAISE)
+				return;
+			qsp->pmtu_hi = qsp->pmtu_max;
+			if (qsp->pmtu_hi < qsp->pmtu_lo + QSP_PMTU_STEP)
+			{
+				qsp->pmtu_ts = current;
+				return;
+			}
+		}
+
+		qsp->pmtu_probe = qsp->pmtu_lo + (qsp->pmtu_hi - qsp->pmtu_lo + 1) / 2;
+		qsp->pmtu_xmit = 0;
+	}
+	else if (_itimediff(current, qsp->pmtu_ts) < (long)qsp->rx_rto)
+	{
+		return;
+	}
+	else if (qsp->pmtu_xmit >= QSP_PMTU_PROBES)
+	{
+		// 连续没有回应：超过路径MTU，缩小搜索范围
+		qsp->pmtu_hi = qsp->pmtu_probe - 1;
+		qsp->pmtu_probe = 0;
+		qsp->pmtu_ts = current;
+		return;
+	}
+
+	qsp->pmtu_xmit++;
+	qsp->pmtu_ts = current;
+	if (qsp_send_probe(qsp, qsp->pmtu_probe) < 0)
+		log_error("[qsp_pmtu_check : %d] : error, qsp_send_probe return < 0", __LINE__);
+}
+
+// 发送一个节点（印上时间戳）
+static int qsp_send_node(QSP *qsp, QSPNODE *qnode)
+{
+	assert(qsp);
+	assert(qnode);
+
+	char *buf = qsp->buff;
+	int datalen = qnode->seg.len;
+	int size = 0;
+
+	qnode->seg.wnd = qsp_wnd_unused(qsp);		// 捎带本端接收窗口的剩余大小
+
+	memcpy(buf, &qnode->seg, QSP_HEAD_SIZE);
+	size = QSP_HEAD_SIZE;
+
+	buf = qsp_encode_seg(buf, qnode);
+
+	memcpy(buf, qnode->seg.data, datalen);
+	size += datalen;
+
+	qnode->ts = qsp_click(qsp);					// 保存该节点发送的时间戳
+	qnode->xmit++;
+
+	return qsp_output(qsp, qsp->buff, size);	// 调用用户发送数据回调函数
+}
+
+// 解析字节流数据:按流序号（frg）有序插入rcv_buf，连续的片段移动到rcv_queue中
+// 返回值：0该报文不是重复的报文 ，非0是重复的报文
+static int qsp_parse_stream(QSP *qsp, QSPLANE *lane, QSPNODE *newnode)
+{
+	assert(qsp);
+	assert(lane);
+	assert(newnode);
+
+	int repeat = 0;	//是否是重复的报文
+	struct IQUEUEHEAD *p;
+	IUINT32 frg = newnode->seg.frg;
+
+	// 单工模式不会重传，跳过丢失的片段
+	if (newnode->seg.mode == QSP_MODE_SINGLE && _itimediff(frg, lane->rcv_nxt) > 0)
+		lane->rcv_nxt = frg;
+
+	// 已经移动到rcv_queue中的片段是重复的报文
+	if (_itimediff(frg, lane->rcv_nxt) < 0)
+		repeat = 1;
+
+	// 从队尾查找插入位置（rcv_buf按流序号从小到大排列）
+	for (p = lane->rcv_buf.prev; repeat == 0 && p != &lane->rcv_buf; p = p->prev)
+	{
+		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		if (qnode->seg.frg == frg)
+			repeat = 1;
+		else if (_itimediff(frg, qnode->seg.frg) > 0)
+			break;
+	}
+
+	// 丢弃重复的报文
+	if (repeat == 1)
+	{
+		qsp_segment_delete(newnode);
+	}
+	else
+	{
+		iqueue_init(&newnode->node);
+		iqueue_add(&newnode->node, p);
+		qsp_mem_inc(qsp, QSP_MEM_RCV_BUF, newnode);
+		qsp->nrcv_buf++;
+	}
+
+	// 移动连续的片段到rcv_queue
+	while (!iqueue_is_empty(&lane->rcv_buf))
+	{
+		QSPNODE *qnode = iqueue_entry(lane->rcv_buf.next, QSPNODE, node);
+		if (qnode->seg.frg != lane->rcv_nxt)
+			break;
+
+		iqueue_del(&qnode->node);
+		qsp_mem_dec(qsp, QSP_MEM_RCV_BUF, qnode);
+		qsp->nrcv_buf--;
+		iqueue_add_tail(&qnode->node, &lane->rcv_queue);
+		qsp_mem_inc(qsp, QSP_MEM_RCV_QUEUE, qnode);
+		lane->nrcv_que++;
+		qsp->nrcv_que++;
+		lane->rcv_nxt++;
+	}
+
+	return repeat;
+}
+
+// 逻辑流下一个待接收片段的包号（消息模式下报文的第一个片段还没有到达时，根据rcv_buf中同一报文的片段计算，未知返回-1）
+static IUINT32 qsp_lane_expect(const QSPLANE *lane)
+{
+	assert(lane);
+
+	QSPNODE *qnode;
+
+	if (lane->rcv_nxt != (IUINT32)-1 || iqueue_is_empty(&lane->rcv_buf))
+		return lane->rcv_nxt;
+
+	qnode = iqueue_entry(lane->rcv_buf.next, QSPNODE, node);
+	if (qnode->seg.sn == QSP_STREAM_SN || qnode->seg.msn != lane->rcv_msn || qnode->seg.cmd == QSP_CMD_DROP)
+		return lane->rcv_nxt;
+
+	return qnode->seg.sn - 1;
+}
+
+// 放弃逻辑流中报文序号小于msn、没有接收完整的报文（丢失的片段不会再到达：单工模式新报文到达，或者发送方放弃了报文）
+static void qsp_lane_abandon(QSP *qsp, QSPLANE *lane, IUINT32 msn)
+{
+	assert(qsp);
+	assert(lane);
+
+	QSPNODE *qnode;
+
+	while (!iqueue_is_empty(&lane->rcv_buf))
+	{
+		qnode = iqueue_entry(lane->rcv_buf.next, QSPNODE, node);
+		if (_itimediff(qnode->seg.msn, msn) >= 0)
+			break;
+
+		iqueue_del(&qnode->node);
+		qsp_mem_dec(qsp, QSP_MEM_RCV_BUF, qnode);
+		qsp_segment_delete(qnode);
+		qsp->nrcv_buf--;
+	}
+
+	// rcv_queue队尾已经移动过去的部分片段
+	while (!iqueue_is_empty(&lane->rcv_queue))
+	{
+		qnode = iqueue_entry(lane->rcv_queue.prev, QSPNODE, node);
+		if (qnode->seg.sn == QSP_STREAM_SN || qnode->seg.frg == 0)
+			break;
+
+		iqueue_del(&qnode->node);
+		qsp_mem_dec(qsp, QSP_MEM_RCV_QUEUE, qnode);
+		qsp_segment_delete(qnode);
+		lane->nrcv_que--;
+		qsp->nrcv_que--;
+	}
+
+	lane->rcv_msn = msn;
+	lane->rcv_nxt = (IUINT32)-1;
+}
+
+// 解析数据:判断该节点，如果不重复就放入rcv_buf中，如果是rev_queue的下一个数据，就移动到recv_queue中
+// 返回值：0该报文不是重复的报文 ，非0是重复的报文
+int qsp_parse_data(QSP *qsp, QSPNODE *newnode)
+{
+	assert(qsp);
+	assert(newnode);
+
+	int repeat = 0;	//是否是重复的报文
+	struct IQUEUEHEAD *p;
+	IUINT32 frg = newnode->seg.frg;
+	IUINT32 sn = newnode->seg.sn;
+	IUINT32 msn = newnode->seg.msn;
+	QSPLANE *lane = &qsp->lane[newnode->seg.sid];
+
+	// 字节流模式的报文片段
+	if (sn == QSP_STREAM_SN)
+		return qsp_parse_stream(qsp, lane, newnode);
+
+	// 新报文到达，上一个报文已经不会再完整（单工模式不重传；微双工模式同时只有一个报文，上一个报文已经被放弃）
+	if (newnode->seg.mode != QSP_MODE_HALF && newnode->seg.cmd == QSP_CMD_PUSH && _itimediff(msn, lane->rcv_msn) > 0)
+		qsp_lane_abandon(qsp, lane, msn);
+
+	// 已经接收完整的报文，或者当前报文已经移动到rcv_queue中的片段是重复的报文
+	if (_itimediff(msn, lane->rcv_msn) < 0)
+		repeat = 1;
+	else if (msn == lane->rcv_msn && lane->rcv_nxt != (IUINT32)-1 && frg > lane->rcv_nxt && newnode->seg.cmd == QSP_CMD_PUSH)
+		repeat = 1;
+
+	// 从队尾查找插入位置（rcv_buf按报文序号从小到大、包号从大到小排列，放弃报文的标记包号为-1，排在该报文的最前面）
+	for (p = lane->rcv_buf.prev; repeat == 0 && p != &lane->rcv_buf; p = p->prev)
+	{
+		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		long diff = _itimediff(msn, qnode->seg.msn);
+		if (diff == 0 && qnode->seg.frg == frg)
+			repeat = 1;
+		else if (diff > 0 || (diff == 0 && qnode->seg.frg > frg))
+			break;
+	}
+
+	// 丢弃重复的报文
+	if (repeat == 1)
+	{
+		qsp_segment_delete(newnode);
+	}
+	else
+	{
+		iqueue_init(&newnode->node);
+		iqueue_add(&newnode->node, p);
+		qsp_mem_inc(qsp, QSP_MEM_RCV_BUF, newnode);
+		qsp->nrcv_buf++;
+	}
+
+	// 移动有效（与rev_queue的节点的下一个）的数据到rev_queue
+	while (!iqueue_is_empty(&lane->rcv_buf))
+	{
+		QSPNODE *qnode = iqueue_entry(lane->rcv_buf.next, QSPNODE, node);
+		if (qnode->seg.msn != lane->rcv_msn)
+			break;
+
+		// 发送方放弃了该报文，跳过该报文序号（删除该报文已经接收的片段）
+		if (qnode->seg.cmd == QSP_CMD_DROP)
+		{
+			qsp_lane_abandon(qsp, lane, lane->rcv_msn + 1);
+			continue;
+		}
+
+		if (qnode->seg.frg != qsp_lane_expect(lane))
+			break;
+
+		iqueue_del(&qnode->node);
+		qsp_mem_dec(qsp, QSP_MEM_RCV_BUF, qnode);
+		qsp->nrcv_buf--;
+
+		// 报文接收完整，等待下一个报文
+		if (qnode->seg.frg == 0)
+		{
+			lane->rcv_nxt = (IUINT32)-1;
+			lane->rcv_msn++;
+
+			// 报文重组延迟：该报文最早到达的片段到现在的时间（已经移动的片段在rcv_queue队尾）
+			if (qsp->hist != NULL && qsp->chunk == NULL)
+			{
+				IUINT32 first = qnode->ts;
+				for (p = lane->rcv_queue.prev; p != &lane->rcv_queue; p = p->prev)
+				{
+					QSPNODE *q = iqueue_entry(p, QSPNODE, node);
+					if (q->seg.sn == QSP_STREAM_SN || q->seg.msn != qnode->seg.msn)
+						break;
+					if (_itimediff(q->ts, first) < 0)
+						first = q->ts;
+				}
+				qsp_hist_record(qsp, QSP_HIST_MSG_REASM, qnode->seg.sn, _itimediff(qsp_click(qsp), first));
+			}
+		}
+		else
+		{
+			lane->rcv_nxt = qnode->seg.frg - 1;
+		}
+
+		// 分块接收：有序的片段直接交给回调函数，不在rcv_queue中拼接（只用于0号逻辑流，压缩的报文要整体解压，仍然放入rcv_queue）
+		// 回调函数返回非0时放弃该报文：剩余的片段到达后回应ACK并丢弃，不再交给回调函数
+		if (qsp->chunk && lane == &qsp->lane[0] && !(qnode->seg.flags & QSP_FLAG_ZIP))
+		{
+			int last = qnode->seg.frg == 0;
+			int hr = qsp->chunk(qnode->seg.data, qnode->seg.len, last, qsp, qsp->user);
+			qsp_segment_delete(qnode);
+			qsp->wnd_drain++;
+			if (hr != 0 && !last)
+				qsp_lane_abandon(qsp, lane, lane->rcv_msn + 1);
+			continue;
+		}
+
+		iqueue_add_tail(&qnode->node, &lane->rcv_queue);
+		qsp_mem_inc(qsp, QSP_MEM_RCV_QUEUE, qnode);
+		lane->nrcv_que++;
+		qsp->nrcv_que++;
+	}
+
+	return repeat;
+}
+
+// 查看逻辑流待接收缓存队列中的数据大小
+static int qsp_lane_peeksize(const QSP *qsp, const QSPLANE *lane)
+{
+	assert(qsp);
+	assert(lane);
+
+	struct IQUEUEHEAD *p;
+	QSPNODE *qnode;
+	int length = 0;
+
+	// 队列为空
+	if (iqueue_is_empty(&lane->rcv_queue))
+		return length;
+
+	// 字节流模式，累计所有连续片段的长度
+	if (qsp->stream)
+	{
+		for (p = lane->rcv_queue.next; p != &lane->rcv_queue; p = p->next)
+			length += iqueue_entry(p, QSPNODE, node)->seg.len;
+		return length;
+	}
+
+	// 只有一个节点，没有后续报文片段
+	qnode = iqueue_entry(lane->rcv_queue.next, QSPNODE, node);
+	if (qnode->seg.frg == 0 && !(qnode->seg.flags & QSP_FLAG_ZIP)) return qnode->seg.len;
+
+	// 有多个报文片段，累计各个片段长度总和
+	for (p = lane->rcv_queue.next; p != &lane->rcv_queue; p = p->next) {
+		qnode = iqueue_entry(p, QSPNODE, node);
+		length += qnode->seg.len;
+		if (qnode->seg.frg == 0) break;
+	}
+
+	// 压缩的报文返回原长（不超过压缩数据的最大压缩比，否则为数据错误）
+	qnode = iqueue_entry(lane->rcv_queue.next, QSPNODE, node);
+	if (qnode->seg.flags & QSP_FLAG_ZIP)
+	{
+		IUINT32 raw;
+
+		if (qnode->seg.len < 4 || length <= 4)
+			return -2;
+		qsp_decode32u(qnode->seg.data, &raw);
+		if ((IUINT64)raw > (IUINT64)(length - 4) * ILZ_RATIO_MAX + 64 || raw > 0x7fffffff)
+			return -2;
+		return (int)raw;
+	}
+
+	return length;
+}
+
+// 选择下一个读取的逻辑流（有可读取数据的逻辑流中优先级最高的），没有返回NULL
+static QSPLANE* qsp_lane_select(const QSP *qsp)
+{
+	assert(qsp);
+
+	const QSPLANE *best = NULL;
+	int i;
+
+	for (i = 0; i < QSP_LANE_NUM; i++)
+	{
+		const QSPLANE *lane = &qsp->lane[i];
+		if (!qsp_lane_ready(lane))
+			continue;
+		if (best == NULL || lane->prio < best->prio)
+			best = lane;
+	}
+
+	return (QSPLANE*)best;
+}
+
+// 发送调度：逻辑流lane的队首片段是否应该比best的队首片段先发送
+static int qsp_sched_before(const QSP *qsp, const QSPLANE *lane, const QSPLANE *best)
+{
+	assert(qsp);
+	assert(lane);
+	assert(best);
+
+	// 最早截止时间优先：有期限的报文先于没有期限的报文，期限早的先发送
+	if (qsp->sched == QSP_SCHED_EDF)
+	{
+		IUINT32 a = iqueue_entry(lane->snd_queue.next, QSPNODE, node)->expire;
+		IUINT32 b = iqueue_entry(best->snd_queue.next, QSPNODE, node)->expire;
+
+		if (a != 0 && b == 0)
+			return 1;
+		if (a == 0 && b != 0)
+			return 0;
+		if (a != b)
+			return _itimediff(a, b) < 0;
+	}
+
+	// 严格优先级
+	if (lane->prio != best->prio)
+		return lane->prio < best->prio;
+
+	// 同一优先级按权重公平分配：虚拟时间小的先发送
+	return _itimediff(lane->vtime, best->vtime) < 0;
+}
+
+// 选择下一个发送片段的逻辑流（队首片段可以发送的逻辑流中调度顺序最先的），没有返回NULL
+// 微双工模式的ACK不携带报文序号，同时只能有一个报文等待ACK，新报文需要等待上一个报文的ACK全部返回
+static QSPLANE* qsp_lane_next(QSP *qsp)
+{
+	assert(qsp);
+
+	QSPLANE *best = NULL;
+	int i;
+
+	for (i = 0; i < QSP_LANE_NUM; i++)
+	{
+		QSPLANE *lane = &qsp->lane[i];
+		QSPNODE *qnode;
+
+		if (iqueue_is_empty(&lane->snd_queue))
+			continue;
+
+		qnode = iqueue_entry(lane->snd_queue.next, QSPNODE, node);
+		if (qnode->seg.mode == QSP_MODE_WEAK && qnode->seg.sn != QSP_STREAM_SN &&
+			qnode->seg.frg == qnode->seg.sn - 1 && lane->nsnd_buf != 0)
+			continue;
+
+		// 空闲之后重新有数据的逻辑流从当前的虚拟时间开始，不补偿空闲期间的带宽
+		if (_itimediff(lane->vtime, qsp->vtime) < 0)
+			lane->vtime = qsp->vtime;
+
+		if (best == NULL || qsp_sched_before(qsp, lane, best))
+			best = lane;
+	}
+
+	return best;
+}
+
+// 查看待接收缓存队列中的数据大小（下一个读取的逻辑流）
+int qsp_peeksize(const QSP *qsp)
+{
+	assert(qsp);
+
+	QSPLANE *lane = qsp_lane_select(qsp);
+
+	if (lane == NULL)
+		return 0;
+
+	return qsp_lane_peeksize(qsp, lane);
+}
+
+// 删除队列中属于报文（sid, msn）的所有片段，返回删除的片段数
+static int qsp_queue_remove(QSP *qsp, struct IQUEUEHEAD *head, int que, IUINT16 sid, IUINT32 msn)
+{
+	assert(qsp);
+	assert(head);
+
+	struct IQUEUEHEAD *p, *next;
+	int count = 0;
+
+	for (p = head->next; p != head; p = next)
+	{
+		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		next = p->next;
+		if (qnode->seg.sid != sid || qnode->seg.msn != msn || qnode->seg.sn == QSP_STREAM_SN)
+			continue;
+
+		iqueue_del(p);
+		qsp_mem_dec(qsp, que, qnode);
+		qsp_segment_delete(qnode);
+		count++;
+	}
+
+	return count;
+}
+
+// 放弃一个报文：删除待发送与等待ACK的片段，通知接收方跳过该报文（DROP放入snd_buf，超时重发直到回应ACK）
+static void qsp_abandon(QSP *qsp, IUINT16 sid, IUINT32 msn)
+{
+	assert(qsp);
+
+	QSPLANE *lane = &qsp->lane[sid];
+	QSPNODE *qnode;
+	int count;
+
+	count = qsp_queue_remove(qsp, &qsp->snd_buf, QSP_MEM_SND_BUF, sid, msn);
+	lane->nsnd_buf -= count;
+	qsp->nsnd_buf -= count;
+
+	count = qsp_queue_remove(qsp, &lane->snd_queue, QSP_MEM_SND_QUEUE, sid, msn);
+	lane->nsnd_que -= count;
+	qsp->nsnd_que -= count;
+
+	// 单工模式的接收方在新报文到达时放弃没有接收完整的报文
+	if (qsp->mode == QSP_MODE_SINGLE)
+		return;
+
+	qnode = qsp_segment_new(0);
+	if (qnode == NULL)
+	{
+		log_error("[qsp_abandon : %d] : error, qsp_segment_new function return NULL", __LINE__);
+		return;
+	}
+
+	qnode->seg.conv = qsp->conv;
+	qnode->seg.frg = (IUINT32)-1;
+	qnode->seg.ts = qsp_click(qsp);
+	qnode->seg.sn = 1;
+	qnode->seg.cmd = QSP_CMD_DROP;
+	qnode->seg.mode = qsp->mode;
+	qnode->seg.ver = qsp->ver;
+	qnode->seg.len = 0;
+	qnode->seg.sid = sid;
+	qnode->seg.msn = msn;
+
+	if (qsp_send_node(qsp, qnode) != QSP_HEAD_SIZE)
+		log_error("[qsp_abandon : %d] : error, qsp_send_node return length error", __LINE__);
+
+	iqueue_add_tail(&qnode->node, &qsp->snd_buf);
+	qsp_mem_inc(qsp, QSP_MEM_SND_BUF, qnode);
+	lane->nsnd_buf++;
+	qsp->nsnd_buf++;
+}
+
+// 查找一个超过期限的报文片段（snd_buf与各个逻辑流的snd_queue），没有返回NULL
+static QSPNODE* qsp_expired(QSP *qsp, IUINT32 current)
+{
+	assert(qsp);
+
+	struct IQUEUEHEAD *p;
+	int i;
+
+	for (p = qsp->snd_buf.next; p != &qsp->snd_buf; p = p->next)
+	{
+		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		if (qnode->expire != 0 && qnode->seg.cmd == QSP_CMD_PUSH && _itimediff(current, qnode->expire) >= 0)
+			return qnode;
+	}
+
+	for (i = 0; i < QSP_LANE_NUM; i++)
+	{
+		for (p = qsp->lane[i].snd_queue.next; p != &qsp->lane[i].snd_queue; p = p->next)
+		{
+			QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+			if (qnode->expire != 0 && _itimediff(current, qnode->expire) >= 0)
+				return qnode;
+		}
+	}
+
+	return NULL;
+}
+
+// 放弃所有超过期限的报文，把带宽留给新的数据
+static void qsp_expire(QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 current = qsp_click(qsp);
+	QSPNODE *qnode;
+
+	while ((qnode = qsp_expired(qsp, current)) != NULL)
+	{
+		ITRACE(ITRACE_EXPIRE, qsp->conv, qnode->seg.sid, qnode->seg.msn, qnode->seg.frg, qnode->seg.sn);
+		qsp_abandon(qsp, qnode->seg.sid, qnode->seg.msn);
+	}
+}
+
+// 会话失效：释放所有队列（不再重传、不再交付），通知应用
+static void qsp_kill(QSP *qsp, int reason)
+{
+	assert(qsp);
+
+	if (qsp->dead)
+		return;
+
+	qsp->dead = reason;
+	log_warn("[qsp_kill : %d] : warning, session 0x%08X is dead, reason %d", __LINE__, qsp->conv, reason);
+
+	qsp_queues_release(qsp);
+	qsp_stats_sync(qsp);
+
+	if (qsp->deadlink != NULL)
+		qsp->deadlink(qsp, reason, qsp->user);
+}
+
+// 检测对端是否失效（有待发送的数据时对端无响应 / 空闲超时），对端安静时发送保活探测（WASK，对端回应WINS）
+static int qsp_check_link(QSP *qsp)
+{
+	assert(qsp);
+
+	IUINT32 current = qsp_click(qsp);
+	long silent;
+
+	if (qsp->dead)
+		return qsp->dead;
+
+	// 第一次检测时开始计时
+	if (qsp->rcv_ts == 0)
+		qsp->rcv_ts = current;
+	silent = _itimediff(current, qsp->rcv_ts);
+
+	if (qsp->dead_time != 0 && silent > (long)qsp->dead_time && (qsp->nsnd_que != 0 || !iqueue_is_empty(&qsp->snd_buf)))
+		qsp_kill(qsp, QSP_DEAD_TIMEOUT);
+	else if (qsp->idle != 0 && silent > (long)qsp->idle)
+		qsp_kill(qsp, QSP_DEAD_IDLE);
+	else if (qsp->keepalive != 0 && qsp->mode == QSP_MODE_HALF && silent >= (long)qsp->keepalive
+		&& _itimediff(current, qsp->ka_ts) >= (long)qsp->keepalive)
+	{
+		ITRACE(ITRACE_PROBE, qsp->conv, 0, 0, 0, 1);
+		qsp_send_cmd(qsp, QSP_CMD_WASK, 0, 0, 0);
+		qsp->ka_ts = current;
+	}
+
+	return qsp->dead;
+}
+
+// 发送一轮数据（不阻塞）：放弃超过期限的报文，重传超时的报文片段，在发送窗口内发送新的报文片段
+static void qsp_send_once(QSP *qsp)
+{
+	assert(qsp);
+
+	struct IQUEUEHEAD *p;
+	QSPNODE *qnode;
+	QSPLANE *lane;
+	IUINT32 current = qsp_click(qsp);
+
+	// 放弃超过期限的报文，不再重传
+	qsp_expire(qsp);
+
+	// 握手：收到cookie之前只按重传超时（指数退避）发送HELLO
+	if (qsp->hs_state == QSP_HS_WAIT)
+	{
+		if (qsp->hs_xmit > 0 && _itimediff(current, qsp->hs_ts) < (long)qsp_backoff(qsp, qsp->hs_xmit - 1))
+			return;
+		if (qsp->dead_xmit != 0 && qsp->hs_xmit >= qsp->dead_xmit)
+		{
+			qsp_kill(qsp, QSP_DEAD_RETRY);
+			return;
+		}
+		qsp->hs_xmit++;
+		qsp_send_hello(qsp);
+		return;
+	}
+
+	// 路径MTU探测
+	qsp_pmtu_check(qsp);
+
+	// 遍历snd_buf队列，检测没有回应ACK超时的节点重新发送（重传先于新的报文片段）
+	for (p = qsp->snd_buf.next; p != &qsp->snd_buf; p = p->next)
+	{
+		qnode = iqueue_entry(p, QSPNODE, node);
+		// 超时重发数据（每次超时等待时间加倍），重传次数达到上限认为对端失效
+		if (_itimediff(current, qnode->ts) > (long)qsp_backoff(qsp, qnode->rexmit))
+		{
+			if (qsp->dead_xmit != 0 && qnode->rexmit >= qsp->dead_xmit)
+			{
+				qsp_kill(qsp, QSP_DEAD_RETRY);
+				return;
+			}
+			qnode->rexmit++;
+			qsp_cc_loss(qsp, 1);
+			ITRACE(ITRACE_RESEND, qsp->conv, qnode->seg.sid, qnode->seg.msn, qnode->seg.frg, qnode->seg.len);
+			if (qsp_send_node(qsp, qnode) != qnode->seg.len + QSP_HEAD_SIZE)
+				log_error("[qsp_send_once : %d] : error, qsp_send_node return length error", __LINE__);
+			qsp->lane[qnode->seg.sid].nresend++;
+			qsp->stats.seg_resent++;
+			qsp->stats.byte_resent += qnode->seg.len + QSP_HEAD_SIZE;
+		}
+	}
+
+	// 检测待发送队列 -> 发送数据（放入snd_buf中，待ACK确认），按调度方式选择逻辑流
+	while ((lane = qsp_lane_next(qsp)) != NULL)
+	{
+		qnode = iqueue_entry(lane->snd_queue.next, QSPNODE, node);
+
+		// 等待ACK的报文片段不能超过发送窗口（单工模式没有ACK，不受窗口限制）
+		if (qsp->mode != QSP_MODE_SINGLE && qsp->nsnd_buf >= qsp_wnd_send(qsp))
+			break;
+
+		// 统计等待时间，推进虚拟时间（按字节数与权重）
+		if (_itimediff(current, qnode->seg.ts) > 0)
+		{
+			lane->wait_sum += (IUINT32)_itimediff(current, qnode->seg.ts);
+			lane->wait_max = _imax_(lane->wait_max, (IUINT32)_itimediff(current, qnode->seg.ts));
+		}
+		lane->nsent++;
+		qsp->stats.seg_sent++;
+		ITRACE(ITRACE_SEND, qsp->conv, qnode->seg.sid, qnode->seg.msn, qnode->seg.frg, qnode->seg.len);
+		qsp->vtime = lane->vtime;
+		lane->vtime += (qnode->seg.len + QSP_HEAD_SIZE) * QSP_WEIGHT_MAX / lane->weight;
+
+		// 根据通信模式，来判断发送次数
+		int count = qsp->mode == QSP_MODE_SINGLE ? (int)qsp->copies : 1;
+		for (int i = 0; i < count; i++)
+		{
+			if (qsp_send_node(qsp, qnode) != qnode->seg.len + QSP_HEAD_SIZE)
+				log_error("[qsp_send_once : %d] : error, qsp_send_node return length error", __LINE__);
+		}
+
+		// 单工通信模式不需要超时重发，与ACK确认
+		if (qsp->mode != QSP_MODE_SINGLE)
+		{
+			iqueue_del(&qnode->node);
+			qsp_mem_dec(qsp, QSP_MEM_SND_QUEUE, qnode);
+			iqueue_add_tail(&qnode->node, &qsp->snd_buf);
+			qsp_mem_inc(qsp, QSP_MEM_SND_BUF, qnode);
+			lane->nsnd_buf++;
+			qsp->nsnd_buf++;
+		}
+		else
+		{
+			iqueue_del(&qnode->node);
+			qsp_mem_dec(qsp, QSP_MEM_SND_QUEUE, qnode);
+			qsp_segment_delete(qnode);
+		}
+		lane->nsnd_que--;
+		qsp->nsnd_que--;
+	}
+
+	// 对端接收窗口为0，定时发送窗口探测
+	if (qsp->mode != QSP_MODE_SINGLE && qsp->nsnd_que != 0 && iqueue_is_empty(&qsp->snd_buf) && qsp->rmt_wnd == 0
+		&& _itimediff(qsp_click(qsp), qsp->probe_ts) >= QSP_TIME_OUT)
+	{
+		ITRACE(ITRACE_PROBE, qsp->conv, 0, 0, 0, 0);
+		qsp_send_cmd(qsp, QSP_CMD_WASK, 0, 0, 0);
+		qsp->probe_ts = qsp_click(qsp);
+	}
+}
+
+// 检测待发送队列 -> 发送一组数据（放入snd_buf中，待ACK确认），阻塞直到全部确认（非阻塞模式只发送一轮）
+int qsp_send_flush(QSP *qsp)
+{
+	assert(qsp);
+
+	ITRACE(ITRACE_FLUSH, qsp->conv, 0, 0, 0, qsp->nsnd_que);
+
+	qsp_send_once(qsp);
+
+	// 单工通信模式不需要ACK回应，非阻塞模式由qsp_update继续发送
+	if (qsp->mode == QSP_MODE_SINGLE || qsp->nonblock)
+	{
+		qsp_stats_sync(qsp);
+		return qsp->dead ? QSP_EDEAD : 0;
+	}
+
+	// 接收ACK回应
+	while (qsp->snd_buf.next != &qsp->snd_buf || qsp->nsnd_que != 0)
+	{
+		qsp_tick(qsp);
+
+		// 刷新接收缓冲区
+		if (qsp_recv_flush(qsp))
+			log_error("[qsp_send_flush : %d] : error, qsp_recv_flush return < 0", __LINE__);
+
+		qsp_send_once(qsp);
+
+		// 对端失效，队列已经释放
+		if (qsp_check_link(qsp))
+			return QSP_EDEAD;
+	}
+
+	qsp_stats_sync(qsp);
+
+	return qsp->dead ? QSP_EDEAD : 0;
+}
+
+// 接收一组数据 -> 待确认接收队列（放入recv_buf中，处理放入recv_queue）
+int qsp_recv_flush(QSP *qsp)
+{
+	assert(qsp);
+
+	// 接收数据 -> 判断cmd类型：QSP_CMD_ACK、QSP_CMD_PUSH、QSP_CMD_AGAIN
+	while (1)
+	{
+		char *buf = qsp->buff;
+		int ret = qsp_input(qsp, qsp->buff, (int)qsp->bufsize);
+
+		if (ret < 0)
+		{
+			log_error("[qsp_recv_flush.qsp_input : %d] : error, ret < 0", __LINE__);
+			return -1;
+		}
+		else if (ret == 0)	// 非阻塞没有读到数据
+		{
+			break;
+		}
+
+		// 阻塞模式下input回调可能等待了一段时间，重新读取时间
+		if (!qsp->nonblock)
+			qsp_tick(qsp);
+
+		qsp->stats.pkt_recv++;
+		qsp->stats.byte_recv += ret;
+
+		if (ret == 1 && qsp->mode != QSP_MODE_WEAK)
+		{
+			log_warn("[qsp_recv_flush : %d] : warning, one byte packet in non-weak mode", __LINE__);
+			qsp->stats.pkt_invalid++;
+			continue;
+		}
+		else if (ret == 1)	// QSP_MODE_WEAK（ACK报文）
+		{
+			IUINT8 ack;
+			qsp->rcv_ts = qsp_click(qsp);
+			qsp->stats.ack_recv++;
+			qsp_decode8u(qsp->buff, &ack);
+			qsp_parse_ack(qsp, 0, 0, ack, 0xff);
+			// 阻塞模式下处理一个ACK就返回（继续读取会阻塞），非阻塞模式下处理完已到达的所有ACK
+			if (!qsp->nonblock)
+				break;
+			continue;
+		}
+		else if (ret > 1)	// QSP_MODE_HALF 或 QSP_MODE_SINGLE 模式
+		{
+			IUINT32 conv, frg, ts, sn, msn;
+			IUINT16 cmd, mode, len, wnd, sid;
+			IUINT32 nrcv_que;
+			int repeat;
+			long offset;
+			QSPNODE *qnode;
+			QSPLANE *lane;
+
+			QSPSEG hdr;
+
+			// 格式错误的数据包丢弃并计数，不中断接收循环
+			if (ret < (int)QSP_HEAD_SIZE)
+			{
+				log_warn("[qsp_recv_flush : %d] : warning, packet is too short", __LINE__);
+				qsp->stats.pkt_invalid++;
+				continue;
+			}
+
+			// 判断报文标识
+			buf = (char*)qsp_decode_seg(buf, &hdr);
+			if (hdr.conv != qsp->conv)
+			{
+				log_warn("[qsp_recv_flush : %d] : warning, recv conv != qsp->conv", __LINE__);
+				qsp->stats.pkt_invalid++;
+				continue;
+			}
+
+			conv = hdr.conv, frg = hdr.frg, ts = hdr.ts, sn = hdr.sn, msn = hdr.msn;
+			cmd = hdr.cmd, mode = hdr.mode, len = hdr.len, wnd = hdr.wnd, sid = hdr.sid;
+
+			// 判断cmd类型
+			if (cmd != QSP_CMD_PUSH && cmd != QSP_CMD_ACK &&
+				cmd != QSP_CMD_AGAIN && cmd != QSP_CMD_WASK &&
+				cmd != QSP_CMD_WINS && cmd != QSP_CMD_DGRAM &&
+				cmd != QSP_CMD_DROP && cmd != QSP_CMD_HELLO &&
+				cmd != QSP_CMD_COOKIE && cmd != QSP_CMD_PMTU)
+			{
+				log_warn("[qsp_recv_flush : %d] : warning, cmd is unknow", __LINE__);
+				qsp->stats.pkt_invalid++;
+				continue;
+			}
+
+			// 判断逻辑流编号与数据长度
+			if (sid >= QSP_LANE_NUM || (int)len > ret - (int)QSP_HEAD_SIZE)
+			{
+				log_warn("[qsp_recv_flush : %d] : warning, sid or len is out of range", __LINE__);
+				qsp->stats.pkt_invalid++;
+				continue;
+			}
+
+			// 对端仍然存活
+			qsp->rcv_ts = qsp_click(qsp);
+
+			// 握手报文：HELLO由服务端的准入检查处理，会话中忽略；COOKIE保存后带回
+			if (cmd == QSP_CMD_HELLO)
+			{
+				continue;
+			}
+			else if (cmd == QSP_CMD_COOKIE)
+			{
+				if (qsp->hs_state == QSP_HS_NONE || len != ICOOKIE_SIZE)
+				{
+					qsp->stats.pkt_invalid++;
+					continue;
+				}
+
+				memcpy(qsp->cookie, buf, ICOOKIE_SIZE);
+				qsp->hs_state = QSP_HS_DONE;
+				if (qsp_send_hello(qsp) < 0)
+					return -2;
+				continue;
+			}
+
+			// 更新对端通告的接收窗口
+			qsp->rmt_wnd = wnd;
+			lane = &qsp->lane[sid];
+
+			if (cmd == QSP_CMD_ACK)
+			{
+				qsp->stats.ack_recv++;
+				qsp_parse_ack(qsp, sid, msn, frg, 0xffffffff);
+				if (!qsp->nonblock)
+					break;
+				continue;
+			}
+			else if (cmd == QSP_CMD_WASK)
+			{
+				qsp_send_cmd(qsp, QSP_CMD_WINS, 0, 0, 0);
+			}
+			else if (cmd == QSP_CMD_WINS)
+			{
+				break;
+			}
+			else if (cmd == QSP_CMD_PMTU)
+			{
+				// 路径MTU探测：完整到达的探测包回应收到的大小，len为0的是对端对本端探测的回应
+				if (len == 0)
+					qsp_pmtu_ack(qsp, frg);
+				else if (qsp->mode == QSP_MODE_HALF && frg == (IUINT32)ret + (qsp->aead != NULL ? QSP_CRYPTO_OVERHEAD : 0))
+					qsp_send_cmd(qsp, QSP_CMD_PMTU, 0, 0, frg);
+			}
+			else if (cmd == QSP_CMD_DROP)
+			{
+				// 发送方放弃了报文：回应ACK，在rcv_buf中放入放弃标记，接收到该报文序号时跳过（分配失败时丢弃且不回应ACK）
+				qnode = qsp_segment_new(0);
+				if (qnode == NULL)
+				{
+					log_error("[qsp_recv_flush : %d] : error, qsp_segment_new function return NULL", __LINE__);
+					continue;
+				}
+
+				qnode->seg.conv = conv;
+				qnode->seg.frg = frg;
+				qnode->seg.ts = ts;
+				qnode->seg.sn = sn;
+				qnode->seg.cmd = cmd;
+				qnode->seg.mode = mode;
+				qnode->seg.len = 0;
+				qnode->seg.sid = sid;
+				qnode->seg.msn = msn;
+
+				if (qsp_respond_ack(qsp, qnode) < 0)
+					return -2;
+
+				if (!qsp_parse_data(qsp, qnode) && _itimediff(lane->rcv_msn, msn) > 0)
+					break;
+			}
+			else if (cmd == QSP_CMD_DGRAM)
+			{
+				// 不可靠数据报：不回应ACK，不进入接收队列，直接交给回调函数
+				if (qsp->dgram == NULL)
+				{
+					log_warn("[qsp_recv_flush : %d] : warning, dgram callback is NULL", __LINE__);
+					continue;
+				}
+
+				qsp->dgram(buf, len, sid, qsp, qsp->user);
+			}
+			else if (cmd == QSP_CMD_PUSH)
+			{
+				qsp->stats.seg_recv++;
+				ITRACE(ITRACE_RECV, conv, sid, msn, frg, len);
+
+				// 接收窗口已满，丢弃且不回应ACK（发送方超时重传；单工模式不重传，丢弃的片段不会再到达，不受接收窗口限制）
+				offset = qsp_rcv_offset(qsp, lane, frg, sn, msn);
+				if (mode != QSP_MODE_SINGLE && !qsp_wnd_accept(qsp, offset))
+				{
+					ITRACE(ITRACE_REJECT_WND, conv, sid, msn, frg, len);
+					qsp->stats.seg_reject++;
+					continue;
+				}
+
+				// 超过内存硬限制，丢弃且不回应ACK
+				if (offset >= 0 && qsp_mem_check(qsp, sizeof(QSPNODE) + len, offset > 0))
+				{
+					ITRACE(ITRACE_REJECT_MEM, conv, sid, msn, frg, len);
+					qsp->stats.seg_reject++;
+					continue;
+				}
+
+				//创建一个新节点（分配失败时丢弃且不回应ACK）
+				qnode = qsp_segment_new(len);
+				if (qnode == NULL)
+				{
+					log_error("[qsp_recv_flush : %d] : error, qsp_segment_new function return NULL", __LINE__);
+					qsp->stats.seg_reject++;
+					continue;
+				}
+
+				qnode->seg.conv = conv;
+				qnode->seg.frg = frg;
+				qnode->seg.ts = ts;
+				qnode->seg.sn = sn;
+				qnode->seg.cmd = cmd;
+				qnode->seg.mode = mode;
+				qnode->seg.flags = hdr.flags;
+				qnode->seg.len = len;
+				qnode->seg.sid = sid;
+				qnode->seg.msn = msn;
+
+				if (len > 0)
+					memcpy(qnode->seg.data, buf, len);
+
+				// 到达时间（用于统计报文重组延迟）
+				if (qsp->hist != NULL)
+					qnode->ts = qsp_click(qsp);
+
+				// 回应ACK报文（解析数据时会释放重复的报文，先回应）
+				if (qsp_respond_ack(qsp, qnode) < 0)
+					return -2;
+
+				// 解析数据，如果重复报文则丢弃
+				nrcv_que = qsp->nrcv_que;
+				repeat = qsp_parse_data(qsp, qnode);
+				if (repeat)
+				{
+					qsp->stats.seg_dup++;
+					ITRACE(ITRACE_DUP, conv, sid, msn, frg, len);
+				}
+
+				// 判断丢包重补(半双工模式)
+				if (mode == QSP_MODE_HALF)
+				{
+					// rcv_buf中有节点，说明有丢包，要求重补
+					int count = 0;
+					QSPNODE *q;
+					IUINT32 expect = qsp_lane_expect(lane);
+					for (q = lane->rcv_buf.next; q != &lane->rcv_buf; q = q->node.next)
+						count++;
+					if (qsp->pass != 0 && count > (int)qsp->pass && expect != (IUINT32)-1)
+						qsp_request_again(qsp, sid, lane->rcv_msn, expect);
+				}
+
+				// 字节流模式有新的连续数据，跳出循环
+				if (sn == QSP_STREAM_SN)
+				{
+					if (qsp->nrcv_que != nrcv_que)
+						break;
+				}
+				// 满足接收完一组完整的报文片段，跳出循环
+				else if (!repeat && _itimediff(lane->rcv_msn, msn) > 0)
+				{
+					break;
+				}
+			}
+			else if (cmd == QSP_CMD_AGAIN)
+			{
+				struct IQUEUEHEAD *p;
+				qsp->stats.again_recv++;
+				for (p = qsp->snd_buf.next; p != &qsp->snd_buf; p = p->next)
+				{
+					QSPNODE *qn = iqueue_entry(p, QSPNODE, node);
+					if (qn->seg.sid == sid && qn->seg.msn == msn && qn->seg.frg == frg)
+					{
+						// 一个RTT内已经重传过：后面到达的请求是重传到达之前发出的，不再重复发送
+						if (qn->xmit > 1 && _itimediff(qsp_click(qsp), qn->ts) < (long)qsp->rx_srtt)
+							break;
+						ITRACE(ITRACE_AGAIN_RECV, conv, sid, msn, frg, qn->seg.len);
+						qsp_cc_loss(qsp, 0);
+						qsp_send_node(qsp, qn);
+						lane->nresend++;
+						qsp->stats.seg_resent++;
+						qsp->stats.byte_resent += qn->seg.len + QSP_HEAD_SIZE;
+						break;
+					}
+				}
+
+				break;
+			}
+		}
+		else
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+//--------------------------------------------------
+//	USER INTERFACE
+//--------------------------------------------------
+
+// 打印队列中节点信息
+void qsp_print(struct IQUEUEHEAD *head)
+{
+	assert(head);
+
+	QSPNODE *qnode = head->next;
+
+	for (qnode = head->next; qnode != head; qnode = qnode->node.next)
+	{
+		printf("--------------------------------------\n");
+		printf("conv : 0x%X\n", qnode->seg.conv);
+		printf("frg : %lu\n", qnode->seg.frg);
+		printf("ts : %lu\n", qnode->seg.ts);
+		printf("sn : %lu\n", qnode->seg.sn);
+		switch (qnode->seg.cmd)
+		{
+		case QSP_CMD_PUSH:
+			printf("cmd : %s\n", "QSP_CMD_PUSH");
+			break;
+		case QSP_CMD_ACK:
+			printf("cmd : %s\n", "QSP_CMD_ACK");
+			break;
+		case QSP_CMD_DGRAM:
+			printf("cmd : %s\n", "QSP_CMD_DGRAM");
+			break;
+		case QSP_CMD_DROP:
+			printf("cmd : %s\n", "QSP_CMD_DROP");
+			break;
+		default:
+			printf("cmd : %s\n", "unknow command");
+			break;
+		}
+		switch (qnode->seg.mode)
+		{
+		case QSP_MODE_HALF:
+			printf("mode : %s\n", "QSP_MODE_HALF");
+			break;
+		case QSP_MODE_WEAK:
+			printf("mode : %s\n", "QSP_MODE_WEAK");
+			break;
+		case QSP_MODE_SINGLE:
+			printf("mode : %s\n", "QSP_MODE_SINGLE");
+			break;
+		default:
+			printf("mode : %s\n", "unknow mode");
+			break;
+		}
+		printf("ver : %lu\n", qnode->seg.ver);
+		printf("len : %lu\n", qnode->seg.len);
+		printf("--------------------------------------\n");
+		printf("############     data     ############\n");
+		printf("--------------------------------------\n");
+	}
+}
+
+// 初始化逻辑流
+static void qsp_lane_init(QSPLANE *lane)
+{
+	assert(lane);
+
+	lane->snd_nxt = 0;
+	lane->rcv_nxt = (IUINT32)-1;
+	lane->snd_msn = 0;
+	lane->rcv_msn = 0;
+	lane->prio = QSP_PRIO_DEFAULT;
+	lane->weight = QSP_WEIGHT_DEFAULT;
+	lane->vtime = 0;
+	lane->nsnd_que = 0;
+	lane->nsnd_buf = 0;
+	lane->nrcv_que = 0;
+	lane->wait_max = 0;
+	lane->wait_sum = 0;
+	lane->nsent = 0;
+	lane->nresend = 0;
+
+	iqueue_init(&lane->snd_queue);
+	iqueue_init(&lane->rcv_queue);
+	iqueue_init(&lane->rcv_buf);
+}
+
+// 创建qsp对象
+QSP * qsp_create(IUINT32 conv, void *user)
+{
+	QSP *qsp = malloc_hook(sizeof(QSP));
+	if (qsp == NULL)
+	{
+		log_error("[qsp_create : %d] : error, malloc_hook function return NULL", __LINE__);
+		return NULL;
+	}
+
+	// init
+	qsp->conv = conv;
+	qsp->mtu = QSP_MTU_SIZE;
+	qsp->mss = QSP_MTU_SIZE - QSP_HEAD_SIZE;
+	qsp->mode = QSP_MODE_HALF;
+	qsp->ver = QSP_VERSION;
+	qsp->stream = 0;
+	qsp->nonblock = 0;
+
+	qsp->chk_count = 0;
+	qsp->chk_frg = 0;
+	qsp->chk_msn = 0;
+	qsp->chk_left = 0;
+	qsp->chk_need = 0;
+	qsp->chk_node = NULL;
+
+	qsp->nrcv_buf = 0;
+	qsp->nsnd_buf = 0;
+	qsp->nrcv_que = 0;
+	qsp->nsnd_que = 0;
+
+	qsp->snd_wnd = QSP_SND_WND;
+	qsp->rcv_wnd = QSP_RCV_WND;
+	qsp->rmt_wnd = QSP_RCV_WND;
+	qsp->wnd_auto = 0;
+	qsp->wnd_max = QSP_RCV_WND;
+	qsp->wnd_ts = 0;
+	qsp->wnd_drain = 0;
+	qsp->probe_ts = 0;
+	qsp->sched = QSP_SCHED_PRIO;
+	qsp->vtime = 0;
+	qsp->rx_srtt = 0;
+	qsp->rx_rttvar = 0;
+	qsp->rx_rto = QSP_TIME_OUT;
+	qsp->interval = 0;
+	qsp->flush_ts = 0;
+	qsp->rto_min = QSP_TIME_OUT;
+	qsp->pass = QSP_PASS_NUM;
+	qsp->copies = QSP_SINGLE_NUM;
+	qsp->cc = 0;
+	qsp->cwnd = QSP_CWND_INIT;
+	qsp->ssthresh = QSP_WND_MAX;
+	qsp->cwnd_acked = 0;
+	qsp->cc_ts = 0;
+	qsp->current = 0;
+	qsp->hs_state = QSP_HS_NONE;
+	qsp->hs_ts = 0;
+	qsp->hs_xmit = 0;
+	memset(qsp->cookie, 0, sizeof(qsp->cookie));
+	qsp->dead = 0;
+	qsp->dead_xmit = QSP_XMIT_MAX;
+	qsp->dead_time = 0;
+	qsp->keepalive = 0;
+	qsp->idle = 0;
+	qsp->rcv_ts = 0;
+	qsp->ka_ts = 0;
+	qsp->aead = NULL;
+	qsp->aead_role = 0;
+	qsp->aead_snd = 0;
+	qsp->aead_rcv = 0;
+	qsp->aead_win = 0;
+	qsp->zip = 0;
+	qsp->zip_min = QSP_ZIP_MIN;
+	qsp->pmtu_max = 0;
+	qsp->pmtu_lo = QSP_MTU_SIZE;
+	qsp->pmtu_hi = QSP_MTU_SIZE;
+	qsp->pmtu_probe = 0;
+	qsp->pmtu_xmit = 0;
+	qsp->pmtu_ts = 0;
+
+	memset(&qsp->stats, 0, sizeof(qsp->stats));
+	memset(&qsp->stats_sync, 0, sizeof(qsp->stats_sync));
+	qsp->hist = NULL;
+	qsp->capture = NULL;
+
+	memset(&qsp->mem, 0, sizeof(qsp->mem));
+	qsp->mem_soft = 0;
+	qsp->mem_hard = 0;
+
+	for (int i = 0; i < QSP_LANE_NUM; i++)
+		qsp_lane_init(&qsp->lane[i]);
+	iqueue_init(&qsp->snd_buf);
+
+	qsp->user = user;
+	qsp->buff = (char*)malloc_hook(QSP_BUF_SIZE);
+	qsp->bufsize = QSP_BUF_SIZE;
+
+	qsp->systime = NULL;
+	qsp->input = NULL;
+	qsp->output = NULL;
+	qsp->chunk = NULL;
+	qsp->dgram = NULL;
+	qsp->deadlink = NULL;
+
+	return qsp;
+}
+
+// 释放队列中的所有节点
+
+// 释放qsp对象
+int qsp_release(QSP * qsp)
+{
+	if (qsp == NULL)
+	{
+		log_error("[qsp_release : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	// 从进程统计中去掉该会话的队列深度
+	qsp_queues_release(qsp);
+	qsp_stats_sync(qsp);
+
+	if (qsp->buff != NULL)
+		free_hook(qsp->buff);
+
+	if (qsp->hist != NULL)
+		free_hook(qsp->hist);
+
+	if (qsp->capture != NULL)
+		icap_close(qsp->capture);
+
+	if (qsp->aead != NULL)
+		free_hook(qsp->aead);
+
+	free_hook(qsp);
+
+	return 0;
+}
+
+// 获取版本号
+int qsp_version(QSP * qsp)
+{
+	return QSP_VERSION;
+}
+
+// 字节流发送：追加到逻辑流的待发送队列，先填满队尾的片段，片段达到MSS时再发送（more：只放入队列）
+static int qsp_send_stream(QSP *qsp, IUINT16 sid, const char *buf, int len, int more)
+{
+	assert(qsp);
+	assert(buf);
+
+	QSPLANE *lane = &qsp->lane[sid];
+	QSPNODE *qnode;
+	int datalen = len;
+
+	// 超过内存硬限制，稍后重试
+	if (qsp_mem_check(qsp, (IUINT64)((len + qsp->mss - 1) / qsp->mss) * (sizeof(QSPNODE) + qsp->mss), 0))
+	{
+		log_warn("[qsp_send_stream : %d] : warning, memory limit is exceeded", __LINE__);
+		return QSP_EAGAIN;
+	}
+
+	// 填充队尾未满的片段
+	if (!iqueue_is_empty(&lane->snd_queue))
+	{
+		qnode = iqueue_entry(lane->snd_queue.prev, QSPNODE, node);
+		// 片段按分配时的MSS追加（MTU可能已经变化）
+		IUINT32 room = _imin_(qnode->size - (IUINT32)sizeof(QSPNODE), qsp->mss);
+		if (qnode->seg.sn == QSP_STREAM_SN && qnode->seg.len < room)
+		{
+			int size = (int)(room - qnode->seg.len);
+			if (size > len) size = len;
+			memcpy(qnode->seg.data + qnode->seg.len, buf, size);
+			qnode->seg.len += size;
+			buf += size;
+			len -= size;
+		}
+	}
+
+	// 剩余的数据按MSS切片（每个片段按MSS分配，便于后续追加）
+	while (len > 0)
+	{
+		int size = len > (int)qsp->mss ? (int)qsp->mss : len;
+
+		qnode = qsp_segment_new(qsp->mss);
+		if (qnode == NULL)
+		{
+			log_error("[qsp_send_stream : %d] : error, qsp_segment_new function return NULL", __LINE__);
+			return -3;
+		}
+
+		memcpy(qnode->seg.data, buf, size);
+
+		qnode->seg.conv = qsp->conv;
+		qnode->seg.frg = lane->snd_nxt++;				// 流序号
+		qnode->seg.ts = qsp_click(qsp);
+		qnode->seg.sn = QSP_STREAM_SN;					// 字节流报文片段
+		qnode->seg.cmd = QSP_CMD_PUSH;
+		qnode->seg.mode = qsp->mode;
+		qnode->seg.ver = qsp->ver;
+		qnode->seg.len = size;
+		qnode->seg.sid = sid;
+
+		iqueue_add_tail(&qnode->node, &lane->snd_queue);
+		qsp_mem_inc(qsp, QSP_MEM_SND_QUEUE, qnode);
+		lane->nsnd_que++;
+		qsp->nsnd_que++;
+
+		buf += size;
+		len -= size;
+	}
+
+	// 队尾片段已满才发送，未满的数据等待后续写入或qsp_flush
+	qnode = iqueue_entry(lane->snd_queue.prev, QSPNODE, node);
+	if (!more && !iqueue_is_empty(&lane->snd_queue) && qnode->seg.len >= qsp->mss)
+	{
+		if (qsp_send_flush(qsp))
+		{
+			if (qsp->dead)
+				return QSP_EDEAD;
+			log_error("[qsp_send_stream : %d] : error, qsp_send_flush error", __LINE__);
+			return -3;
+		}
+	}
+
+	return datalen;
+}
+
+// 发送不可靠数据报：不切片、不进入待发送队列，立即发送一次（不等待ACK，不重传）
+static int qsp_send_dgram(QSP *qsp, IUINT16 sid, const char *buf, int len)
+{
+	assert(qsp);
+	assert(buf);
+
+	QSPNODE *qnode;
+	int ret;
+
+	if (len > (int)qsp->mss)
+	{
+		log_error("[qsp_send_dgram : %d] : error, dgram allow max length is %d", __LINE__, qsp->mss);
+		return -2;
+	}
+
+	qnode = qsp_segment_new(len);
+	if (qnode == NULL)
+	{
+		log_error("[qsp_send_dgram : %d] : error, qsp_segment_new function return NULL", __LINE__);
+		return -3;
+	}
+
+	memcpy(qnode->seg.data, buf, len);
+
+	qnode->seg.conv = qsp->conv;
+	qnode->seg.frg = 0;
+	qnode->seg.ts = qsp_click(qsp);
+	qnode->seg.sn = 1;
+	qnode->seg.cmd = QSP_CMD_DGRAM;
+	qnode->seg.mode = qsp->mode;
+	qnode->seg.ver = qsp->ver;
+	qnode->seg.len = len;
+	qnode->seg.sid = sid;
+
+	ret = qsp_send_node(qsp, qnode);
+	qsp_segment_delete(qnode);
+
+	if (ret != len + (int)QSP_HEAD_SIZE)
+	{
+		log_error("[qsp_send_dgram : %d] : error, qsp_send_node return length error", __LINE__);
+		return -3;
+	}
+
+	return len;
+}
+
+// 释放压缩数据（qsp->buff不释放）
+static void qsp_zip_free(QSP *qsp, char *zbuf)
+{
+	if (zbuf != NULL && zbuf != (char*)qsp->buff)
+		free_hook(zbuf);
+}
+
+// 压缩报文：先压缩前QSP_ZIP_PROBE字节试探，再压缩整个报文，至少节省1/QSP_ZIP_GAIN才使用压缩数据；
+// 压缩数据（4字节原长 + LZ数据）放在qsp->buff（足够大时）或者新分配的*out中，返回压缩数据的长度，0为不压缩
+static int qsp_zip(QSP *qsp, const char *buf, int len, char **out)
+{
+	assert(qsp);
+	assert(buf);
+
+	IUINT64 start = iclock_us();
+	int cap = len - len / QSP_ZIP_GAIN;
+	int zlen = 0;
+	char *z;
+
+	*out = NULL;
+
+	z = cap <= (int)qsp->bufsize ? (char*)qsp->buff : (char*)malloc_hook(cap);
+	if (z == NULL)
+	{
+		log_error("[qsp_zip : %d] : error, malloc_hook function return NULL", __LINE__);
+		return 0;
+	}
+
+	if (len < 2 * QSP_ZIP_PROBE || ilz_compress(buf, QSP_ZIP_PROBE, z + 4, QSP_ZIP_PROBE - QSP_ZIP_PROBE / QSP_ZIP_GAIN) > 0)
+		zlen = ilz_compress(buf, len, z + 4, cap - 4);
+
+	qsp->stats.zip_us += iclock_us() - start;
+
+	if (zlen <= 0)
+	{
+		qsp->stats.zip_bypass++;
+		qsp_zip_free(qsp, z);
+		return 0;
+	}
+
+	qsp_encode32u(z, (IUINT32)len);
+	qsp->stats.zip_msg++;
+	qsp->stats.zip_raw += len;
+	qsp->stats.zip_packed += zlen + 4;
+
+	*out = z;
+	return zlen + 4;
+}
+
+// 发送数据 -> buf队列（切片写入到0号逻辑流的待发送队列中）
+int qsp_send(QSP *qsp, const void * buf, int len)
+{
+	return qsp_sendex(qsp, buf, len, NULL);
+}
+
+// 发送数据 -> 指定逻辑流的待发送队列（opt为NULL时使用0号逻辑流并立即发送）
+int qsp_sendex(QSP *qsp, const void * buf, int len, const QSPSENDOPT *opt)
+{
+	IUINT16 sid = opt ? opt->sid : 0;
+	IUINT16 flags = opt ? opt->flags : 0;
+
+	if (qsp == NULL || buf == NULL || len < 0 || sid >= QSP_LANE_NUM)
+	{
+		log_error("[qsp_sendex : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	qsp_tick(qsp);
+	if (qsp->dead)
+		return QSP_EDEAD;
+
+	// 不可靠数据报不进入待发送队列，不受分块发送与微双工模式的限制
+	if (flags & QSP_SEND_DGRAM)
+		return qsp_send_dgram(qsp, sid, (const char*)buf, len);
+
+	if (qsp->chk_count != 0)
+	{
+		log_error("[qsp_sendex : %d] : error, chunked send is in progress", __LINE__);
+		return -2;
+	}
+
+	// 微双工模式的ACK只有一个字节，不能区分逻辑流
+	if (qsp->mode == QSP_MODE_WEAK && sid != 0)
+	{
+		log_error("[qsp_sendex : %d] : error, QSP_MODE_WEAK only allow sid 0", __LINE__);
+		return -2;
+	}
+
+	if (qsp->stream)
+		return qsp_send_stream(qsp, sid, (const char*)buf, len, flags & QSP_SEND_MORE);
+
+	if (qsp->mode == QSP_MODE_WEAK && len > QSP_WEAK_MAX * qsp->mss)
+	{
+		log_error("[qsp_sendex : %d] : error, QSP_MODE_WEAK allow max length is %d", __LINE__, QSP_WEAK_MAX * qsp->mss);
+		return -2;
+	}
+
+	QSPLANE *lane = &qsp->lane[sid];
+	QSPNODE *qnode;
+	IUINT32 expire = 0;
+	IUINT8 zip = 0;
+	char *zbuf = NULL;
+	int count, i;
+	int datalen = len;
+
+	// 压缩报文（收益不足时原样发送），后面切片的是压缩数据
+	if (qsp->zip && len >= (int)qsp->zip_min)
+	{
+		int zlen = qsp_zip(qsp, (const char*)buf, len, &zbuf);
+		if (zlen > 0)
+		{
+			buf = zbuf;
+			len = zlen;
+			zip = QSP_FLAG_ZIP;
+		}
+	}
+
+	if (len <= (int)qsp->mss)
+		count = 1;
+	else
+		count = (len + qsp->mss - 1) / qsp->mss;
+
+	if (count == 0)
+		count = 1;
+
+	// 超过内存硬限制，稍后重试
+	if (qsp_mem_check(qsp, (IUINT64)count * sizeof(QSPNODE) + len, 0))
+	{
+		log_warn("[qsp_sendex : %d] : warning, memory limit is exceeded", __LINE__);
+		qsp_zip_free(qsp, zbuf);
+		return QSP_EAGAIN;
+	}
+
+	// 报文的期限（0为不限制）
+	if (opt != NULL && opt->ttl != 0)
+	{
+		expire = qsp_click(qsp) + opt->ttl;
+		if (expire == 0)
+			expire = 1;
+	}
+
+	// 对数据进行切片
+	for (i = 0; i < count; i++)
+	{
+		int size = len >(int)qsp->mss ? (int)qsp->mss : len;
+
+		qnode = qsp_segment_new(size);
+		if (qnode == NULL)
+		{
+			log_error("[qsp_sendex : %d] : error, qsp_segment_new function return NULL", __LINE__);
+			qsp_zip_free(qsp, zbuf);
+			return -3;
+		}
+
+		if (buf && len > 0) {
+			memcpy(qnode->seg.data, buf, size);
+		}
+
+		// 封装报文头部信息
+		qnode->seg.conv = qsp->conv;					// 报文标识
+		qnode->seg.frg = count - i - 1;					// 包号与包发送的顺序相反（最后一个包序号：0）
+		qnode->seg.ts = qsp_click(qsp);					// 时间戳，用来判断报文是否重复
+		qnode->seg.sn = count;							// 该组报文的总数
+		qnode->seg.cmd = QSP_CMD_PUSH;					// 报文的动作类型
+		qnode->seg.mode = qsp->mode;					// 通信模式
+		qnode->seg.flags = zip;							// 报文标志
+		qnode->seg.ver = qsp->ver;						// 协议版本
+		qnode->seg.len = size;							// 数据段的长度
+		qnode->seg.sid = sid;							// 逻辑流编号
+		qnode->seg.msn = lane->snd_msn;					// 报文序号
+		qnode->expire = expire;							// 报文的期限
+
+		iqueue_init(&qnode->node);
+		iqueue_add_tail(&qnode->node, &lane->snd_queue);	// 插入到snd_queue队尾中，待发送
+		qsp_mem_inc(qsp, QSP_MEM_SND_QUEUE, qnode);
+		lane->nsnd_que++;
+		qsp->nsnd_que++;
+
+		if (buf)
+			buf = (const char*)buf + size;
+
+		len -= size;
+	}
+
+	lane->snd_msn++;
+	qsp_zip_free(qsp, zbuf);
+
+	// 只放入队列，等待qsp_flush统一发送（多个逻辑流的报文同时发送）
+	if (flags & QSP_SEND_MORE)
+		return datalen;
+
+	if (qsp_send_flush(qsp))
+	{
+		if (qsp->dead)
+			return QSP_EDEAD;
+		log_error("[qsp_sendex : %d] : error, qsp_send_flush error", __LINE__);
+		return -3;
+	}
+
+	return datalen;
+}
+
+// 分块发送 -> 开始一个长度为len的报文（片段逐块写入，内存占用不超过发送窗口，使用0号逻辑流）
+// 微双工模式的ACK只比较片段号的低8位，报文长度与qsp_sendex一样不超过QSP_WEAK_MAX个片段
+int qsp_send_begin(QSP *qsp, IUINT32 len)
+{
+	if (qsp == NULL)
+	{
+		log_error("[qsp_send_begin : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	if (qsp->dead)
+		return QSP_EDEAD;
+
+	if (qsp->chk_count != 0 || qsp->stream)
+	{
+		log_error("[qsp_send_begin : %d] : error, chunked send is in progress or stream mode", __LINE__);
+		return -2;
+	}
+
+	if (qsp->mode == QSP_MODE_WEAK && len > (IUINT32)QSP_WEAK_MAX * qsp->mss)
+	{
+		log_error("[qsp_send_begin : %d] : error, QSP_MODE_WEAK allow max length is %d", __LINE__, QSP_WEAK_MAX * qsp->mss);
+		return -2;
+	}
+
+	qsp->chk_count = len == 0 ? 1 : (len + qsp->mss - 1) / qsp->mss;
+	qsp->chk_frg = qsp->chk_count - 1;
+	qsp->chk_msn = qsp->lane[0].snd_msn++;
+	qsp->chk_left = len;
+	qsp->chk_need = 0;
+	qsp->chk_node = NULL;
+
+	// 空报文只有一个长度为0的片段
+	if (len == 0)
+		return qsp_send_chunk(qsp, "", 0);
+
+	return 0;
+}
+
+// 分块发送 -> 写入报文的一块数据，片段写满后放入待发送队列，达到发送窗口时发送并等待ACK
+// 非阻塞模式不等待ACK：0号逻辑流的snd_queue达到发送窗口时不再写入新的片段，返回已经写入的字节数（可能小于len），
+// 一个字节也没有写入时返回QSP_EAGAIN；调用方在qsp_update之后从未写入的位置继续调用
+int qsp_send_chunk(QSP *qsp, const void *buf, int len)
+{
+	if (qsp == NULL || buf == NULL || len < 0)
+	{
+		log_error("[qsp_send_chunk : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	qsp_tick(qsp);
+	if (qsp->dead)
+		return QSP_EDEAD;
+
+	if (qsp->chk_count == 0 || (IUINT32)len > qsp->chk_left)
+	{
+		log_error("[qsp_send_chunk : %d] : error, chunked send is not started or too long", __LINE__);
+		return -2;
+	}
+
+	const char *ptr = (const char*)buf;
+	int datalen = len;
+
+	// 超过内存硬限制，稍后重试（达到发送窗口时会发送并释放片段，只需检查一个片段）
+	if (qsp_mem_check(qsp, sizeof(QSPNODE) + _imin_(len, qsp->mss), 0))
+	{
+		log_warn("[qsp_send_chunk : %d] : warning, memory limit is exceeded", __LINE__);
+		return QSP_EAGAIN;
+	}
+
+	do
+	{
+		QSPNODE *qnode = qsp->chk_node;
+		int size;
+
+		// 开始填充一个新的片段
+		if (qnode == NULL)
+		{
+			// 非阻塞模式：待发送的片段达到发送窗口，先发送一轮，仍然没有空间时由调用方稍后重试（空报文只有一个片段，不受限制）
+			if (qsp->nonblock && len > 0 && qsp->lane[0].nsnd_que >= qsp->snd_wnd)
+			{
+				if (qsp_send_flush(qsp))
+					return QSP_EDEAD;
+				if (qsp->lane[0].nsnd_que >= qsp->snd_wnd)
+					return datalen > len ? datalen - len : QSP_EAGAIN;
+			}
+
+			size = qsp->chk_left > qsp->mss ? (int)qsp->mss : (int)qsp->chk_left;
+
+			qnode = qsp_segment_new(size);
+			if (qnode == NULL)
+			{
+				log_error("[qsp_send_chunk : %d] : error, qsp_segment_new function return NULL", __LINE__);
+				return -3;
+			}
+
+			qnode->seg.conv = qsp->conv;
+			qnode->seg.frg = qsp->chk_frg;
+			qnode->seg.ts = qsp_click(qsp);
+			qnode->seg.sn = qsp->chk_count;
+			qnode->seg.msn = qsp->chk_msn;
+			qnode->seg.cmd = QSP_CMD_PUSH;
+			qnode->seg.mode = qsp->mode;
+			qnode->seg.ver = qsp->ver;
+			qnode->seg.len = 0;
+
+			qsp->chk_node = qnode;
+			qsp->chk_need = size;
+		}
+
+		size = len > (int)qsp->chk_need ? (int)qsp->chk_need : len;
+		memcpy(qnode->seg.data + qnode->seg.len, ptr, size);
+		qnode->seg.len += size;
+		qsp->chk_need -= size;
+		qsp->chk_left -= size;
+		ptr += size;
+		len -= size;
+
+		// 片段已写满，放入待发送队列
+		if (qsp->chk_need == 0)
+		{
+			iqueue_add_tail(&qnode->node, &qsp->lane[0].snd_queue);
+			qsp_mem_inc(qsp, QSP_MEM_SND_QUEUE, qnode);
+			qsp->lane[0].nsnd_que++;
+			qsp->nsnd_que++;
+			qsp->chk_node = NULL;
+			qsp->chk_frg--;
+
+			if (qsp->nsnd_que >= qsp->snd_wnd && qsp_send_flush(qsp))
+			{
+				if (qsp->dead)
+					return QSP_EDEAD;
+				log_error("[qsp_send_chunk : %d] : error, qsp_send_flush error", __LINE__);
 				return -3;
 			}
+		}
+	} while (len > 0);
+
+	return datalen;
+}
+
+// 分块发送 -> 结束报文，发送剩余的片段
+int qsp_send_end(QSP *qsp)
+{
+	if (qsp == NULL)
+	{
+		log_error("[qsp_send_end : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	qsp_tick(qsp);
+	if (qsp->dead)
+		return QSP_EDEAD;
+
+	if (qsp->chk_count == 0 || qsp->chk_left != 0)
+	{
+		log_error("[qsp_send_end : %d] : error, chunked send is not started or incomplete", __LINE__);
+		return -2;
+	}
+
+	qsp->chk_count = 0;
+
+	if (qsp_flush(qsp))
+	{
+		log_error("[qsp_send_end : %d] : error, qsp_send_flush error", __LINE__);
+		return -3;
+	}
+
+	return 0;
+}
+
+// 字节流接收：从逻辑流的rcv_queue中读取最多len字节，未读完的片段保留剩余数据
+static int qsp_recv_stream(QSP *qsp, QSPLANE *lane, char *buf, int len, int ispeek)
+{
+	assert(qsp);
+	assert(lane);
+	assert(buf);
+
+	struct IQUEUEHEAD *p;
+	int total = 0;
+
+	for (p = lane->rcv_queue.next; p != &lane->rcv_queue && total < len; )
+	{
+		QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+		int size = qnode->seg.len;
+		p = p->next;
+
+		if (size > len - total)
+			size = len - total;
+
+		memcpy(buf + total, qnode->seg.data, size);
+		total += size;
+
+		// 偷窥数据不删除原来节点
+		if (ispeek)
+			continue;
+
+		if (size == qnode->seg.len)
+		{
+			iqueue_del(&qnode->node);
+			qsp_mem_dec(qsp, QSP_MEM_RCV_QUEUE, qnode);
+			qsp_segment_delete(qnode);
+			lane->nrcv_que--;
+			qsp->nrcv_que--;
+			qsp->wnd_drain++;
+		}
+		else
+		{
+			memmove(qnode->seg.data, qnode->seg.data + size, qnode->seg.len - size);
+			qnode->seg.len -= size;
+		}
+	}
+
+	return total;
+}
+
+// 接收一个压缩报文：拼接片段（只有一个片段时直接使用片段数据）后解压到buf（raw为原长），
+// 返回原长；数据错误时丢弃该报文返回-2（偷窥数据时也丢弃）
+static int qsp_recv_zip(QSP *qsp, QSPLANE *lane, char *buf, int raw, int ispeek)
+{
+	assert(qsp);
+	assert(lane);
+
+	struct IQUEUEHEAD *p;
+	QSPNODE *qnode = iqueue_entry(lane->rcv_queue.next, QSPNODE, node);
+	IUINT64 start = iclock_us();
+	char *z = NULL, *zbuf = NULL;
+	int zlen = 0, ret = -2;
+
+	for (p = lane->rcv_queue.next; p != &lane->rcv_queue; p = p->next)
+	{
+		QSPNODE *q = iqueue_entry(p, QSPNODE, node);
+		zlen += q->seg.len;
+		if (q->seg.frg == 0)
+			break;
+	}
+
+	if (buf != NULL && zlen > 4)
+	{
+		if (qnode->seg.frg == 0)
+		{
+			z = qnode->seg.data;
+		}
+		else if ((zbuf = (char*)malloc_hook(zlen)) != NULL)
+		{
+			char *ptr = zbuf;
+			for (p = lane->rcv_queue.next; p != &lane->rcv_queue; p = p->next)
+			{
+				QSPNODE *q = iqueue_entry(p, QSPNODE, node);
+				memcpy(ptr, q->seg.data, q->seg.len);
+				ptr += q->seg.len;
+				if (q->seg.frg == 0)
+					break;
+			}
+			z = zbuf;
+		}
+		else
+		{
+			log_error("[qsp_recv_zip : %d] : error, malloc_hook function return NULL", __LINE__);
+			return -3;
+		}
+
+		if (ilz_decompress(z + 4, zlen - 4, buf, raw) == raw)
+			ret = raw;
+
+		if (zbuf != NULL)
+			free_hook(zbuf);
+	}
+
+	qsp->stats.unzip_us += iclock_us() - start;
+
+	if (ret < 0)
+	{
+		log_warn("[qsp_recv_zip : %d] : warning, compressed message is broken", __LINE__);
+		qsp->stats.unzip_error++;
+	}
+	else
+	{
+		qsp->stats.unzip_msg++;
+	}
+
+	// 偷窥数据不删除原来节点（数据错误的报文总是删除）
+	if (ispeek && ret >= 0)
+		return ret;
+
+	while (!iqueue_is_empty(&lane->rcv_queue))
+	{
+		int fragment;
+		qnode = iqueue_entry(lane->rcv_queue.next, QSPNODE, node);
+		fragment = qnode->seg.frg;
+
+		iqueue_del(&qnode->node);
+		qsp_mem_dec(qsp, QSP_MEM_RCV_QUEUE, qnode);
+		qsp_segment_delete(qnode);
+		lane->nrcv_que--;
+		qsp->nrcv_que--;
+		qsp->wnd_drain++;
+
+		if (fragment == 0)
+			break;
+	}
+
+	return ret;
+}
+
+// 接收数据 <- recv_queue队列（从优先级最高的逻辑流的已接收队列中提取数据）
+int qsp_recv(QSP *qsp, void * buf, int len)
+{
+	return qsp_recvex(qsp, buf, len, NULL);
+}
+
+// 接收数据 <- 逻辑流的recv_queue队列（sid为NULL或QSP_SID_ANY时接收任意逻辑流，返回时保存实际的逻辑流编号）
+int qsp_recvex(QSP *qsp, void * buf, int len, IUINT16 *sid)
+{
+	assert(qsp);
+	assert(buf);
+
+	if (sid != NULL && *sid != QSP_SID_ANY && *sid >= QSP_LANE_NUM)
+	{
+		log_error("[qsp_recvex : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+restart:
+	qsp_tick(qsp);
+	if (qsp_check_link(qsp))
+		return QSP_EDEAD;
+	if (qsp_recv_flush(qsp) < 0)
+	{
+		log_error("[qsp_recv : %d] : error, qsp_recv_flush return < 0", __LINE__);
+		return -1;
+	}
+	qsp_stats_sync(qsp);
+	qsp_wnd_update(qsp);
+
+	struct IQUEUEHEAD *p;
+	int ispeek = (len < 0) ? 1 : 0;
+	int peeksize;
+	QSPNODE *qnode;
+	QSPLANE *lane;
+
+	// 指定的逻辑流，或者有数据的逻辑流中优先级最高的
+	if (sid != NULL && *sid != QSP_SID_ANY)
+		lane = qsp_lane_ready(&qsp->lane[*sid]) ? &qsp->lane[*sid] : NULL;
+	else
+		lane = qsp_lane_select(qsp);
+
+	if (lane == NULL)
+	{
+		// 非阻塞模式没有完整的报文时立即返回
+		if (qsp->nonblock)
+			return QSP_EAGAIN;
+		log_error("[qsp_recv : %d] : error, rcv_queue is empty", __LINE__);
+		goto restart;
+	}
+
+	if (sid != NULL)
+		*sid = (IUINT16)(lane - qsp->lane);
+
+	if (len < 0) len = -len;
+
+	// 字节流模式，返回不超过len的连续数据
+	if (qsp->stream)
+	{
+		len = qsp_recv_stream(qsp, lane, (char*)buf, len, ispeek);
+		if (len > 0 && ispeek == 0)
+			ITRACE(ITRACE_DELIVER, qsp->conv, (IUINT16)(lane - qsp->lane), 0, 0, len);
+		return len;
+	}
+
+	peeksize = qsp_lane_peeksize(qsp, lane);
+
+	// 压缩报文的数据错误：丢弃该报文，不阻塞后面的报文
+	if (peeksize < 0)
+	{
+		qsp_recv_zip(qsp, lane, NULL, 0, 0);
+		return -2;
+	}
+
+	if (peeksize > len)
+		return -3;
+
+	qnode = iqueue_entry(lane->rcv_queue.next, QSPNODE, node);
+	if (qnode->seg.flags & QSP_FLAG_ZIP)
+	{
+		len = qsp_recv_zip(qsp, lane, (char*)buf, peeksize, ispeek);
+		if (len > 0 && ispeek == 0)
+			ITRACE(ITRACE_DELIVER, qsp->conv, (IUINT16)(lane - qsp->lane), 0, 0, len);
+		return len;
+	}
+
+	// 片段拼接
+	for (len = 0, p = lane->rcv_queue.next; p != &lane->rcv_queue; )
+	{
+		int fragment;
+		qnode = iqueue_entry(p, QSPNODE, node);
+		p = p->next;
 
-			if (cmd == QSP_CMD_ACK)
-			{
-				qsp_parse_ack(qsp, frg);
-				break;
-			}
-			else if (cmd == QSP_CMD_PUSH)
-			{
-				//һ½ڵ
-				qnode = qsp_segment_new(len);
+		if (buf) {
+			memcpy(buf, qnode->seg.data, qnode->seg.len);
+			buf = (char*)buf + qnode->seg.len;
+		}
 
-				qnode->seg.conv = conv;
-				qnode->seg.frg = frg;
-				qnode->seg.ts = ts;
-				qnode->seg.sn = sn;
-				qnode->seg.cmd = cmd;
-				qnode->seg.mode = mode;
-				qnode->seg.len = len;
+		len += qnode->seg.len;
+		fragment = qnode->seg.frg;
 
-				if (len > 0)
-					memcpy(qnode->seg.data, buf, len);
+		// 偷窥数据不删除原来节点
+		if (ispeek == 0) {
+			iqueue_del(&qnode->node);
+			qsp_mem_dec(qsp, QSP_MEM_RCV_QUEUE, qnode);
+			qsp_segment_delete(qnode);
+			lane->nrcv_que--;
+			qsp->nrcv_que--; // 需要接收的节点数减少
+			qsp->wnd_drain++;
+		}
 
-				// ݣظ
-				qsp_parse_data(qsp, qnode);
+		if (fragment == 0)
+			break;
+	}
 
-				// ж϶ز(˫ģʽ)
-				if (qnode->seg.mode == QSP_MODE_HALF)
-				{
-					// rcv_bufнڵ㣬˵жҪز
-					int count = 0;
-					QSPNODE *q;
-					for (q = qsp->rcv_buf.next; q != &qsp->rcv_buf; q = q->node.next)
-						count++;
-					if (count > QSP_PASS_NUM)
-						qsp_request_again(qsp, qsp->rcv_nxt);
-				}
+	assert(len == peeksize);
 
-				// ӦACK
-				if (qsp_respond_ack(qsp, qnode) < 0)
-					return -2;
+	if (ispeek == 0)
+		ITRACE(ITRACE_DELIVER, qsp->conv, (IUINT16)(lane - qsp->lane), 0, 0, len);
+	return len;
+}
 
-				// һıƬΣѭ
-				if (qsp->rcv_nxt == (IUINT32)-1)
-				{
-					qsp->rcv_nxt = 0;
-					break;
-				}
-			}
-			else if (cmd == QSP_CMD_AGAIN)
-			{
-				QSPNODE *qnode = NULL;
-				for (qnode = qsp->snd_buf.next; qnode != &qsp->snd_buf; )
-				{
-					if (qnode->seg.frg == frg)
-						break;
-				}
-				if (qnode != NULL)
-					qsp_send_node(qsp, qnode);
+// 设置接收数据回调函数(非阻塞)
+int qsp_setinput(QSP * qsp, int(*input)(char *buf, int len, QSP *qsp, void *user))
+{
+	if (qsp == NULL || input == NULL)
+		return -1;
 
-				break;
-			}
-			else
-			{
-				write_log("[qsp_recv_flush : %d] : error, cmd is unknow", __LINE__);
-				return -3;
-			}
-		}
+	qsp->input = input;
+
+	return 0;
+}
+
+// 设置发送数据回调函数(非阻塞)
+int qsp_setoutput(QSP * qsp, int(*output)(const char *buf, int len, QSP *qsp, void *user))
+{
+	if (qsp == NULL || output == NULL)
+		return -1;
+
+	qsp->output = output;
+
+	return 0;
+}
+
+// 设置时钟回调函数，获取当前系统时间（单位：毫秒）
+int qsp_setsystime(QSP * qsp, IUINT32(*systime)(void))
+{
+	assert(qsp);
+	assert(systime);
+
+	qsp->systime = systime;
+
+	return 0;
+}
+
+// 设置通信模式
+int qsp_setmode(QSP * qsp, IUINT32 mode)
+{
+	assert(qsp);
+
+	if (mode == QSP_MODE_WEAK && qsp->aead != NULL)
+	{
+		log_error("[qsp_setmode : %d] : error, crypto does not support weak mode", __LINE__);
+		return -1;
+	}
+
+	qsp->mode = mode;
+
+	return 0;
+}
+
+// 设置发送窗口与接收窗口大小（报文片段数，<= 0 保持不变），开启自动调整时接收窗口为上限
+int qsp_wndsize(QSP * qsp, int sndwnd, int rcvwnd)
+{
+	assert(qsp);
+
+	if (sndwnd > 0)
+		qsp->snd_wnd = _imin_(sndwnd, QSP_WND_MAX);
+
+	if (rcvwnd > 0)
+	{
+		qsp->rcv_wnd = _imin_(rcvwnd, QSP_WND_MAX);
+		qsp->wnd_max = qsp->rcv_wnd;
+	}
+
+	return 0;
+}
+
+// 设置重传与发送参数（小于0的参数不修改）：interval为qsp_update两轮发送的最小间隔（毫秒，0为每次调用都发送），
+// rto_min为重传超时的下限（毫秒），resend为错过多少个报文片段请求重传（0为不请求），cc为拥塞控制（1开启 / 0关闭）
+int qsp_nodelay(QSP * qsp, int interval, int rto_min, int resend, int cc)
+{
+	assert(qsp);
+
+	if (rto_min == 0 || rto_min > QSP_RTO_MAX)
+	{
+		log_error("[qsp_nodelay : %d] : error, rto_min must be in [1, %d]", __LINE__, QSP_RTO_MAX);
+		return -1;
+	}
+
+	if (interval >= 0)
+		qsp->interval = (IUINT32)interval;
+
+	if (rto_min > 0)
+	{
+		qsp->rto_min = (IUINT32)rto_min;
+		if (qsp->rx_srtt != 0)
+			qsp->rx_rto = _ibound_(qsp->rto_min, qsp->rx_srtt + _imax_(1, 4 * qsp->rx_rttvar), QSP_RTO_MAX);
 		else
+			qsp->rx_rto = _imax_(qsp->rto_min, QSP_TIME_OUT);	// 还没有RTT采样，不低于默认值
+	}
+
+	if (resend >= 0)
+		qsp->pass = (IUINT32)resend;
+
+	// 开启拥塞控制时从慢启动开始
+	if (cc >= 0 && (cc ? 1u : 0u) != qsp->cc)
+	{
+		qsp->cc = cc ? 1 : 0;
+		qsp->cwnd = QSP_CWND_INIT;
+		qsp->ssthresh = QSP_WND_MAX;
+		qsp->cwnd_acked = 0;
+	}
+
+	return 0;
+}
+
+// 设置单工模式下每个报文片段的发送次数（1 ~ QSP_COPIES_MAX，冗余发送抵抗丢包）
+int qsp_setredundancy(QSP * qsp, int copies)
+{
+	assert(qsp);
+
+	if (copies < 1 || copies > QSP_COPIES_MAX)
+	{
+		log_error("[qsp_setredundancy : %d] : error, copies must be in [1, %d]", __LINE__, QSP_COPIES_MAX);
+		return -1;
+	}
+
+	qsp->copies = (IUINT32)copies;
+
+	return 0;
+}
+
+// 预设参数：发送间隔 / 重传超时下限 / 请求重传的阈值 / 拥塞控制 / 发送窗口 / 接收窗口 / 单工模式的发送次数
+static const struct
+{
+	const char *name;
+	int interval, rto_min, resend, cc;
+	int sndwnd, rcvwnd, copies;
+} qsp_profiles[QSP_PROFILE_NUM] = {
+	{ "default", 0, QSP_TIME_OUT, QSP_PASS_NUM, 0, QSP_SND_WND, QSP_RCV_WND, QSP_SINGLE_NUM },
+	{ "lowlat", 0, 30, 1, 0, QSP_SND_WND, QSP_RCV_WND, 3 },
+	{ "balanced", 0, 100, 2, 0, 128, 512, 2 },
+	{ "bulk", 10, 200, 3, 0, 1024, 2048, 2 },
+};
+
+// 使用预设参数（QSP_PROFILE_DEFAULT等），之后可以再用qsp_nodelay等函数单独调整
+// （预设都不开启拥塞控制：随机丢包时吞吐量下降很多，与其他流量共用瓶颈链路时再开启）
+int qsp_setprofile(QSP * qsp, int profile)
+{
+	assert(qsp);
+
+	if (profile < 0 || profile >= QSP_PROFILE_NUM)
+	{
+		log_error("[qsp_setprofile : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	qsp_nodelay(qsp, qsp_profiles[profile].interval, qsp_profiles[profile].rto_min, qsp_profiles[profile].resend, qsp_profiles[profile].cc);
+	qsp_wndsize(qsp, qsp_profiles[profile].sndwnd, qsp_profiles[profile].rcvwnd);
+	qsp_setredundancy(qsp, qsp_profiles[profile].copies);
+
+	return 0;
+}
+
+// 预设参数的名称
+const char* qsp_profile_name(int profile)
+{
+	if (profile < 0 || profile >= QSP_PROFILE_NUM)
+		return "unknown";
+
+	return qsp_profiles[profile].name;
+}
+
+// 设置是否根据读取速度自动调整接收窗口（不超过qsp_wndsize设置的接收窗口）
+int qsp_setautownd(QSP * qsp, int enable)
+{
+	assert(qsp);
+
+	qsp->wnd_auto = enable ? 1 : 0;
+	qsp->wnd_ts = qsp_tick(qsp);
+	qsp->wnd_drain = 0;
+
+	if (!qsp->wnd_auto)
+		qsp->rcv_wnd = qsp->wnd_max;
+
+	return 0;
+}
+
+// 设置内存软限制与硬限制（字节，0为不限制），qsp为NULL时设置进程内所有会话的限制
+// 超过软限制时丢弃最早的不可靠（单工模式）数据，超过硬限制时qsp_send返回QSP_EAGAIN，接收的报文被丢弃
+int qsp_setmemlimit(QSP * qsp, IUINT64 soft, IUINT64 hard)
+{
+	if (qsp == NULL)
+	{
+		qsp_mem_soft = soft;
+		qsp_mem_hard = hard;
+		return 0;
+	}
+
+	qsp->mem_soft = soft;
+	qsp->mem_hard = hard;
+
+	return 0;
+}
+
+// 查询内存占用，qsp为NULL时查询进程内所有会话的总和
+int qsp_memusage(const QSP * qsp, QSPMEM *mem)
+{
+	if (mem == NULL)
+	{
+		log_error("[qsp_memusage : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	if (qsp != NULL)
+	{
+		*mem = qsp->mem;
+		return 0;
+	}
+
+	for (int i = 0; i < QSP_MEM_NUM; i++)
+		mem->bytes[i] = iatomic_load64(&qsp_mem_global.bytes[i]);
+	mem->total = iatomic_load64(&qsp_mem_global.total);
+	mem->dropped = iatomic_load64(&qsp_mem_global.dropped);
+
+	return 0;
+}
+
+// 获取会话统计（qsp为NULL时获取进程内所有会话的统计之和，可以在其他线程收发数据时读取）
+int qsp_stats(const QSP * qsp, QSPSTATS *stats)
+{
+	if (stats == NULL)
+	{
+		log_error("[qsp_stats : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	if (qsp != NULL)
+	{
+		*stats = qsp->stats;
+		stats->snd_que = qsp->nsnd_que;
+		stats->snd_buf = qsp->nsnd_buf;
+		stats->rcv_buf = qsp->nrcv_buf;
+		stats->rcv_que = qsp->nrcv_que;
+		stats->srtt = qsp->rx_srtt;
+		stats->rttvar = qsp->rx_rttvar;
+		stats->rto = qsp->rx_rto;
+		return 0;
+	}
+
+	{
+		IUINT64 *dst = (IUINT64*)stats;
+		IUINT64 *src = (IUINT64*)&qsp_stats_global;
+		int i, n = (int)(IOFFSETOF(QSPSTATS, srtt) / sizeof(IUINT64));
+
+		memset(stats, 0, sizeof(*stats));
+		for (i = 0; i < n; i++)
+			dst[i] = iatomic_load64(&src[i]);
+	}
+
+	return 0;
+}
+
+// 开启 / 关闭延迟直方图统计（开启时清空已有的记录）
+int qsp_sethist(QSP * qsp, int enable)
+{
+	assert(qsp);
+
+	if (!enable)
+	{
+		if (qsp->hist != NULL)
+			free_hook(qsp->hist);
+		qsp->hist = NULL;
+		return 0;
+	}
+
+	if (qsp->hist == NULL)
+	{
+		qsp->hist = (IHISTOGRAM*)malloc_hook(sizeof(IHISTOGRAM) * QSP_HIST_NUM * QSP_SIZE_CLASS_NUM);
+		if (qsp->hist == NULL)
 		{
+			log_error("[qsp_sethist : %d] : error, malloc_hook function return NULL", __LINE__);
 			return -1;
 		}
 	}
 
+	for (int i = 0; i < QSP_HIST_NUM * QSP_SIZE_CLASS_NUM; i++)
+		ihist_init(&qsp->hist[i]);
+
+	return 0;
+}
+
+// 获取延迟直方图（metric：QSP_HIST_ACK_RTT等 / sclass：报文大小分类），没有开启统计返回NULL
+const IHISTOGRAM* qsp_hist(const QSP * qsp, int metric, int sclass)
+{
+	assert(qsp);
+
+	if (metric < 0 || metric >= QSP_HIST_NUM || sclass < 0 || sclass >= QSP_SIZE_CLASS_NUM)
+	{
+		log_error("[qsp_hist : %d] : error, argument error", __LINE__);
+		return NULL;
+	}
+
+	if (qsp->hist == NULL)
+		return NULL;
+
+	return &qsp->hist[metric * QSP_SIZE_CLASS_NUM + sclass];
+}
+
+// 开始 / 停止抓包（path为NULL停止），收发的数据包写入pcap文件
+int qsp_setcapture(QSP * qsp, const char *path)
+{
+	assert(qsp);
+
+	if (qsp->capture != NULL)
+	{
+		icap_close(qsp->capture);
+		qsp->capture = NULL;
+	}
+
+	if (path == NULL)
+		return 0;
+
+	qsp->capture = icap_create(path);
+	if (qsp->capture == NULL)
+	{
+		log_error("[qsp_setcapture : %d] : error, icap_create return NULL", __LINE__);
+		return -1;
+	}
+
+	return 0;
+}
+
+// 设置是否握手（客户端，只用于半双工模式）：收到服务端的cookie并带回之后才发送数据
+int qsp_sethandshake(QSP * qsp, int enable)
+{
+	assert(qsp);
+
+	if (enable && qsp->mode != QSP_MODE_HALF)
+	{
+		log_error("[qsp_sethandshake : %d] : error, handshake needs half mode", __LINE__);
+		return -1;
+	}
+
+	qsp->hs_state = enable ? QSP_HS_WAIT : QSP_HS_NONE;
+	qsp->hs_ts = 0;
+	qsp->hs_xmit = 0;
+	memset(qsp->cookie, 0, sizeof(qsp->cookie));
+
+	return 0;
+}
+
+// 设置对端失效的条件：片段超时重传次数上限（默认QSP_XMIT_MAX），有待发送的数据时对端无响应的期限（毫秒），0为不限制
+int qsp_setretry(QSP * qsp, IUINT32 xmit, IUINT32 timeout)
+{
+	assert(qsp);
+
+	qsp->dead_xmit = xmit;
+	qsp->dead_time = timeout;
+
+	return 0;
+}
+
+// 设置保活探测间隔（对端安静超过interval毫秒发送WASK，只用于半双工模式）与空闲期限（超过idle毫秒没有收到对端的数据包认为会话失效），0为不启用
+int qsp_setkeepalive(QSP * qsp, IUINT32 interval, IUINT32 idle)
+{
+	assert(qsp);
+
+	if (interval != 0 && qsp->mode != QSP_MODE_HALF)
+	{
+		log_error("[qsp_setkeepalive : %d] : error, keepalive needs half mode", __LINE__);
+		return -1;
+	}
+
+	if (interval != 0 && idle != 0 && idle <= interval)
+	{
+		log_error("[qsp_setkeepalive : %d] : error, idle must be longer than interval", __LINE__);
+		return -2;
+	}
+
+	qsp->keepalive = interval;
+	qsp->idle = idle;
+
 	return 0;
 }
 
+// 设置会话失效的回调函数（reason：QSP_DEAD_RETRY等），失效时收发队列已经释放，之后的调用返回QSP_EDEAD
+int qsp_setdeadlink(QSP * qsp, void(*deadlink)(QSP *qsp, int reason, void *user))
+{
+	assert(qsp);
 
-//--------------------------------------------------
-//	USER INTERFACE
-//--------------------------------------------------
+	qsp->deadlink = deadlink;
 
-// ӡнڵϢ
-void qsp_print(struct IQUEUEHEAD *head)
+	return 0;
+}
+
+// 设置加密（IAEAD_CHACHA20_POLY1305 / IAEAD_AES128_GCM，IAEAD_NONE为关闭），两端使用相同的密钥，initiator一端为1一端为0；
+// 只能在发送数据前设置，不支持微双工模式，MSS减少QSP_CRYPTO_OVERHEAD字节
+int qsp_setcrypto(QSP * qsp, int alg, const void *key, int keylen, int initiator)
 {
-	assert(head);
+	assert(qsp);
 
-	QSPNODE *qnode = head->next;
+	IAEAD *aead = NULL;
+	int ret;
 
-	for (qnode = head->next; qnode != head; qnode = qnode->node.next)
+	if (qsp->nsnd_que != 0 || qsp->nsnd_buf != 0 || qsp->chk_count != 0)
 	{
-		printf("--------------------------------------\n");
-		printf("conv : 0x%X\n", qnode->seg.conv);
-		printf("frg : %lu\n", qnode->seg.frg);
-		printf("ts : %lu\n", qnode->seg.ts);
-		printf("sn : %lu\n", qnode->seg.sn);
-		switch (qnode->seg.cmd)
+		log_error("[qsp_setcrypto : %d] : error, crypto must be set before sending", __LINE__);
+		return -1;
+	}
+
+	if (alg != IAEAD_NONE)
+	{
+		if (qsp->mode == QSP_MODE_WEAK)
 		{
-		case QSP_CMD_PUSH:
-			printf("cmd : %s\n", "QSP_CMD_PUSH");
-			break;
-		case QSP_CMD_ACK:
-			printf("cmd : %s\n", "QSP_CMD_ACK");
-			break;
-		default:
-			printf("cmd : %s\n", "unknow command");
-			break;
+			log_error("[qsp_setcrypto : %d] : error, crypto does not support weak mode", __LINE__);
+			return -1;
 		}
-		switch (qnode->seg.mode)
+
+		aead = (IAEAD*)malloc_hook(sizeof(IAEAD));
+		if (aead == NULL)
 		{
-		case QSP_MODE_HALF:
-			printf("mode : %s\n", "QSP_MODE_HALF");
-			break;
-		case QSP_MODE_WEAK:
-			printf("mode : %s\n", "QSP_MODE_WEAK");
-			break;
-		case QSP_MODE_SINGLE:
-			printf("mode : %s\n", "QSP_MODE_SINGLE");
-			break;
-		default:
-			printf("mode : %s\n", "unknow mode");
-			break;
+			log_error("[qsp_setcrypto : %d] : error, malloc_hook function return NULL", __LINE__);
+			return -1;
+		}
+
+		ret = iaead_init(aead, alg, key, keylen, 1);
+		if (ret < 0)
+		{
+			log_error("[qsp_setcrypto : %d] : error, iaead_init return %d", __LINE__, ret);
+			free_hook(aead);
+			return ret;
 		}
-		printf("ver : %lu\n", qnode->seg.ver);
-		printf("len : %lu\n", qnode->seg.len);
-		printf("--------------------------------------\n");
-		printf("############     data     ############\n");
-		printf("--------------------------------------\n");
 	}
+
+	if (qsp->aead != NULL)
+		free_hook(qsp->aead);
+
+	qsp->aead = aead;
+	qsp->aead_role = initiator ? 1 : 0;
+	qsp->aead_snd = 0;
+	qsp->aead_rcv = 0;
+	qsp->aead_win = 0;
+	qsp_mtu_apply(qsp, qsp->mtu);
+
+	return 0;
 }
 
-// qsp
-QSP * qsp_create(IUINT32 conv, void *user)
+// 设置报文压缩（enable：1为压缩发送的报文，0为关闭），minsize为尝试压缩的最小报文长度（<= 0为QSP_ZIP_MIN）；
+// 只压缩报文模式的报文（字节流、数据报与分块发送不压缩），接收端总是能解压，不需要设置
+int qsp_setcompress(QSP * qsp, int enable, int minsize)
 {
-	QSP *qsp = malloc_hook(sizeof(QSP));
-	if (qsp == NULL)
-	{
-		write_log("[qsp_create : %d] : error, malloc_hook function return NULL", __LINE__);
-		return NULL;
-	}
+	assert(qsp);
 
-	// init
-	qsp->conv = conv;
-	qsp->mtu = QSP_MTU_SIZE;
-	qsp->mss = QSP_MTU_SIZE - QSP_HEAD_SIZE;
-	qsp->mode = QSP_MODE_HALF;
-	qsp->ver = QSP_VERSION;
+	qsp->zip = enable ? 1 : 0;
+	qsp->zip_min = minsize > 0 ? (IUINT32)minsize : QSP_ZIP_MIN;
 
-	qsp->snd_nxt = 0;
-	qsp->rcv_nxt = 0;
+	return 0;
+}
 
-	qsp->nrcv_buf = 0;
-	qsp->nsnd_buf = 0;
-	qsp->nrcv_que = 0;
-	qsp->nsnd_que = 0;
+// 设置MTU（提交给下层协议的数据包大小，QSP_MTU_MIN ~ QSP_MTU_MAX），缓冲区按需扩大；
+// 开启了路径MTU探测时从该值重新开始搜索，不能在分块发送的过程中设置
+int qsp_setmtu(QSP * qsp, int mtu)
+{
+	assert(qsp);
 
-	iqueue_init(&qsp->snd_queue);
-	iqueue_init(&qsp->rcv_queue);
-	iqueue_init(&qsp->snd_buf);
-	iqueue_init(&qsp->rcv_buf);
+	if (mtu < QSP_MTU_MIN || mtu > QSP_MTU_MAX)
+	{
+		log_error("[qsp_setmtu : %d] : error, mtu must be in [%d, %d]", __LINE__, QSP_MTU_MIN, QSP_MTU_MAX);
+		return -1;
+	}
 
-	qsp->user = user;
-	qsp->buff = (char*)malloc_hook(QSP_BUF_SIZE);
-	memset(&qsp->last, 0, sizeof(qsp->last));
+	if (qsp->chk_count != 0)
+	{
+		log_error("[qsp_setmtu : %d] : error, chunked send is in progress", __LINE__);
+		return -2;
+	}
 
-	qsp->systime = NULL;
-	qsp->input = NULL;
-	qsp->output = NULL;
+	if (qsp_buff_reserve(qsp, (IUINT32)mtu) < 0)
+		return -3;
 
-	return qsp;
+	qsp_mtu_apply(qsp, (IUINT32)mtu);
+
+	qsp->pmtu_lo = (IUINT32)mtu;
+	qsp->pmtu_hi = _imax_(qsp->pmtu_max, (IUINT32)mtu);
+	qsp->pmtu_probe = 0;
+
+	return 0;
 }
 
-// ͷqsp
-int qsp_release(QSP * qsp)
+// 开启路径MTU探测（maxmtu为探测的上限，0为关闭），从当前MTU向上搜索，确认后MSS随之增大；
+// 接收端的缓冲区要能容纳对端的探测包，两端应设置相同的上限；UDP套接字要设置不分片（Linux：IP_MTU_DISCOVER = IP_PMTUDISC_DO），
+// 否则超过路径MTU的探测包会被分片而探测成功；只用于半双工模式
+int qsp_setpmtud(QSP * qsp, int maxmtu)
 {
-	if (qsp == NULL)
+	assert(qsp);
+
+	if (maxmtu != 0 && (maxmtu < (int)qsp->mtu || maxmtu > QSP_MTU_MAX))
 	{
-		write_log("[qsp_release : %d] : error, argument error", __LINE__);
+		log_error("[qsp_setpmtud : %d] : error, maxmtu must be in [%u, %d]", __LINE__, qsp->mtu, QSP_MTU_MAX);
 		return -1;
 	}
 
-	// TODO release all child objects
-	if (qsp->buff != NULL)
-		free_hook(qsp->buff);
+	if (maxmtu != 0 && qsp_buff_reserve(qsp, (IUINT32)maxmtu) < 0)
+		return -3;
 
-	free_hook(qsp);
+	qsp->pmtu_max = (IUINT32)maxmtu;
+	qsp->pmtu_lo = qsp->mtu;
+	qsp->pmtu_hi = maxmtu != 0 ? (IUINT32)maxmtu : qsp->mtu;
+	qsp->pmtu_probe = 0;
+	qsp->pmtu_xmit = 0;
+	qsp->pmtu_ts = qsp_click(qsp);
 
 	return 0;
 }
 
-// ȡ汾
-int qsp_version(QSP * qsp)
+// 会话是否失效，返回失效原因（QSP_DEAD_RETRY等），0为正常
+int qsp_isdead(const QSP * qsp)
 {
-	return QSP_VERSION;
+	assert(qsp);
+
+	return (int)qsp->dead;
 }
 
-//  -> bufУƬд뵽ͶУ
-int qsp_send(QSP *qsp, const void * buf, int len)
+// 服务端准入检查（无状态）：对没有会话的数据包调用，cookie有效时返回QSP_ADMIT_OK（conv为会话编号），
+// 需要回复时返回QSP_ADMIT_REPLY（reply至少QSP_HEAD_SIZE + ICOOKIE_SIZE字节，回复不长于收到的数据包），
+// 其他返回QSP_ADMIT_DROP；只做一次哈希计算，不分配内存
+int qsp_admit(ICOOKIE *ck, const char *buf, int len, const void *addr, int addrlen, IUINT32 current,
+	IUINT32 *conv, char *reply, int *replylen)
 {
-	if (qsp == NULL || buf == NULL || len < 0)
+	QSPNODE qnode;
+	QSPSEG hdr;
+	const char *data;
+	char *p;
+
+	if (ck == NULL || buf == NULL || reply == NULL || replylen == NULL)
 	{
-		write_log("[qsp_send : %d] : error, argument error", __LINE__);
-		return -1;
+		log_error("[qsp_admit : %d] : error, argument error", __LINE__);
+		return QSP_ADMIT_DROP;
 	}
 
-	if (qsp->mode == QSP_MODE_WEAK && len > 256 * qsp->mss)
+	// 比COOKIE回复短的数据包不回复（不放大流量），也不可能是HELLO
+	if (len < (int)(QSP_HEAD_SIZE + ICOOKIE_SIZE))
 	{
-		write_log("[qsp_send : %d] : error, QSP_MODE_WEAK allow max length is %d", __LINE__, 256 * qsp->mss);
-		return -2;
+		ck->invalid++;
+		return QSP_ADMIT_DROP;
 	}
 
-	QSPNODE *qnode;
-	int count, i;
-	int datalen = len;
-
-	if (len <= (int)qsp->mss)
-		count = 1;
-	else
-		count = (len + qsp->mss - 1) / qsp->mss;
-
-	if (count == 0)
-		count = 1;
-
-	// ݽƬ
-	for (i = 0; i < count; i++)
+	data = qsp_decode_seg(buf, &hdr);
+	if (hdr.cmd < QSP_CMD_PUSH || hdr.cmd > QSP_CMD_COOKIE || hdr.cmd == QSP_CMD_COOKIE ||
+		hdr.mode < QSP_MODE_HALF || hdr.mode > QSP_MODE_SINGLE || (int)hdr.len > len - (int)QSP_HEAD_SIZE)
 	{
-		int size = len >(int)qsp->mss ? (int)qsp->mss : len;
+		ck->invalid++;
+		return QSP_ADMIT_DROP;
+	}
 
-		qnode = qsp_segment_new(size);
-		if (qnode == NULL)
+	if (hdr.cmd == QSP_CMD_HELLO && hdr.len == ICOOKIE_SIZE)
+	{
+		int hr = icookie_check(ck, hdr.conv, addr, addrlen, current, data);
+		if (hr == ICOOKIE_OK)
 		{
-			write_log("[qsp_send : %d] : error, qsp_segment_new function return NULL", __LINE__);
-			return -3;
+			ck->accepted++;
+			if (conv) *conv = hdr.conv;
+			return QSP_ADMIT_OK;
 		}
-
-		if (buf && len > 0) {
-			memcpy(qnode->seg.data, buf, size);
+		if (hr == ICOOKIE_BAD)
+		{
+			ck->invalid++;
+			return QSP_ADMIT_DROP;
 		}
+	}
 
-		// װͷϢ
-		qnode->seg.conv = qsp->conv;					// ıʶ
-		qnode->seg.frg = count - i - 1;					// ͵˳෴һţ0
-		qnode->seg.ts = qsp_click(qsp);					// ʱжϱǷظ
-		qnode->seg.sn = count;							// 鱨ĵ
-		qnode->seg.cmd = QSP_CMD_PUSH;					// ĵĶ
-		qnode->seg.mode = qsp->mode;					// ͨģʽ
-		qnode->seg.ver = qsp->ver;						// Э汾
-		qnode->seg.len = size;							// ݶεĳ
-
-		iqueue_init(&qnode->node);
-		iqueue_add_tail(&qnode->node, &qsp->snd_queue);	// 뵽snd_queueβУ
-		qsp->nsnd_que++;
+	// 没有cookie、cookie过期或者会话不存在时的其他报文（对端带回cookie的HELLO丢失）：签发新的cookie
+	memset(&qnode, 0, sizeof(qnode));
+	qnode.seg.conv = hdr.conv;
+	qnode.seg.ts = hdr.ts;
+	qnode.seg.sn = 1;
+	qnode.seg.cmd = QSP_CMD_COOKIE;
+	qnode.seg.mode = hdr.mode;
+	qnode.seg.ver = QSP_VERSION;
+	qnode.seg.len = ICOOKIE_SIZE;
+
+	p = qsp_encode_seg(reply, &qnode);
+	icookie_make(ck, hdr.conv, addr, addrlen, current, p);
+	*replylen = QSP_HEAD_SIZE + ICOOKIE_SIZE;
+	ck->issued++;
+
+	return QSP_ADMIT_REPLY;
+}
 
-		if (buf)
-			buf = (const char*)buf + size;
+// 设置流模式（0：消息模式 / 1：字节流模式），只能在收发队列为空时切换
+int qsp_setstream(QSP * qsp, int stream)
+{
+	assert(qsp);
 
-		len -= size;
+	if (qsp->nsnd_que != 0 || qsp->nrcv_que != 0)
+	{
+		log_error("[qsp_setstream : %d] : error, queue is not empty", __LINE__);
+		return -1;
 	}
 
-	if (qsp_send_flush(qsp))
+	// 消息模式与字节流模式的接收包号含义不同
+	if (qsp->stream != (stream ? 1 : 0))
 	{
-		write_log("[qsp_send : %d] : error, qsp_send_flush error", __LINE__);
-		return -3;
+		for (int i = 0; i < QSP_LANE_NUM; i++)
+			qsp->lane[i].rcv_nxt = stream ? 0 : (IUINT32)-1;
 	}
 
-	return datalen;
+	qsp->stream = stream ? 1 : 0;
+
+	return 0;
 }
 
-//  <- recv_queueУѽնȡݣ
-int qsp_recv(QSP *qsp, void * buf, int len)
+// 处理已到达的报文，重传超时的报文片段并继续发送待发送队列（不阻塞），分块接收与非阻塞模式下由用户循环调用
+int qsp_update(QSP * qsp)
 {
 	assert(qsp);
-	assert(buf);
 
-	printf("--in qsp_recv()\n");
-restart:
+	return qsp_updateex(qsp, qsp_tick(qsp));
+}
+
+// 同qsp_update，current为调用方本轮事件循环读取的时间（毫秒），多个会话共用一次读取
+int qsp_updateex(QSP * qsp, IUINT32 current)
+{
+	assert(qsp);
+
+	qsp->current = current;
+
+	if (qsp->dead)
+		return QSP_EDEAD;
+
 	if (qsp_recv_flush(qsp) < 0)
 	{
-		write_log("[qsp_recv : %d] : error, qsp_recv_flush return < 0", __LINE__);
+		log_error("[qsp_update : %d] : error, qsp_recv_flush return < 0", __LINE__);
 		return -1;
 	}
+	qsp_wnd_update(qsp);
 
-	struct IQUEUEHEAD *p;
-	int ispeek = (len < 0) ? 1 : 0;
-	int peeksize;
-	QSPNODE *qnode;
-
-	if (iqueue_is_empty(&qsp->rcv_queue))
+	// 发送间隔内只接收（多轮的发送合并为一轮，减少CPU占用）
+	if ((qsp->nsnd_que != 0 || !iqueue_is_empty(&qsp->snd_buf))
+		&& (qsp->interval == 0 || _itimediff(current, qsp->flush_ts) >= (long)qsp->interval))
 	{
-		write_log("[qsp_recv : %d] : error, rcv_queue is empty", __LINE__);
-		goto restart;
-		return -1;
+		qsp_send_once(qsp);
+		qsp->flush_ts = current;
 	}
 
-	if (len < 0) len = -len;
+	qsp_check_link(qsp);
+	qsp_stats_sync(qsp);
 
-	peeksize = qsp_peeksize(qsp);
+	return qsp->dead ? QSP_EDEAD : 0;
+}
 
-	if (peeksize < 0)
-		return -2;
+// 设置非阻塞模式：qsp_send只发送一轮（剩余的数据由qsp_update继续发送），qsp_recv没有完整的报文时返回QSP_EAGAIN
+int qsp_setnonblock(QSP * qsp, int nonblock)
+{
+	assert(qsp);
 
-	if (peeksize > len)
-		return -3;
+	qsp->nonblock = nonblock ? 1 : 0;
 
-	// Ƭƴ
-	for (len = 0, p = qsp->rcv_queue.next; p != &qsp->rcv_queue; )
-	{
-		int fragment;
-		qnode = iqueue_entry(p, QSPNODE, node);
-		p = p->next;
+	return 0;
+}
 
-		if (buf) {
-			memcpy(buf, qnode->seg.data, qnode->seg.len);
-			buf = (char*)buf + qnode->seg.len;
-		}
+// 设置分块接收回调函数：有序到达的报文片段直接交给回调函数，不再放入rcv_queue（回调函数返回非0时放弃该报文的剩余片段）
+int qsp_setchunk(QSP * qsp, int(*chunk)(const char *buf, int len, int last, QSP *qsp, void *user))
+{
+	assert(qsp);
 
-		len += qnode->seg.len;
-		fragment = qnode->seg.frg;
+	qsp->chunk = chunk;
 
-		// ͵ݲɾԭڵ
-		if (ispeek == 0) {
-			iqueue_del(&qnode->node);
-			qsp_segment_delete(qnode);
-			qsp->nrcv_que--; // ҪյĽڵ
-		}
+	return 0;
+}
 
-		if (fragment == 0)
-			break;
-	}
+// 设置不可靠数据报的接收回调函数（没有设置时丢弃收到的数据报）
+int qsp_setdgram(QSP * qsp, int(*dgram)(const char *buf, int len, IUINT16 sid, QSP *qsp, void *user))
+{
+	assert(qsp);
 
-	assert(len == peeksize);
+	qsp->dgram = dgram;
 
-	printf("--out qsp_recv()\n");
-	return len;
+	return 0;
 }
 
-// ýݻص()
-int qsp_setinput(QSP * qsp, int(*input)(char *buf, int len, QSP *qsp, void *user))
+// 立即发送待发送队列中的数据（字节流模式下发送未满MSS的片段，QSP_SEND_MORE放入队列的报文）
+int qsp_flush(QSP * qsp)
 {
-	if (qsp == NULL || input == NULL)
+	assert(qsp);
+
+	if (qsp->dead)
+		return QSP_EDEAD;
+
+	if (qsp->nsnd_que == 0)
+		return 0;
+
+	qsp_tick(qsp);
+	return qsp_send_flush(qsp);
+}
+
+// 设置逻辑流的发送优先级（越小越优先），同时决定qsp_recv读取多个逻辑流时的顺序
+int qsp_setprio(QSP * qsp, IUINT16 sid, IUINT32 prio)
+{
+	assert(qsp);
+
+	if (sid >= QSP_LANE_NUM)
+	{
+		log_error("[qsp_setprio : %d] : error, argument error", __LINE__);
 		return -1;
+	}
 
-	qsp->input = input;
+	qsp->lane[sid].prio = prio;
 
 	return 0;
 }
 
-// ÷ݻص()
-int qsp_setoutput(QSP * qsp, int(*output)(const char *buf, int len, QSP *qsp, void *user))
+// 设置逻辑流的权重（1 ~ QSP_WEIGHT_MAX），同一优先级的逻辑流按权重分配发送的字节数
+int qsp_setweight(QSP * qsp, IUINT16 sid, IUINT32 weight)
 {
-	if (qsp == NULL || output == NULL)
+	assert(qsp);
+
+	if (sid >= QSP_LANE_NUM || weight == 0 || weight > QSP_WEIGHT_MAX)
+	{
+		log_error("[qsp_setweight : %d] : error, argument error", __LINE__);
 		return -1;
+	}
 
-	qsp->output = output;
+	qsp->lane[sid].weight = weight;
 
 	return 0;
 }
 
-// ʱӻصȡǰϵͳʱ䣨λ룩
-int qsp_setsystime(QSP * qsp, IUINT32(*systime)(void))
+// 设置发送调度方式（QSP_SCHED_PRIO / QSP_SCHED_EDF），超时重传总是先于新的报文片段
+int qsp_setsched(QSP * qsp, IUINT32 sched)
 {
 	assert(qsp);
-	assert(systime);
 
-	qsp->systime = systime;
+	if (sched != QSP_SCHED_PRIO && sched != QSP_SCHED_EDF)
+	{
+		log_error("[qsp_setsched : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	qsp->sched = sched;
 
 	return 0;
 }
 
-// ͨģʽ
-int qsp_setmode(QSP * qsp, IUINT32 mode)
+// 查询逻辑流的发送队列统计（按优先级汇总即为各个优先级的队列深度）
+int qsp_queuestat(const QSP * qsp, IUINT16 sid, QSPQUEUESTAT *stat)
 {
-	assert(qsp);
+	if (qsp == NULL || stat == NULL || sid >= QSP_LANE_NUM)
+	{
+		log_error("[qsp_queuestat : %d] : error, argument error", __LINE__);
+		return -1;
+	}
 
-	qsp->mode = mode;
+	const QSPLANE *lane = &qsp->lane[sid];
+
+	stat->prio = lane->prio;
+	stat->weight = lane->weight;
+	stat->queued = lane->nsnd_que;
+	stat->inflight = lane->nsnd_buf;
+	stat->wait_max = lane->wait_max;
+	stat->wait_avg = lane->nsent ? (IUINT32)(lane->wait_sum / lane->nsent) : 0;
+	stat->sent = lane->nsent;
+	stat->resent = lane->nresend;
 
 	return 0;
 }
@@ -15,9 +15,16 @@
 
 #include "log.h"
 #include "queue.h"
+#include "atomic.h"
 #include "network.h"
 #include "typedef.h"
 #include "allocator.h"
+#include "histogram.h"
+#include "trace.h"
+#include "capture.h"
+#include "cookie.h"
+#include "aead.h"
+#include "compress.h"
 
 #include <stddef.h>
 #include <stdlib.h>
@@ -32,77 +39,276 @@ extern "C" {
 //	QSP BASE CONFIG DEFINE
 //--------------------------------------------------
 
-#define QSP_MTU_SIZE 1400		// ύ²ЭMTUС
-#define QSP_HEAD_SIZE (IOFFSETOF(QSPSEG, data) - IOFFSETOF(QSPSEG, conv))	// ͷС
-#define QSP_BUF_SIZE (QSP_MTU_SIZE * 3)	// С
-#define QSP_PASS_NUM 2			// ƬΣΪǶزģǵģʽ
+#define QSP_MTU_SIZE 1400		// 默认：提交给下层协议的MTU大小（UDP数据的长度）
+#define QSP_MTU_MIN 576			// qsp_setmtu允许的最小MTU
+#define QSP_MTU_MAX 65000		// qsp_setmtu允许的最大MTU（片段长度为16bit，本机回环的MTU为65536）
+#define QSP_HEAD_SIZE (IOFFSETOF(QSPSEG, data) - IOFFSETOF(QSPSEG, conv))	// 报文头部大小
+#define QSP_BUF_SIZE (QSP_MTU_SIZE * 3)	// 缓冲区的最小大小（MTU或者路径MTU探测的上限更大时按其分配）
+#define QSP_CRYPTO_OVERHEAD (8 + IAEAD_TAG_SIZE)	// 加密开销：包号（8字节） + 认证标签
+#define QSP_PASS_NUM 2			// 默认：错过两个报文片段，则认为是丢包，请求重补报文（非单工模式）
 
-#define QSP_VERSION 65535		// QSPЭ汾16bit
-#define QSP_TIME_OUT 200		// ACKʱλ
-#define QSP_SINGLE_NUM 3		// ģʽ£ÿƬη3
+#define QSP_VERSION 65535		// QSP协议版本，16bit
+#define QSP_TIME_OUT 200		// 默认：ACK超时间隔（重传超时的下限），单位：毫秒
+#define QSP_RTO_MAX 60000		// 重传超时的上限，单位：毫秒
+#define QSP_XMIT_MAX 20			// 默认：片段超时重传20次（指数退避）仍没有确认，认为对端失效
+#define QSP_SINGLE_NUM 3		// 默认：单工模式下，每个报文片段发送3次
+#define QSP_COPIES_MAX 8		// 单工模式下，每个报文片段最多发送8次
+#define QSP_WEAK_MAX 256		// 微双工模式下ACK只有一个字节，最多同时等待256个报文片段
+#define QSP_SND_WND 32			// 默认发送窗口：最多同时等待ACK的报文片段数
+#define QSP_RCV_WND 128			// 默认接收窗口：rcv_buf与rcv_queue中最多缓存的报文片段数
+#define QSP_WND_MIN 4			// 自动调整接收窗口时的最小值
+#define QSP_WND_MAX 65535		// 窗口的最大值（报文头部wnd字段为16bit）
+#define QSP_WND_INTERVAL 100	// 自动调整接收窗口的统计周期，单位：毫秒
+#define QSP_CWND_INIT 4			// 拥塞控制：初始拥塞窗口（报文片段数）
+#define QSP_CWND_MIN 2			// 拥塞控制：丢包后慢启动阈值的下限（报文片段数）
+#define QSP_PMTU_PROBES 3		// 路径MTU探测：同一个大小的探测包连续3次没有回应，认为超过路径MTU
+#define QSP_PMTU_STEP 16		// 路径MTU探测：搜索范围小于16字节时结束搜索
+#define QSP_PMTU_RAISE 600000	// 路径MTU探测：搜索结束10分钟后重新向上探测（RFC 8899 PMTU_RAISE_TIMER），单位：毫秒
 
-#define QSP_CMD_PUSH 81			// cmd: push ()
-#define QSP_CMD_ACK 82			// cmd: ack (AKCӦ)
-#define QSP_CMD_AGAIN 83		// cmd: again (Ҫش)
+#define QSP_CMD_PUSH 81			// cmd: push (传输数据)
+#define QSP_CMD_ACK 82			// cmd: ack (AKC应答)
+#define QSP_CMD_AGAIN 83		// cmd: again (要求重传)
+#define QSP_CMD_WASK 84			// cmd: window ask (窗口探测)
+#define QSP_CMD_WINS 85			// cmd: window size (回应窗口大小)
+#define QSP_CMD_DGRAM 86		// cmd: datagram (不可靠数据报，不回应ACK、不重传)
+#define QSP_CMD_DROP 87			// cmd: drop (放弃超过期限的报文，接收方跳过该报文序号)
+#define QSP_CMD_HELLO 88		// cmd: hello (握手：带回服务端签发的cookie，还没有cookie时为全0)
+#define QSP_CMD_COOKIE 89		// cmd: cookie (握手：服务端签发的无状态cookie)
+#define QSP_CMD_PMTU 90			// cmd: path mtu probe (路径MTU探测：frg为探测大小，数据填充到该大小；回应的len为0)
 
-#define QSP_MODE_HALF 91		// mode: half (˫)Իظ
-#define QSP_MODE_WEAK 92		// mode: weak (΢˫)ֻܻظһֽڵ
-#define QSP_MODE_SINGLE 93		// mode: single ()ظκ
+#define QSP_MODE_HALF 91		// mode: half (半双工)：可以回复任意数据
+#define QSP_MODE_WEAK 92		// mode: weak (微双工)：只能回复一个字节的数据
+#define QSP_MODE_SINGLE 93		// mode: single (单工)：不回复任何数据
+
+#define QSP_HS_NONE 0			// 握手：不握手（对端已经有会话）
+#define QSP_HS_WAIT 1			// 握手：等待服务端的cookie，不发送数据
+#define QSP_HS_DONE 2			// 握手：已经带回cookie
+
+#define QSP_ADMIT_OK 1			// 准入检查：cookie有效，可以创建会话
+#define QSP_ADMIT_REPLY 0		// 准入检查：把reply中的cookie发回对端
+#define QSP_ADMIT_DROP -1		// 准入检查：丢弃
+
+#define QSP_MEM_SND_QUEUE 0		// 内存统计：snd_queue
+#define QSP_MEM_SND_BUF 1		// 内存统计：snd_buf
+#define QSP_MEM_RCV_BUF 2		// 内存统计：rcv_buf
+#define QSP_MEM_RCV_QUEUE 3		// 内存统计：rcv_queue
+#define QSP_MEM_NUM 4
+
+#define QSP_EAGAIN -4			// 超过内存硬限制 / 非阻塞模式没有完整的报文，稍后重试（would block）
+#define QSP_EDEAD -5			// 会话已失效（对端无响应 / 空闲超时），队列已释放，只能qsp_release
+
+#define QSP_DEAD_RETRY 1		// 失效原因：片段超时重传次数达到上限
+#define QSP_DEAD_TIMEOUT 2		// 失效原因：有待发送的数据时对端超过期限没有响应
+#define QSP_DEAD_IDLE 3			// 失效原因：超过空闲期限没有收到对端的数据包
+
+#define QSP_PROFILE_DEFAULT 0	// 预设参数：编译时的默认值（重传超时下限200ms，窗口32 / 128）
+#define QSP_PROFILE_LOWLAT 1	// 预设参数：低延迟（重传超时下限30ms，错过一个片段即请求重传，丢包时延迟低，但会有多余的重传）
+#define QSP_PROFILE_BALANCED 2	// 预设参数：均衡（重传超时下限100ms，窗口128 / 512）
+#define QSP_PROFILE_BULK 3		// 预设参数：大流量（发送间隔10ms，窗口1024 / 2048，吞吐量高、CPU占用低，排队延迟高）
+#define QSP_PROFILE_NUM 4
+
+#define QSP_FLAG_ZIP 0x01		// 报文标志：报文经过压缩（数据为4字节原长 + LZ压缩数据，报文的所有片段都带此标志）
+#define QSP_ZIP_MIN 64			// 默认：不小于64字节的报文才尝试压缩
+#define QSP_ZIP_PROBE 4096		// 超过两倍的报文先压缩前4096字节试探，收益不足时整个报文不压缩
+#define QSP_ZIP_GAIN 8			// 压缩后至少节省1/8才使用压缩数据
+
+#define QSP_STREAM_SN 0			// 字节流模式的报文片段：sn为0，frg为流序号
+
+#define QSP_LANE_NUM 8			// 每个会话中独立有序的逻辑流数量（sid：0 ~ 7）
+#define QSP_SID_ANY 0xffff		// 接收时不指定逻辑流
+#define QSP_PRIO_DEFAULT 8		// 逻辑流的默认发送优先级（越小越优先）
+#define QSP_WEIGHT_DEFAULT 1	// 逻辑流的默认权重（同一优先级的逻辑流按权重分配带宽）
+#define QSP_WEIGHT_MAX 256		// 逻辑流权重的最大值
+
+#define QSP_SCHED_PRIO 0		// 发送调度：严格优先级，同一优先级按权重公平分配
+#define QSP_SCHED_EDF 1			// 发送调度：最早截止时间优先（报文的期限），没有期限的报文按优先级调度
+
+#define QSP_SEND_MORE 0x01		// 发送选项：只放入待发送队列，由qsp_flush统一发送
+#define QSP_SEND_DGRAM 0x02		// 发送选项：不可靠、无序的数据报（不超过MSS），立即发送，到达后直接交给dgram回调函数
+
+#define QSP_HIST_ACK_RTT 0		// 延迟直方图：片段发送到收到ACK的时间（只统计没有重传过的片段）
+#define QSP_HIST_MSG_ACKED 1	// 延迟直方图：报文进入发送队列到所有片段都被确认的时间（消息模式）
+#define QSP_HIST_MSG_REASM 2	// 延迟直方图：报文第一个片段到达到接收完整的时间（消息模式，分块接收不统计）
+#define QSP_HIST_NUM 3
+#define QSP_SIZE_CLASS_NUM 4	// 报文大小分类（按片段数）：1 / 2 ~ 16 / 17 ~ 256 / 256以上（字节流模式为0类）
 
 
 //--------------------------------------------------
 //	QSP TYPE DEFINE
 //--------------------------------------------------
 
-// head size 24
+// head size 32
 struct QSPSEG
 {
-	IUINT32 conv;			//Ựţıʶ
-	IUINT32 frg;			//Ƭfragment
-	IUINT32 ts;				//ʱtime stamp
-	IUINT32 sn;				//Ƭseg num
-	IUINT16 cmd;			//Ĵpush/ack/again
-	IUINT16 mode;			//ͨģʽhalf/weak/singleweakΪ(MSS - HEAD_SIZE) * 256
-	IUINT16 ver;			//汾ֵ65535
-	IUINT16 len;			//dataݵĳ
-
-	char data[1];			//ݶΣlenöεĴС
+	IUINT32 conv;			//会话编号（报文标识）
+	IUINT32 frg;			//报文片段序号fragment
+	IUINT32 ts;				//时间戳time stamp
+	IUINT32 sn;				//报文片段序数量（seg num）
+	IUINT16 cmd;			//报文处理动作（push/ack/again）
+	IUINT8 mode;			//通信模式（half/weak/single）（weak：单段数据最大为：(MSS - HEAD_SIZE) * 256）
+	IUINT8 flags;			//报文标志（QSP_FLAG_ZIP），与mode共用原来16bit的mode字段
+	IUINT16 ver;			//版本（最大值：65535）
+	IUINT16 len;			//data数据的长度
+	IUINT16 wnd;			//发送方的接收窗口剩余大小（报文片段数）
+	IUINT16 sid;			//逻辑流编号（各个逻辑流的包号与接收队列相互独立）
+	IUINT32 msn;			//报文序号（消息模式，每个逻辑流独立递增，用于判断重复的报文）
+
+	char data[1];			//数据段，用len来描述该段的大小
 };
 
 struct QSPNODE
 {
 	struct IQUEUEHEAD node;
-	IUINT32  ts;				//time stampʱ룩
-	struct QSPSEG seg;			//segmentģɱ䳤ȣ
+	IUINT32  ts;				//time stamp时间戳（毫秒）
+	IUINT32  size;				//节点占用的内存大小（字节，用于内存统计）
+	IUINT32  expire;			//报文的期限（毫秒时间戳，0为不限制）
+	IUINT32  xmit;				//发送次数（重传过的片段不用于RTT采样）
+	IUINT32  rexmit;			//连续超时重传的次数（指数退避，达到上限认为对端失效）
+	struct QSPSEG seg;			//segment报文（可变长度）
+};
+
+// 内存占用统计（字节，包含节点头部）
+struct QSPMEM
+{
+	IUINT64 bytes[QSP_MEM_NUM];		// 各个队列占用的字节数
+	IUINT64 total;					// 所有队列占用的字节数
+	IUINT64 dropped;				// 超过软限制时丢弃的不可靠数据字节数
+};
+
+// 逻辑流：独立的包号、待发送队列与接收队列，一个流丢包不阻塞其他流的交付
+struct QSPLANE
+{
+	IUINT32 snd_nxt, rcv_nxt;		// 下一个待发送的包号 / 下一个待接收的包号（消息模式：-1为等待新报文）
+	IUINT32 snd_msn, rcv_msn;		// 下一个待发送的报文序号 / 正在接收的报文序号
+	IUINT32 prio, weight;			// 发送优先级（越小越优先） / 权重
+	IUINT32 vtime;					// 加权公平调度的虚拟时间（已发送字节数 / 权重）
+	IUINT32 nsnd_que;				// snd_queue中的节点数
+	IUINT32 nsnd_buf;				// snd_buf中属于该流的节点数
+	IUINT32 nrcv_que;				// rcv_queue中的节点数
+	IUINT32 wait_max;				// 片段从进入snd_queue到第一次发送的最大等待时间（毫秒）
+	IUINT64 wait_sum;				// 片段第一次发送前的等待时间总和（毫秒）
+	IUINT64 nsent, nresend;			// 第一次发送的片段数 / 重传的片段数
+
+	struct IQUEUEHEAD snd_queue;	// 已切片的报文的队列
+	struct IQUEUEHEAD rcv_queue;	// 接收切片的报文队列，有序
+	struct IQUEUEHEAD rcv_buf;		// 接收报文切片的buf队列，如果丢包，则后续报文片段放入该队列
+};
+
+// 发送选项（qsp_sendex）
+struct QSPSENDOPT
+{
+	IUINT16 sid;					// 逻辑流编号
+	IUINT16 flags;					// QSP_SEND_MORE等
+	IUINT32 ttl;					// 报文的有效期（毫秒，0为不限制），超时还没有确认的报文被放弃（只用于消息模式）
+};
+
+// 逻辑流的发送队列统计（qsp_queuestat）
+struct QSPQUEUESTAT
+{
+	IUINT32 prio, weight;			// 发送优先级 / 权重
+	IUINT32 queued;					// snd_queue中等待发送的片段数
+	IUINT32 inflight;				// snd_buf中等待ACK的片段数
+	IUINT32 wait_max, wait_avg;		// 片段第一次发送前的最大 / 平均等待时间（毫秒）
+	IUINT64 sent, resent;			// 第一次发送的片段数 / 重传的片段数
+};
+
+// 会话统计（qsp_stats），计数器只增不减，进程汇总为所有会话之和
+struct QSPSTATS
+{
+	IUINT64 pkt_sent, byte_sent;		// 输出的数据包 / 字节数（包含ACK等控制报文）
+	IUINT64 pkt_recv, byte_recv;		// 输入的数据包 / 字节数
+	IUINT64 pkt_invalid;				// 格式错误、会话编号不符等而丢弃的数据包
+	IUINT64 pkt_unauth;					// 加密会话中认证失败或者重放而丢弃的数据包
+	IUINT64 seg_sent, seg_resent;		// 第一次发送 / 重传的报文片段
+	IUINT64 byte_resent;				// 重传的字节数（包含报文头部）
+	IUINT64 seg_recv, seg_dup;			// 收到的报文片段 / 其中重复而丢弃的
+	IUINT64 seg_reject;					// 接收窗口已满或超过内存限制而丢弃的报文片段
+	IUINT64 ack_sent, ack_recv;			// 发送 / 收到的ACK
+	IUINT64 again_sent, again_recv;		// 发送 / 收到的重传请求（AGAIN）
+	IUINT64 zip_msg, zip_bypass;		// 压缩发送的报文 / 压缩收益不足而原样发送的报文
+	IUINT64 zip_raw, zip_packed;		// 压缩发送的报文压缩前 / 压缩后的字节数
+	IUINT64 zip_us, unzip_us;			// 压缩（包括收益不足的尝试） / 解压的用时（微秒）
+	IUINT64 unzip_msg, unzip_error;		// 解压的报文 / 数据错误而丢弃的压缩报文
+	IUINT64 pmtu_sent, pmtu_acked;		// 发送的路径MTU探测包 / 收到回应的探测包
+
+	IUINT64 snd_que, snd_buf;			// 当前snd_queue / snd_buf中的片段数
+	IUINT64 rcv_buf, rcv_que;			// 当前rcv_buf / rcv_queue中的片段数
+	IUINT64 srtt, rttvar, rto;			// 平滑RTT / RTT偏差 / 重传超时（毫秒，进程汇总中为0）
 };
 
 struct QSP
 {
-	//Ự / MTU䵥Ԫ / MSSĳȣ / ͨģʽ / 汾
+	//会话编号 / MTU（最大传输单元） / MSS（最大报文长度） / 通信模式 / 版本
 	IUINT32 conv, mtu, mss, mode, ver;
-	//һ͵İ / һյİ
-	IUINT32 snd_nxt, rcv_nxt;
+	//流模式（0：消息模式 / 1：字节流模式） / 非阻塞模式
+	IUINT32 stream, nonblock;
+
+	IUINT32 nrcv_que, nsnd_que;		// 所有逻辑流rcv_queue中的节点数，snd_queue中的节点数
+	IUINT32 nrcv_buf, nsnd_buf;		// 所有逻辑流rcv_buf中的节点数，snd_buf中的节点数
 
-	IUINT32 nrcv_que, nsnd_que;		// rcv_queueеĽڵsnd_queueеĽڵ
-	IUINT32 nrcv_buf, nsnd_buf;		// rcv_bufеĽڵsnd_bufеĽڵ
+	IUINT32 snd_wnd, rcv_wnd, rmt_wnd;	// 发送窗口 / 接收窗口 / 对端通告的接收窗口（报文片段数）
+	IUINT32 wnd_auto, wnd_max;			// 根据读取速度自动调整接收窗口 / 自动调整的上限
+	IUINT32 wnd_ts, wnd_drain;			// 自动调整：统计开始的时间 / 统计期间读取的片段数
+	IUINT32 probe_ts;					// 窗口探测：上一次发送探测的时间
+	IUINT32 sched, vtime;				// 发送调度方式（QSP_SCHED_PRIO等） / 最近一次调度的虚拟时间
+	IUINT32 rx_srtt, rx_rttvar, rx_rto;	// 平滑RTT / RTT偏差 / 重传超时（毫秒）
+	IUINT32 interval, flush_ts;			// qsp_update两轮发送的最小间隔（毫秒，0为每次调用都发送） / 上一轮发送的时间
+	IUINT32 rto_min, pass, copies;		// 重传超时的下限（毫秒） / 错过多少个片段请求重传（0为不请求） / 单工模式每个片段的发送次数
+	IUINT32 cc, cwnd, ssthresh;			// 拥塞控制（0为关闭） / 拥塞窗口 / 慢启动阈值（报文片段数）
+	IUINT32 cwnd_acked, cc_ts;			// 拥塞避免阶段累计确认的片段数 / 上一次减小拥塞窗口的时间
+	IUINT32 current;					// 本轮调用开始时读取的系统时间（毫秒）
+	IUINT32 hs_state, hs_ts, hs_xmit;	// 握手状态（QSP_HS_NONE等） / 上一次发送HELLO的时间 / 发送HELLO的次数
+	char cookie[ICOOKIE_SIZE];			// 服务端签发的cookie
+	IUINT32 dead;						// 失效原因（QSP_DEAD_RETRY等，0为正常）
+	IUINT32 dead_xmit, dead_time;		// 片段超时重传次数上限 / 有待发送的数据时对端无响应的期限（毫秒，0为不限制）
+	IUINT32 keepalive, idle;			// 保活探测间隔 / 空闲期限（毫秒，0为不启用）
+	IUINT32 rcv_ts, ka_ts;				// 最近一次收到对端有效数据包的时间 / 最近一次发送保活探测的时间
+	IUINT32 zip, zip_min;				// 发送时压缩报文 / 尝试压缩的最小报文长度
+	IUINT32 pmtu_max;					// 路径MTU探测：探测的上限（0为不探测）
+	IUINT32 pmtu_lo, pmtu_hi;			// 路径MTU探测：已确认的大小 / 还没有失败过的最大值
+	IUINT32 pmtu_probe, pmtu_xmit;		// 路径MTU探测：正在探测的大小（0为没有探测） / 发送次数
+	IUINT32 pmtu_ts;					// 路径MTU探测：上一次发送探测的时间（没有探测时为搜索结束的时间）
+	IAEAD *aead;						// 加密上下文（NULL为不加密）
+	IUINT32 aead_role;					// 加密：本端角色（1发起方 / 0响应方），写入包号的最高位
+	IUINT64 aead_snd;					// 加密：下一个发送的包号
+	IUINT64 aead_rcv, aead_win;			// 加密：收到的最大包号 / 防重放窗口（第i位为包号aead_rcv - i已收到）
 
-	struct IQUEUEHEAD snd_queue;	// ƬıĵĶ
-	struct IQUEUEHEAD rcv_queue;	// ƬıĶУ
-	struct IQUEUEHEAD snd_buf;		// ͱı浽bufУȴack
-	struct IQUEUEHEAD rcv_buf;		// ձƬbufУƬηö
+	struct QSPSTATS stats;				// 会话统计（计数器部分）
+	struct QSPSTATS stats_sync;			// 已经汇总到进程统计中的值
+	IHISTOGRAM *hist;					// 延迟直方图（QSP_HIST_NUM * QSP_SIZE_CLASS_NUM，NULL为不统计）
+	ICAPTURE *capture;					// 抓包文件（NULL为不抓包）
 
-	void *user;						// ûַinputoutputصʹ
-	void *buff;						// buffer
-	struct QSPSEG last;				// һƬ״̬жǷظ
+	struct QSPMEM mem;					// 内存占用统计
+	IUINT64 mem_soft, mem_hard;			// 内存软限制 / 硬限制（字节，0为不限制）
 
-	IUINT32(*systime)(void);		// ȡϵͳʱĻصʱλ룩
-	int(*input)(char *buf, int len, struct QSP *kcp, void *user);			// 
-	int(*output)(const char *buf, int len, struct QSP *kcp, void *user);	// 
+	struct QSPLANE lane[QSP_LANE_NUM];	// 逻辑流
+	struct IQUEUEHEAD snd_buf;		// 发送报文保存到buf队列，等待ack（所有逻辑流共用）
+
+	void *user;						// 用户地址，用于input，output回调函数中使用
+	void *buff;						// buffer缓冲区
+	IUINT32 bufsize;				// buffer缓冲区的大小
+
+	IUINT32 chk_count, chk_frg;		// 分块发送：报文片段总数 / 下一个片段的包号
+	IUINT32 chk_msn;				// 分块发送：报文序号
+	IUINT32 chk_left, chk_need;		// 分块发送：报文剩余未写入的字节数 / 当前片段剩余未写入的字节数
+	struct QSPNODE *chk_node;		// 分块发送：正在填充的报文片段
+
+	IUINT32(*systime)(void);		// 获取系统时间的回调函数，用于时间戳（单位：毫秒）
+	int(*input)(char *buf, int len, struct QSP *kcp, void *user);			// 输入数据
+	int(*output)(const char *buf, int len, struct QSP *kcp, void *user);	// 输出数据
+	int(*chunk)(const char *buf, int len, int last, struct QSP *qsp, void *user);	// 分块接收（last：报文的最后一块，返回非0放弃该报文）
+	int(*dgram)(const char *buf, int len, IUINT16 sid, struct QSP *qsp, void *user);	// 接收不可靠数据报
+	void(*deadlink)(struct QSP *qsp, int reason, void *user);	// 会话失效通知（不能在回调函数中释放会话）
 };
 
 typedef struct QSP QSP;
 typedef struct QSPSEG QSPSEG;
 typedef struct QSPNODE QSPNODE;
+typedef struct QSPMEM QSPMEM;
+typedef struct QSPLANE QSPLANE;
+typedef struct QSPSENDOPT QSPSENDOPT;
+typedef struct QSPQUEUESTAT QSPQUEUESTAT;
+typedef struct QSPSTATS QSPSTATS;
 
 
 //--------------------------------------------------
@@ -114,11 +320,52 @@ int qsp_release(QSP *qsp);
 int qsp_version(QSP *qsp);
 int qsp_send(QSP *qsp, const void *buf, int len);
 int qsp_recv(QSP *qsp, void *buf, int len);
+int qsp_sendex(QSP *qsp, const void *buf, int len, const QSPSENDOPT *opt);
+int qsp_recvex(QSP *qsp, void *buf, int len, IUINT16 *sid);
+int qsp_setprio(QSP *qsp, IUINT16 sid, IUINT32 prio);
+int qsp_setweight(QSP *qsp, IUINT16 sid, IUINT32 weight);
+int qsp_setsched(QSP *qsp, IUINT32 sched);
+int qsp_queuestat(const QSP *qsp, IUINT16 sid, QSPQUEUESTAT *stat);
 
 int qsp_setinput(QSP *qsp, int(*input)(char *buf, int len, QSP *qsp, void *user));
 int qsp_setoutput(QSP *qsp, int(*output)(const char *buf, int len, QSP *qsp, void *user));
 int qsp_setsystime(QSP *qsp, IUINT32(*systime)(void));
 int qsp_setmode(QSP *qsp, IUINT32 mode);
+int qsp_setstream(QSP *qsp, int stream);
+int qsp_wndsize(QSP *qsp, int sndwnd, int rcvwnd);
+int qsp_nodelay(QSP *qsp, int interval, int rto_min, int resend, int cc);
+int qsp_setredundancy(QSP *qsp, int copies);
+int qsp_setprofile(QSP *qsp, int profile);
+const char* qsp_profile_name(int profile);
+int qsp_setautownd(QSP *qsp, int enable);
+int qsp_setmemlimit(QSP *qsp, IUINT64 soft, IUINT64 hard);
+int qsp_memusage(const QSP *qsp, QSPMEM *mem);
+int qsp_stats(const QSP *qsp, QSPSTATS *stats);
+int qsp_sethist(QSP *qsp, int enable);
+int qsp_setcapture(QSP *qsp, const char *path);
+int qsp_sethandshake(QSP *qsp, int enable);
+int qsp_setretry(QSP *qsp, IUINT32 xmit, IUINT32 timeout);
+int qsp_setkeepalive(QSP *qsp, IUINT32 interval, IUINT32 idle);
+int qsp_setdeadlink(QSP *qsp, void(*deadlink)(QSP *qsp, int reason, void *user));
+int qsp_setcrypto(QSP *qsp, int alg, const void *key, int keylen, int initiator);
+int qsp_setcompress(QSP *qsp, int enable, int minsize);
+int qsp_setmtu(QSP *qsp, int mtu);
+int qsp_setpmtud(QSP *qsp, int maxmtu);
+int qsp_isdead(const QSP *qsp);
+int qsp_admit(ICOOKIE *ck, const char *buf, int len, const void *addr, int addrlen, IUINT32 current,
+	IUINT32 *conv, char *reply, int *replylen);
+const IHISTOGRAM* qsp_hist(const QSP *qsp, int metric, int sclass);
+int qsp_flush(QSP *qsp);
+int qsp_update(QSP *qsp);
+int qsp_updateex(QSP *qsp, IUINT32 current);
+int qsp_setnonblock(QSP *qsp, int nonblock);
+
+int qsp_send_begin(QSP *qsp, IUINT32 len);
+int qsp_send_chunk(QSP *qsp, const void *buf, int len);
+int qsp_send_end(QSP *qsp);
+int qsp_setchunk(QSP *qsp, int(*chunk)(const char *buf, int len, int last, QSP *qsp, void *user));
+int qsp_setdgram(QSP *qsp, int(*dgram)(const char *buf, int len, IUINT16 sid, QSP *qsp, void *user));
+int qsp_peeksize(const QSP *qsp);
 void qsp_print(struct IQUEUEHEAD *head);
 
 #ifdef __cplusplus
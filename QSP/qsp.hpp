@@ -0,0 +1,215 @@
+#ifndef __QSP_HPP_
+#define __QSP_HPP_
+
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+#include "qsp.h"
+#include "systime.h"
+
+//=====================================================================
+// QSP的C++17封装（只有头文件）
+//=====================================================================
+// qsp::Session<Transport, Clock>：构造时创建会话，析构时qsp_release，
+// 只能移动不能复制。传输层与时钟是模板参数（编译时绑定）：
+//	struct Transport {
+//		int recv(char *buf, int len);			// 非阻塞读取一个数据包，没有数据返回0
+//		int send(const char *buf, int len);		// 发送一个数据包，返回len
+//	};
+//	struct Clock {
+//		static IUINT32 now();					// 当前时间（毫秒）
+//	};
+// 协议核心仍然通过input / output函数指针调用传输层，每个Session类型生成
+// 一对静态转发函数，Transport的recv / send内联在转发函数中（不再经过用户
+// 自己的void *user分派）；update直接读取Clock::now()传给qsp_updateex，
+// 读时间内联在调用方的事件循环中。会话默认是非阻塞模式（由update驱动）。
+//
+// 用法：
+//	qsp::Session<UdpTransport> s(conv, UdpTransport(fd));
+//	s.send(qsp::span<const char>(buf, len));
+//	while (...) { s.update(); while ((n = s.recv(rbuf)) > 0) ...; }
+// 其他设置通过native()取得QSP*调用C接口。C++20下qsp::span就是std::span。
+//=====================================================================
+namespace qsp {
+
+#if defined(__cpp_lib_span)
+template <class T> using span = std::span<T>;
+#else
+// C++17没有std::span：只保存指针与长度的连续内存视图，可以由数组 / 带data()与size()的容器隐式构造
+template <class T>
+class span
+{
+public:
+	span() noexcept : _data(NULL), _size(0) {}
+	span(T *data, size_t size) noexcept : _data(data), _size(size) {}
+
+	template <size_t N>
+	span(T(&array)[N]) noexcept : _data(array), _size(N) {}
+
+	template <class C, class = typename std::enable_if<
+		std::is_convertible<decltype(std::declval<C&>().data()), T*>::value>::type>
+	span(C &c) noexcept : _data(c.data()), _size(c.size()) {}
+
+	T* data() const noexcept { return _data; }
+	size_t size() const noexcept { return _size; }
+	bool empty() const noexcept { return _size == 0; }
+	T* begin() const noexcept { return _data; }
+	T* end() const noexcept { return _data + _size; }
+	T& operator[](size_t i) const noexcept { return _data[i]; }
+
+private:
+	T *_data;
+	size_t _size;
+};
+#endif
+
+// 默认时钟：systime.h的iclock（单调时钟，毫秒）
+struct SystemClock
+{
+	static IUINT32 now() { return iclock(); }
+};
+
+template <class Transport, class Clock = SystemClock>
+class Session
+{
+	static_assert(std::is_convertible<decltype(Clock::now()), IUINT32>::value, "Clock::now() must return milliseconds");
+	static_assert(std::is_convertible<decltype(std::declval<Transport&>().recv((char*)0, 0)), int>::value, "Transport::recv(char*, int) must return int");
+	static_assert(std::is_convertible<decltype(std::declval<Transport&>().send((const char*)0, 0)), int>::value, "Transport::send(const char*, int) must return int");
+
+public:
+	// 创建会话失败（内存不足）时valid()为false，其他函数返回-1
+	explicit Session(IUINT32 conv, Transport transport = Transport())
+		: _qsp(qsp_create(conv, NULL)), _transport(std::move(transport))
+	{
+		if (_qsp == NULL)
+			return;
+
+		_qsp->user = this;
+		qsp_setinput(_qsp, input);
+		qsp_setoutput(_qsp, output);
+		qsp_setsystime(_qsp, systime);
+		qsp_setnonblock(_qsp, 1);
+	}
+
+	~Session()
+	{
+		if (_qsp != NULL)
+			qsp_release(_qsp);
+	}
+
+	Session(const Session&) = delete;
+	Session& operator=(const Session&) = delete;
+
+	// 移动：会话的user指向新的对象
+	Session(Session &&other) noexcept
+		: _qsp(other._qsp), _transport(std::move(other._transport))
+	{
+		other._qsp = NULL;
+		if (_qsp != NULL)
+			_qsp->user = this;
+	}
+
+	Session& operator=(Session &&other) noexcept
+	{
+		if (this != &other)
+		{
+			if (_qsp != NULL)
+				qsp_release(_qsp);
+			_qsp = other._qsp;
+			_transport = std::move(other._transport);
+			other._qsp = NULL;
+			if (_qsp != NULL)
+				_qsp->user = this;
+		}
+		return *this;
+	}
+
+	bool valid() const noexcept { return _qsp != NULL; }
+	explicit operator bool() const noexcept { return _qsp != NULL; }
+
+	// C接口的会话（设置模式、窗口、加密等）
+	QSP* native() const noexcept { return _qsp; }
+	Transport& transport() noexcept { return _transport; }
+	const Transport& transport() const noexcept { return _transport; }
+
+	// 发送一个报文，返回值同qsp_send
+	int send(span<const char> data)
+	{
+		if (_qsp == NULL)
+			return -1;
+		return qsp_send(_qsp, data.data(), (int)data.size());
+	}
+
+	// 在逻辑流sid上发送一个报文，返回值同qsp_sendex
+	int send(span<const char> data, const QSPSENDOPT &opt)
+	{
+		if (_qsp == NULL)
+			return -1;
+		return qsp_sendex(_qsp, data.data(), (int)data.size(), &opt);
+	}
+
+	// 接收一个报文，返回报文长度，没有完整的报文返回QSP_EAGAIN，其他返回值同qsp_recv
+	int recv(span<char> buf)
+	{
+		if (_qsp == NULL)
+			return -1;
+		return qsp_recv(_qsp, buf.data(), (int)buf.size());
+	}
+
+	// 下一个报文的长度（没有完整的报文返回小于0）
+	int peeksize() const
+	{
+		if (_qsp == NULL)
+			return -1;
+		return qsp_peeksize(_qsp);
+	}
+
+	// 处理到达的数据包并发送一轮，当前时间直接由Clock读取
+	int update()
+	{
+		if (_qsp == NULL)
+			return -1;
+		return qsp_updateex(_qsp, (IUINT32)Clock::now());
+	}
+
+	// 同update，current为调用方本轮事件循环读取的时间，多个会话共用一次读取
+	int update(IUINT32 current)
+	{
+		if (_qsp == NULL)
+			return -1;
+		return qsp_updateex(_qsp, current);
+	}
+
+	bool dead() const noexcept { return _qsp == NULL || qsp_isdead(_qsp) != 0; }
+
+private:
+	// 转发函数：协议核心通过函数指针调用，Transport的函数内联在这里
+	static int input(char *buf, int len, QSP *, void *user)
+	{
+		return static_cast<Session*>(user)->_transport.recv(buf, len);
+	}
+
+	static int output(const char *buf, int len, QSP *, void *user)
+	{
+		return static_cast<Session*>(user)->_transport.send(buf, len);
+	}
+
+	static IUINT32 systime(void)
+	{
+		return (IUINT32)Clock::now();
+	}
+
+	QSP *_qsp;
+	Transport _transport;
+};
+
+}	// namespace qsp
+
+#endif // !__QSP_HPP_
@@ -0,0 +1,596 @@
+#ifndef __QSP_CORO_HPP_
+#define __QSP_CORO_HPP_
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "qsp.hpp"
+
+//=====================================================================
+// QSP的C++20协程接口（只有头文件）
+//=====================================================================
+// qsp::EventLoop<Clock>：单线程事件循环，每一轮读取一次时间，依次
+// qsp_updateex所有的会话，然后恢复条件已经满足的协程；没有协程被恢复
+// 时休眠1毫秒。一个协程只是一个协程帧，没有线程与栈，一个线程可以
+// 同时运行成千上万个请求流。
+// qsp::CoSession<Transport, Clock>：绑定到事件循环的会话（不能复制与
+// 移动，事件循环保存它的地址）：
+//	int n = co_await s.recv(buf);		// 报文长度，会话失效返回QSP_EDEAD
+//	qsp::Message m = co_await s.recv();	// 长度未知时：m.result为长度或者错误码
+//	co_await s.send(msg);				// 报文进入发送窗口（第一次发送）后恢复
+//	co_await s.send(msg, qsp::acked);	// 报文的所有片段都被确认后恢复
+// 同一个会话上等待的recv / send按co_await的顺序完成。超过内存硬限制时
+// send在事件循环中重试，不返回QSP_EAGAIN。字节流模式下acked要等到逻辑
+// 流没有待确认的数据（偏保守）；单工模式没有ACK，acked等同于accepted。
+// 协程的返回类型是qsp::Task<T>（惰性启动，可以co_await），顶层的任务
+// 用loop.spawn启动，loop.run()运行到所有任务结束。协程中不使用异常
+// （抛出异常时std::terminate）。会话销毁时等待它的协程收到QSP_EDEAD。
+//=====================================================================
+namespace qsp {
+
+template <class T = void> class Task;
+template <class Clock> class EventLoop;
+
+// send恢复的时机
+enum SendWait
+{
+	accepted,	// 报文进入发送窗口（第一次发送）
+	acked,		// 报文的所有片段都被确认
+};
+
+// recv()接收的报文
+struct Message
+{
+	int result;					// 报文长度，小于0为错误码
+	std::vector<char> data;
+
+	explicit operator bool() const noexcept { return result >= 0; }
+};
+
+namespace detail {
+
+// 协程结束：有等待者时切换到等待者（对称转移），spawn启动的任务直接销毁
+struct TaskFinal
+{
+	bool await_ready() const noexcept { return false; }
+
+	template <class P>
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+	{
+		auto &promise = h.promise();
+		if (promise.continuation)
+			return promise.continuation;
+		if (promise.tasks != nullptr)
+		{
+			--*promise.tasks;
+			h.destroy();
+		}
+		return std::noop_coroutine();
+	}
+
+	void await_resume() const noexcept {}
+};
+
+struct TaskPromiseBase
+{
+	std::coroutine_handle<> continuation;	// co_await该任务的协程
+	size_t *tasks = nullptr;				// spawn启动的任务：事件循环的任务计数
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	TaskFinal final_suspend() const noexcept { return {}; }
+	void unhandled_exception() const noexcept { std::terminate(); }
+};
+
+template <class T>
+struct TaskPromise : TaskPromiseBase
+{
+	std::optional<T> value;
+
+	template <class U>
+	void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+	T result() { return std::move(*value); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
+{
+	void return_void() const noexcept {}
+	void result() const noexcept {}
+};
+
+// 等待中的协程（侵入式单链表，节点在协程帧中）
+struct Waiter
+{
+	std::coroutine_handle<> handle;
+	Waiter *next = nullptr;
+	int result = 0;
+};
+
+struct WaitList
+{
+	Waiter *head = nullptr, *tail = nullptr;
+
+	bool empty() const noexcept { return head == nullptr; }
+
+	void push(Waiter *w) noexcept
+	{
+		w->next = nullptr;
+		if (tail != nullptr)
+			tail->next = w;
+		else
+			head = w;
+		tail = w;
+	}
+
+	Waiter* pop() noexcept
+	{
+		Waiter *w = head;
+		head = w->next;
+		if (head == nullptr)
+			tail = nullptr;
+		return w;
+	}
+};
+
+// 事件循环看到的会话
+class CoSessionBase
+{
+public:
+	virtual ~CoSessionBase() = default;
+	virtual int poll(IUINT32 current, std::vector<Waiter*> &ready) = 0;
+
+	size_t slot = 0;	// 在事件循环会话列表中的位置
+};
+
+}	// namespace detail
+
+template <class T>
+class Task
+{
+public:
+	struct promise_type : detail::TaskPromise<T>
+	{
+		Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	};
+
+	Task(Task &&other) noexcept : _h(std::exchange(other._h, nullptr)) {}
+	Task& operator=(Task &&other) noexcept
+	{
+		if (this != &other)
+		{
+			if (_h)
+				_h.destroy();
+			_h = std::exchange(other._h, nullptr);
+		}
+		return *this;
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+
+	~Task()
+	{
+		if (_h)
+			_h.destroy();
+	}
+
+	// co_await：启动任务，结束后恢复等待者
+	bool await_ready() const noexcept { return !_h || _h.done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+	{
+		_h.promise().continuation = caller;
+		return _h;
+	}
+	T await_resume() { return _h.promise().result(); }
+
+private:
+	template <class Clock> friend class EventLoop;
+
+	explicit Task(std::coroutine_handle<promise_type> h) noexcept : _h(h) {}
+
+	std::coroutine_handle<promise_type> release() noexcept { return std::exchange(_h, nullptr); }
+
+	std::coroutine_handle<promise_type> _h;
+};
+
+template <class Clock = SystemClock>
+class EventLoop
+{
+public:
+	EventLoop() = default;
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	// 启动顶层任务（在下一轮poll中开始运行），任务结束时自动销毁
+	void spawn(Task<void> task)
+	{
+		auto h = task.release();
+		if (!h)
+			return;
+		h.promise().tasks = &_tasks;
+		_tasks++;
+		_start.push_back(h);
+	}
+
+	// 运行一轮：更新所有会话，恢复条件满足的协程，返回恢复的协程数
+	int poll()
+	{
+		std::vector<std::coroutine_handle<>> start;
+		int resumed = 0;
+
+		_current = (IUINT32)Clock::now();
+
+		// 新任务与被销毁的会话唤醒的协程（恢复时可能再启动新任务）
+		start.swap(_start);
+		for (auto h : start)
+			h.resume();
+		resumed += (int)start.size();
+		resumed += resume(_woken);
+
+		// 会话列表在恢复协程时可能增加或者删除（删除的位置置空，之后再压缩）
+		for (size_t i = 0; i < _sessions.size(); i++)
+		{
+			if (_sessions[i] != nullptr && _sessions[i]->poll(_current, _ready) > 0)
+				resumed += resume(_ready);
+		}
+
+		if (_holes != 0)
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < _sessions.size(); i++)
+			{
+				if (_sessions[i] == nullptr)
+					continue;
+				_sessions[i]->slot = n;
+				_sessions[n++] = _sessions[i];
+			}
+			_sessions.resize(n);
+			_holes = 0;
+		}
+
+		return resumed;
+	}
+
+	// 运行到所有任务结束（或者stop），一轮没有恢复任何协程时休眠1毫秒
+	void run()
+	{
+		_stop = false;
+		while (_tasks > 0 && !_stop)
+		{
+			if (poll() == 0)
+				isleep(1);
+		}
+	}
+
+	void stop() noexcept { _stop = true; }
+
+	size_t tasks() const noexcept { return _tasks; }
+	size_t sessions() const noexcept { return _sessions.size() - _holes; }
+
+	// 本轮事件循环读取的时间（毫秒）
+	IUINT32 now() const noexcept { return _current; }
+
+private:
+	template <class, class> friend class CoSession;
+
+	void attach(detail::CoSessionBase *s)
+	{
+		s->slot = _sessions.size();
+		_sessions.push_back(s);
+	}
+
+	void detach(detail::CoSessionBase *s)
+	{
+		_sessions[s->slot] = nullptr;
+		_holes++;
+	}
+
+	// 被销毁的会话上还在等待的协程：下一轮收到QSP_EDEAD
+	void wake(detail::WaitList &waiters)
+	{
+		while (!waiters.empty())
+		{
+			detail::Waiter *w = waiters.pop();
+			w->result = QSP_EDEAD;
+			_woken.push_back(w);
+		}
+	}
+
+	// 恢复时被销毁的会话会向_woken追加（按下标遍历）
+	static int resume(std::vector<detail::Waiter*> &ready)
+	{
+		size_t i;
+		for (i = 0; i < ready.size(); i++)
+			ready[i]->handle.resume();
+		ready.clear();
+		return (int)i;
+	}
+
+	std::vector<detail::CoSessionBase*> _sessions;
+	std::vector<std::coroutine_handle<>> _start;
+	std::vector<detail::Waiter*> _woken;
+	std::vector<detail::Waiter*> _ready;
+	size_t _tasks = 0, _holes = 0;
+	IUINT32 _current = 0;
+	bool _stop = false;
+};
+
+template <class Transport, class Clock = SystemClock>
+class CoSession : public detail::CoSessionBase
+{
+	// recv等待者：message为true时接收长度未知的报文到data，否则接收到buf
+	struct RecvWaiter : detail::Waiter
+	{
+		CoSession *s;
+		span<char> buf;
+		std::vector<char> data;
+		bool message;
+
+		bool await_ready()
+		{
+			if (!s->_recv.empty())
+				return false;
+			result = s->try_recv(this);
+			return result != QSP_EAGAIN;
+		}
+		void await_suspend(std::coroutine_handle<> h) noexcept
+		{
+			handle = h;
+			s->_recv.push(this);
+		}
+	};
+
+public:
+	CoSession(EventLoop<Clock> &loop, IUINT32 conv, Transport transport = Transport())
+		: _loop(loop), _session(conv, std::move(transport))
+	{
+		_loop.attach(this);
+	}
+
+	~CoSession()
+	{
+		_loop.detach(this);
+		_loop.wake(_recv);
+		_loop.wake(_send);
+	}
+
+	CoSession(const CoSession&) = delete;
+	CoSession& operator=(const CoSession&) = delete;
+
+	bool valid() const noexcept { return _session.valid(); }
+	QSP* native() const noexcept { return _session.native(); }
+	Session<Transport, Clock>& session() noexcept { return _session; }
+	EventLoop<Clock>& loop() noexcept { return _loop; }
+
+	// co_await recv(buf)：报文长度或者错误码（同qsp_recv，不返回QSP_EAGAIN）
+	struct RecvAwaiter : RecvWaiter
+	{
+		int await_resume() const noexcept { return this->result; }
+	};
+
+	// co_await recv()：接收的报文
+	struct MessageAwaiter : RecvWaiter
+	{
+		Message await_resume() noexcept
+		{
+			if (this->result < 0)
+				this->data.clear();
+			return Message{ this->result, std::move(this->data) };
+		}
+	};
+
+	// co_await send(data)：返回值同qsp_sendex（不返回QSP_EAGAIN）
+	struct SendAwaiter : detail::Waiter
+	{
+		CoSession *s;
+		span<const char> data;
+		QSPSENDOPT opt;
+		SendWait wait;
+		bool queued;			// 已经放入发送队列
+		IUINT32 msn;			// 消息模式：报文序号
+		IUINT64 target;			// 字节流模式：逻辑流第一次发送的片段数达到target时进入了发送窗口
+
+		bool await_ready()
+		{
+			// 前面还有没放入队列的报文时排在后面（保持发送顺序）
+			if (s->_blocked == 0)
+				s->try_send(this);
+			return queued && s->sent(this);
+		}
+		void await_suspend(std::coroutine_handle<> h) noexcept
+		{
+			handle = h;
+			if (!queued)
+				s->_blocked++;
+			s->_send.push(this);
+		}
+		int await_resume() const noexcept { return result; }
+	};
+
+	RecvAwaiter recv(span<char> buf) noexcept
+	{
+		RecvAwaiter a;
+		a.s = this;
+		a.buf = buf;
+		a.message = false;
+		return a;
+	}
+
+	MessageAwaiter recv() noexcept
+	{
+		MessageAwaiter a;
+		a.s = this;
+		a.message = true;
+		return a;
+	}
+
+	SendAwaiter send(span<const char> data, SendWait wait = accepted) noexcept
+	{
+		QSPSENDOPT opt = { 0, 0, 0 };
+		return send(data, opt, wait);
+	}
+
+	SendAwaiter send(span<const char> data, const QSPSENDOPT &opt, SendWait wait = accepted) noexcept
+	{
+		SendAwaiter a;
+		a.s = this;
+		a.data = data;
+		a.opt = opt;
+		a.wait = wait;
+		a.queued = false;
+		a.msn = 0;
+		a.target = 0;
+		return a;
+	}
+
+	// 事件循环调用：更新会话，把条件满足的等待者放入ready
+	int poll(IUINT32 current, std::vector<detail::Waiter*> &ready) override
+	{
+		size_t n = ready.size();
+		int blocked = 0;
+
+		_session.update(current);
+
+		// recv：按等待顺序逐个取出报文
+		while (!_recv.empty())
+		{
+			int hr = try_recv(static_cast<RecvWaiter*>(_recv.head));
+			if (hr == QSP_EAGAIN)
+				break;
+			_recv.head->result = hr;
+			ready.push_back(_recv.pop());
+		}
+
+		// send：按顺序放入发送队列（一个失败后面的都不再尝试），进入窗口 / 被确认的报文恢复
+		detail::Waiter *prev = nullptr, *w = _send.head;
+		while (w != nullptr)
+		{
+			SendAwaiter *a = static_cast<SendAwaiter*>(w);
+			detail::Waiter *next = w->next;
+
+			if (!a->queued && !blocked)
+			{
+				if (try_send(a))
+					_blocked--;
+				else
+					blocked = 1;
+			}
+
+			if (a->queued && sent(a))
+			{
+				if (prev != nullptr)
+					prev->next = next;
+				else
+					_send.head = next;
+				if (_send.tail == w)
+					_send.tail = prev;
+				ready.push_back(w);
+			}
+			else
+			{
+				prev = w;
+			}
+			w = next;
+		}
+
+		return (int)(ready.size() - n);
+	}
+
+private:
+	int try_recv(RecvWaiter *w)
+	{
+		QSP *qsp = native();
+		int size;
+
+		if (qsp == nullptr)
+			return -1;
+		if (qsp_isdead(qsp))
+			return QSP_EDEAD;
+		if (!w->message)
+			return _session.recv(w->buf);
+
+		// 没有可以接收的逻辑流时qsp_peeksize返回0；压缩数据错误的报文返回小于0，
+		// 由qsp_recv丢弃该报文并返回错误，不阻塞后面的报文
+		if ((size = _session.peeksize()) == 0)
+			return QSP_EAGAIN;
+		if (size < 0)
+		{
+			char discard;
+			return _session.recv(span<char>(&discard, 0));
+		}
+		w->data.resize((size_t)size);
+		return _session.recv(span<char>(w->data.data(), w->data.size()));
+	}
+
+	// 放入发送队列，超过内存硬限制（QSP_EAGAIN）返回false，稍后重试
+	bool try_send(SendAwaiter *w)
+	{
+		QSP *qsp = native();
+		int hr;
+
+		hr = qsp != nullptr ? qsp_sendex(qsp, w->data.data(), (int)w->data.size(), &w->opt) : -1;
+		if (hr == QSP_EAGAIN)
+			return false;
+
+		w->result = hr;
+		w->queued = true;
+		if (hr >= 0 && (w->opt.flags & QSP_SEND_DGRAM) == 0)
+		{
+			QSPLANE *lane = &qsp->lane[w->opt.sid];
+			w->msn = lane->snd_msn - 1;
+			w->target = lane->nsent + lane->nsnd_que;
+		}
+		return true;
+	}
+
+	// 报文已经进入发送窗口 / 被确认（出错、会话失效时也返回true）
+	bool sent(SendAwaiter *w)
+	{
+		QSP *qsp = native();
+		struct IQUEUEHEAD *p;
+
+		if (w->result < 0 || (w->opt.flags & QSP_SEND_DGRAM) != 0)
+			return true;
+		if (qsp_isdead(qsp))
+		{
+			w->result = QSP_EDEAD;
+			return true;
+		}
+
+		QSPLANE *lane = &qsp->lane[w->opt.sid];
+
+		if (qsp->stream)
+		{
+			if (lane->nsent < w->target)
+				return false;
+			return w->wait == accepted || lane->nsnd_buf == 0;
+		}
+
+		// 逻辑流的snd_queue按报文序号排列：队首的报文序号更大时，该报文已经全部发送
+		if (!iqueue_is_empty(&lane->snd_queue)
+			&& (IINT32)(iqueue_entry(lane->snd_queue.next, QSPNODE, node)->seg.msn - w->msn) <= 0)
+			return false;
+		if (w->wait == accepted)
+			return true;
+
+		// snd_buf按第一次发送的顺序排列：该逻辑流的第一个片段就是最早的未确认报文
+		for (p = qsp->snd_buf.next; p != &qsp->snd_buf; p = p->next)
+		{
+			QSPNODE *qnode = iqueue_entry(p, QSPNODE, node);
+			if (qnode->seg.sid == w->opt.sid)
+				return (IINT32)(qnode->seg.msn - w->msn) > 0;
+		}
+		return true;
+	}
+
+	EventLoop<Clock> &_loop;
+	Session<Transport, Clock> _session;
+	detail::WaitList _recv, _send;
+	size_t _blocked = 0;	// 还没有放入发送队列的send等待者
+};
+
+}	// namespace qsp
+
+#endif // !__QSP_CORO_HPP_
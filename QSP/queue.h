@@ -2,23 +2,23 @@
 #define __QUEUE_H_
 
 //=====================================================================
-// QUEUE DEFINITION    ж -  iqueue_head   
+// QUEUE DEFINITION    队列定义 -  iqueue_head   
 //=====================================================================
 
 //=====================================================================
-// iqueue_init		IQUEUE_INIT			ʼУʼΪζУ
-// iqueue_entry		IQUEUE_ENTRY		ڵ׵ַ
-// iqueue_add		IQUEUE_ADD			headڵ֮½ڵ
-// iqueue_add_tail	IQUEUE_ADD_TAIL		headڵ֮ǰ½ڵ(ζУ뵽β)
-// iqueue_del		IQUEUE_DEL			ɾýڵ㣬prevnextڵ㣬Ըýڵ
-// iqueue_del_init	IQUEUE_DEL_INIT		ɾýڵ㣬prevnextڵ㣬ԸýڵʼΣ
-// iqueue_is_empty	IQUEUE_IS_EMPTY		жϽڵǷnextڵ㣨жϽڵnextָǷԼ
+// iqueue_init		IQUEUE_INIT			初始化队列（初始化为环形队列）
+// iqueue_entry		IQUEUE_ENTRY		节点首地址
+// iqueue_add		IQUEUE_ADD			在head节点之后插入新节点
+// iqueue_add_tail	IQUEUE_ADD_TAIL		在head节点之前插入新节点(环形队列，插入到队尾)
+// iqueue_del		IQUEUE_DEL			删除该节点，连接prev与next节点，并对该节点置零
+// iqueue_del_init	IQUEUE_DEL_INIT		删除该节点，连接prev与next节点，并对该节点初始化（环形）
+// iqueue_is_empty	IQUEUE_IS_EMPTY		判断节点是否有next节点（判断节点的next指向是否是自己）
 //=====================================================================
-// iqueue_foreach	IQUEUE_FOREACH		öУʽfor(xxx; xxx; xxx)Զṹ
-// iqueue_foreach_entry					öУʽfor(xxx; xxx; xxx)ֻڶнڵ
-// __iqueue_splice						listֽƴӵhead
-// iqueue_splice						listΪգlistֽƴӵhead
-// iqueue_splice_init					listƴӵheadϣlistʼ
+// iqueue_foreach	IQUEUE_FOREACH		遍历该队列（格式：for(xxx; xxx; xxx)）：可用于自定义结构体
+// iqueue_foreach_entry					遍历该队列（格式：for(xxx; xxx; xxx)）：只能用于队列节点类型
+// __iqueue_splice						把list分解拼接到head队列上
+// iqueue_splice						如果list不为空，则把list分解拼接到head队列上
+// iqueue_splice_init					把list拼接到head上，并对list做初始化
 //=====================================================================
 #ifndef __IQUEUE_DEF__
 #define __IQUEUE_DEF__
@@ -40,15 +40,15 @@ typedef struct IQUEUEHEAD iqueue_head;
 #define IQUEUE_HEAD(name) \
 	struct IQUEUEHEAD name = IQUEUE_HEAD_INIT(name)
 
-// ʼڵ㣬ʹΪζ
+// 初始化节点，使其成为环形队列
 #define IQUEUE_INIT(ptr) ( \
 	(ptr)->next = (ptr), (ptr)->prev = (ptr))
 
-// ȡṹгԱ׵ַƫ
+// 获取结构体中成员距首地址偏移量
 #define IOFFSETOF(TYPE, MEMBER) ((size_t) &((TYPE *)0)->MEMBER)
 
-// ȡнڵ׵ַ(ݽṹеĳԱַ - ṹгԱ׵ַƫ = ڵ׵ַ)
-// node.nextĵַmy_typeڵ׵ַ
+// 获取队列节点的首地址(根据结构体中的成员地址 - 结构体中成员距首地址偏移量 = 节点首地址)
+// 根据node.next的地址求出该my_type节点的首地址
 // struct my_type
 // {
 // 	int a;
@@ -58,7 +58,7 @@ typedef struct IQUEUEHEAD iqueue_head;
 #define ICONTAINEROF(ptr, type, member) ( \
 		(type*)( ((char*)((type*)ptr)) - IOFFSETOF(type, member)) )
 
-// ȡнڵ׵ַ
+// 获取队列节点的首地址
 #define IQUEUE_ENTRY(ptr, type, member) ICONTAINEROF(ptr, type, member)
 
 
@@ -66,30 +66,30 @@ typedef struct IQUEUEHEAD iqueue_head;
 //---------------------------------------------------------------------
 // queue operation                     
 //---------------------------------------------------------------------
-// headڵ֮½ڵ
+// 在head节点之后插入新节点
 #define IQUEUE_ADD(node, head) ( \
 	(node)->prev = (head), (node)->next = (head)->next, \
 	(head)->next->prev = (node), (head)->next = (node))
 
-// headڵ֮ǰ½ڵ
+// 在head节点之前插入新节点
 #define IQUEUE_ADD_TAIL(node, head) ( \
 	(node)->prev = (head)->prev, (node)->next = (head), \
 	(head)->prev->next = (node), (head)->prev = (node))
 
-// ɾڵ֮Ľڵ㣬ڵ
+// 删除两个节点之间的节点，连接两个节点
 #define IQUEUE_DEL_BETWEEN(p, n) ((n)->prev = (p), (p)->next = (n))
 
-// ɾýڵ㣬prevnextڵ
+// 删除该节点，连接prev与next节点
 #define IQUEUE_DEL(entry) (\
 	(entry)->next->prev = (entry)->prev, \
 	(entry)->prev->next = (entry)->next, \
 	(entry)->next = 0, (entry)->prev = 0)
 
-// ɾýڵ㣬ԸýڵгʼΣ
+// 删除该节点，并对该节点进行初始化（环形）
 #define IQUEUE_DEL_INIT(entry) do { \
 	IQUEUE_DEL(entry); IQUEUE_INIT(entry); } while (0)
 
-// ǷΪսڵ㣨жϽڵnextǷָԼ
+// 是否为空节点（判断节点的next是否指向自己）
 #define IQUEUE_IS_EMPTY(entry) ((entry) == (entry)->next)
 
 #define iqueue_init		IQUEUE_INIT
@@ -100,37 +100,37 @@ typedef struct IQUEUEHEAD iqueue_head;
 #define iqueue_del_init	IQUEUE_DEL_INIT
 #define iqueue_is_empty IQUEUE_IS_EMPTY
 
-// öУԶṹ壨ṹкжнڵ㣩ʽfor(xxx; xxx; xxx)
+// 遍历该队列：可用于自定义结构体（结构体中含有队列节点）（格式：for(xxx; xxx; xxx)）
 #define IQUEUE_FOREACH(iterator, head, TYPE, MEMBER) \
 	for ((iterator) = iqueue_entry((head)->next, TYPE, MEMBER); \
 		&((iterator)->MEMBER) != (head); \
 		(iterator) = iqueue_entry((iterator)->MEMBER.next, TYPE, MEMBER))
 
-// öУԶṹ壨ṹкжнڵ㣩ʽfor(xxx; xxx; xxx)
+// 遍历该队列：可用于自定义结构体（结构体中含有队列节点）（格式：for(xxx; xxx; xxx)）
 #define iqueue_foreach(iterator, head, TYPE, MEMBER) \
 	IQUEUE_FOREACH(iterator, head, TYPE, MEMBER)
 
-// öУֻڶнڵıַֻʽfor(xxx; xxx; xxx)
+// 遍历该队列：只能用于队列节点的遍历，只做地址遍历（格式：for(xxx; xxx; xxx)）
 #define iqueue_foreach_entry(pos, head) \
 	for( (pos) = (head)->next; (pos) != (head) ; (pos) = (pos)->next )
 
-// ƴζгΪһζУlistֽƴӵheadϣ
+// 拼接两个环形队列成为一个环形队列（把list分解拼接到head队列上）
 #define __iqueue_splice(list, head) do {	\
 		iqueue_head *first = (list)->next, *last = (list)->prev; \
 		iqueue_head *at = (head)->next; \
 		(first)->prev = (head), (head)->next = (first);		\
 		(last)->next = (at), (at)->prev = (last); }	while (0)
 
-// жlistΪգƴӵhead
+// 判断如果list不为空，则拼接到head上
 #define iqueue_splice(list, head) do { \
 	if (!iqueue_is_empty(list)) __iqueue_splice(list, head); } while (0)
 
-// listƴӵheadϣlistʼ
+// 把list拼接到head上，并对list做初始化
 #define iqueue_splice_init(list, head) do {	\
 	iqueue_splice(list, head);	iqueue_init(list); } while (0)
 
 
-// VSֹ
+// VS编译器禁止警告
 #ifdef _MSC_VER
 #pragma warning(disable:4311)
 #pragma warning(disable:4312)
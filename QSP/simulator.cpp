@@ -0,0 +1,178 @@
+#include <algorithm>
+
+#include "simulator.h"
+#include "log.h"
+
+LatencySimulator *LatencySimulator::_active = NULL;
+
+LatencySimulator::LatencySimulator(int lostrate, int rttmin, int rttmax, int nmax, IUINT32 seed) :
+	_lost{ Random(100, seed), Random(100, seed + 1) },
+	_reorder{ Random(100, seed + 2), Random(100, seed + 3) },
+	_dup{ Random(100, seed + 4), Random(100, seed + 5) },
+	_delay{ Random(0, seed + 6), Random(0, seed + 7) } {
+	SimLink link;
+	link.lostrate = lostrate / 2;	// 上面数据是往返丢包率，单程除以2
+	link.delaymin = rttmin / 2;
+	link.delaymax = rttmax / 2;
+	link.reorder = 0;
+	link.duplicate = 0;
+	link.bandwidth = 0;
+	link.nmax = nmax;
+	link.mtu = 0;
+
+	_current = 0;
+	_seq = 0;
+	tx1 = tx2 = 0;
+	for (int i = 0; i < 2; i++) {
+		_busy[i] = _last[i] = 0;
+		_link[i] = link;
+		memset(&_stat[i], 0, sizeof(_stat[i]));
+	}
+
+	activate();
+}
+
+LatencySimulator::~LatencySimulator() {
+	clear();
+	for (DelayTunnel::iterator it = _pool.begin(); it != _pool.end(); it++) {
+		delete *it;
+	}
+	_pool.clear();
+	if (_active == this) _active = NULL;
+}
+
+int LatencySimulator::setlink(int peer, const SimLink &link) {
+	if (peer < 0 || peer > 1 || link.lostrate < 0 || link.delaymin < 0 || link.delaymax < link.delaymin ||
+		link.reorder < 0 || link.duplicate < 0 || link.bandwidth < 0 || link.nmax < 0 || link.mtu < 0) {
+		write_log("[LatencySimulator::setlink : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+	_link[peer] = link;
+	return 0;
+}
+
+// 清除数据（数据包放回回收池）
+void LatencySimulator::clear() {
+	for (int i = 0; i < 2; i++) {
+		_pool.insert(_pool.end(), _tunnel[i].begin(), _tunnel[i].end());
+		_tunnel[i].clear();
+		_busy[i] = _last[i] = 0;
+	}
+}
+
+DelayPacket* LatencySimulator::alloc() {
+	if (_pool.empty()) return new DelayPacket();
+	DelayPacket *pkt = _pool.back();
+	_pool.pop_back();
+	return pkt;
+}
+
+void LatencySimulator::push(int peer, DelayPacket *pkt) {
+	_tunnel[peer].push_back(pkt);
+	std::push_heap(_tunnel[peer].begin(), _tunnel[peer].end(), Later());
+}
+
+// 单程延迟（微秒）：[delaymin, delaymax]内均匀分布
+IUINT64 LatencySimulator::delay(int peer) {
+	const SimLink &link = _link[peer];
+	IUINT64 us = (IUINT64)link.delaymin * 1000;
+	if (link.delaymax > link.delaymin)
+		us += _delay[peer].rand() % ((IUINT32)(link.delaymax - link.delaymin) * 1000);
+	return us;
+}
+
+void LatencySimulator::send(int peer, const void *data, int size) {
+	peer &= 1;
+	const SimLink &link = _link[peer];
+	SimStat &stat = _stat[peer];
+
+	if (peer == 0) tx1++;
+	else tx2++;
+	stat.tx++;
+
+	if (link.mtu > 0 && size > link.mtu) {
+		stat.toobig++;
+		return;
+	}
+	if (_lost[peer].random() < link.lostrate) {
+		stat.lost++;
+		return;
+	}
+	if (link.nmax > 0 && (int)_tunnel[peer].size() >= link.nmax) {
+		stat.overflow++;
+		return;
+	}
+
+	// 带宽限制：数据包依次占用链路，发送时间 = 链路空闲时间 + 数据包大小 / 带宽
+	IUINT64 ts = _current;
+	if (link.bandwidth > 0) {
+		_busy[peer] = std::max(_busy[peer], _current) + (IUINT64)size * 1000000 / link.bandwidth;
+		ts = _busy[peer];
+	}
+	ts += delay(peer);
+
+	// 没有乱序的数据包按发送顺序到达，乱序的数据包额外延迟delaymax
+	if (_reorder[peer].random() < link.reorder) {
+		ts += (IUINT64)link.delaymax * 1000 + 1000;
+		stat.reorder++;
+	}
+	else {
+		ts = std::max(ts, _last[peer]);
+		_last[peer] = ts;
+	}
+
+	DelayPacket *pkt = alloc();
+	pkt->assign(data, size);
+	pkt->setts(ts, _seq++);
+	push(peer, pkt);
+
+	if (_dup[peer].random() < link.duplicate) {
+		DelayPacket *dup = alloc();
+		dup->assign(data, size);
+		dup->setts(ts + delay(peer), _seq++);
+		push(peer, dup);
+		stat.duplicate++;
+	}
+}
+
+int LatencySimulator::recv(int peer, void *data, int maxsize) {
+	DelayTunnel &tunnel = _tunnel[(peer & 1) ^ 1];
+	SimStat &stat = _stat[(peer & 1) ^ 1];
+
+	if (tunnel.empty() || tunnel.front()->ts() > _current) return 0;
+
+	std::pop_heap(tunnel.begin(), tunnel.end(), Later());
+	DelayPacket *pkt = tunnel.back();
+	tunnel.pop_back();
+	_pool.push_back(pkt);
+
+	if (maxsize < pkt->size()) {
+		write_log("[LatencySimulator::recv : %d] : error, packet is too large", __LINE__);
+		return -1;
+	}
+
+	maxsize = pkt->size();
+	memcpy(data, pkt->ptr(), maxsize);
+	stat.rx++;
+	stat.bytes += maxsize;
+	return maxsize;
+}
+
+// 虚拟时钟（毫秒）
+IUINT32 LatencySimulator::systime(void) {
+	return _active ? _active->clock() : 0;
+}
+
+// 模拟网络：模拟接收一个 udp包
+int LatencySimulator::input(char *buf, int len, QSP *, void *user) {
+	if (_active == NULL) return -1;
+	int hr = _active->recv((int)(size_t)user, buf, len);
+	return hr < 0 ? 0 : hr;
+}
+
+// 模拟网络：模拟发送一个 udp包
+int LatencySimulator::output(const char *buf, int len, QSP *, void *user) {
+	if (_active == NULL) return -1;
+	_active->send((int)(size_t)user, buf, len);
+	return len;
+}
@@ -0,0 +1,206 @@
+#ifndef __SIMULATOR_H_
+#define __SIMULATOR_H_
+
+#include <string.h>
+#include <vector>
+
+#include "qsp.h"
+
+//=====================================================================
+// 确定性的网络模拟器（虚拟时钟）
+//=====================================================================
+// 两个端点（0/1）之间的两条单向链路，每个方向独立配置丢包、延迟抖动、
+// 乱序、重复、带宽与队列长度；随机数由种子决定，同样的种子得到同样的结果。
+// 时间只在advance时前进，与墙上时间无关：模拟几分钟的传输只需要几毫秒。
+//
+// 用法：
+//	LatencySimulator sim(10, 60, 125, 1000, seed);
+//	QSP *qsp = qsp_create(conv, (void*)0);		// user为端点编号0/1
+//	qsp_setinput(qsp, LatencySimulator::input);
+//	qsp_setoutput(qsp, LatencySimulator::output);
+//	qsp_setsystime(qsp, LatencySimulator::systime);
+//	qsp_setnonblock(qsp, 1);					// 单线程驱动时必须使用非阻塞模式
+//	while (...) { qsp_update(...); sim.advance(1); }
+//
+// qsp_setsystime的回调函数没有参数，input/output/systime作用于最近创建
+// （或者调用activate）的模拟器，同一时间只能有一个模拟器在运行。
+//=====================================================================
+
+// 单向链路的参数
+struct SimLink
+{
+	int lostrate;			// 丢包率（百分比）
+	int delaymin;			// 单程延迟的最小值（毫秒）
+	int delaymax;			// 单程延迟的最大值（毫秒），[delaymin, delaymax]内均匀分布（抖动）
+	int reorder;			// 乱序率（百分比）：数据包额外延迟delaymax，被后面的数据包超过
+	int duplicate;			// 重复率（百分比）：数据包被复制一份
+	int bandwidth;			// 带宽（字节/秒，0为不限制），超过带宽的数据包排队等待
+	int nmax;				// 链路中最多缓存的数据包数量，超过时丢弃新的数据包（0为不限制）
+	int mtu;				// 路径MTU（字节，0为不限制），更大的数据包被丢弃（不分片）
+};
+
+// 单向链路的统计
+struct SimStat
+{
+	IUINT64 tx;				// 发送的数据包
+	IUINT64 rx;				// 到达的数据包
+	IUINT64 lost;			// 随机丢弃的数据包
+	IUINT64 overflow;		// 队列满丢弃的数据包
+	IUINT64 toobig;			// 超过路径MTU丢弃的数据包
+	IUINT64 reorder;		// 乱序的数据包
+	IUINT64 duplicate;		// 重复的数据包
+	IUINT64 bytes;			// 到达的字节数
+};
+
+// 带延迟的数据包（到达时间：微秒）
+class DelayPacket
+{
+public:
+	DelayPacket() : _size(0), _ts(0), _seq(0) {}
+
+	void assign(const void *src, int size) {
+		if ((int)_data.size() < size) _data.resize(size);
+		memcpy(&_data[0], src, size);
+		_size = size;
+	}
+
+	unsigned char* ptr() { return &_data[0]; }
+	const unsigned char* ptr() const { return &_data[0]; }
+
+	int size() const { return _size; }
+	IUINT64 ts() const { return _ts; }
+	IUINT64 seq() const { return _seq; }
+	void setts(IUINT64 ts, IUINT64 seq) { _ts = ts; _seq = seq; }
+
+protected:
+	std::vector<unsigned char> _data;	// 数据（节点复用时保留容量）
+	int _size;
+	IUINT64 _ts;
+	IUINT64 _seq;						// 到达时间相同时按发送顺序
+};
+
+// 可设置种子的随机数（xorshift32）
+class Random
+{
+public:
+	// size：random()的取值范围[0, size)，在每size次中不重复地取完（均匀分布）
+	Random(int size, IUINT32 seed = 1) {
+		this->size = 0;
+		seeds.resize(size);
+		setseed(seed);
+	}
+
+	void setseed(IUINT32 seed) {
+		state = seed ? seed : 0x9e3779b9;
+		size = 0;
+	}
+
+	IUINT32 rand() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	int random() {
+		int x, i;
+		if (seeds.size() == 0) return 0;
+		if (size == 0) {
+			for (i = 0; i < (int)seeds.size(); i++) {
+				seeds[i] = i;
+			}
+			size = (int)seeds.size();
+		}
+		i = (int)(rand() % size);
+		x = seeds[i];
+		seeds[i] = seeds[--size];
+		return x;
+	}
+
+protected:
+	int size;
+	IUINT32 state;
+	std::vector<int> seeds;
+};
+
+// 网络延迟模拟器
+class LatencySimulator
+{
+public:
+	virtual ~LatencySimulator();
+
+	// lostrate: 往返一周丢包率的百分比，默认 10%
+	// rttmin：rtt最小值，默认 60
+	// rttmax：rtt最大值，默认 125
+	// nmax：每个方向最多缓存的数据包数量
+	// seed：随机数种子
+	LatencySimulator(int lostrate = 10, int rttmin = 60, int rttmax = 125, int nmax = 1000, IUINT32 seed = 1);
+
+	// 设置一个方向的链路参数（peer：发送方的端点编号）
+	int setlink(int peer, const SimLink &link);
+	const SimLink& link(int peer) const { return _link[peer & 1]; }
+	const SimStat& stat(int peer) const { return _stat[peer & 1]; }
+
+	// 清除数据
+	void clear();
+
+	// 发送数据
+	// peer - 端点0/1，从0发送，从1接收；从1发送从0接收
+	void send(int peer, const void *data, int size);
+
+	// 接收数据：返回数据长度，没有到达的数据返回0，缓冲区太小返回-1（丢弃该数据包）
+	int recv(int peer, void *data, int maxsize);
+
+	// 虚拟时钟前进（毫秒 / 微秒）
+	void advance(IUINT32 ms) { _current += (IUINT64)ms * 1000; }
+	void advance_us(IUINT64 us) { _current += us; }
+
+	// 当前虚拟时间（毫秒 / 微秒）
+	IUINT32 clock() const { return (IUINT32)(_current / 1000); }
+	IUINT64 clock_us() const { return _current; }
+
+	// 链路中还没有被接收的数据包数量（peer：接收方的端点编号）
+	int pending(int peer) const { return (int)_tunnel[(peer & 1) ^ 1].size(); }
+
+	// 设为input/output/systime回调函数使用的模拟器
+	void activate() { _active = this; }
+
+	// qsp回调函数（user为端点编号）
+	static IUINT32 systime(void);
+	static int input(char *buf, int len, QSP *qsp, void *user);
+	static int output(const char *buf, int len, QSP *qsp, void *user);
+
+public:
+	int tx1;
+	int tx2;
+
+protected:
+	DelayPacket* alloc();
+	void push(int peer, DelayPacket *pkt);
+	IUINT64 delay(int peer);
+
+	struct Later {
+		bool operator()(const DelayPacket *a, const DelayPacket *b) const {
+			return a->ts() != b->ts() ? a->ts() > b->ts() : a->seq() > b->seq();
+		}
+	};
+
+	typedef std::vector<DelayPacket*> DelayTunnel;		// 按到达时间排序的最小堆
+
+	IUINT64 _current;			// 虚拟时间（微秒）
+	IUINT64 _seq;
+	IUINT64 _busy[2];			// 链路空闲的时间（带宽限制）
+	IUINT64 _last[2];			// 最后一个没有乱序的数据包的到达时间（保证抖动不乱序）
+	SimLink _link[2];
+	SimStat _stat[2];
+	DelayTunnel _tunnel[2];		// 0：0->1，1：1->0
+	DelayTunnel _pool;			// 回收的数据包
+	Random _lost[2];
+	Random _reorder[2];
+	Random _dup[2];
+	Random _delay[2];
+
+	static LatencySimulator *_active;
+};
+
+#endif // !__SIMULATOR_H_
@@ -1,8 +1,13 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L		// clock_gettime / nanosleep
+#endif
+
 #include "systime.h"
 #include <time.h>
 #include <sys/time.h>
+#include <errno.h>
 
-/* get system time ȡϵͳʱ */
+/* get system time 获取系统时间 */
 void itimeofday(long *sec, long *usec)
 {
 #if defined(__unix)
@@ -30,14 +35,61 @@ void itimeofday(long *sec, long *usec)
 #endif
 }
 
-/* get clock in millisecond 64 ȡʱ䣨룩 */
+#if defined(ICLOCK_TSC) && defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+// TSC时钟：第一次调用时用单调时钟校准频率（约10毫秒）
+static IUINT64 iclock_tsc(void)
+{
+	IUINT32 lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((IUINT64)hi << 32) | lo;
+}
+#endif
+
+// 系统的单调时钟（微秒）
+static IUINT64 iclock_mono(void)
+{
+#if defined(__unix)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (IUINT64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	static IINT64 freq = 0;
+	IINT64 qpc;
+	if (freq == 0) {
+		QueryPerformanceFrequency((LARGE_INTEGER*)&freq);
+		freq = (freq == 0) ? 1 : freq;
+	}
+	QueryPerformanceCounter((LARGE_INTEGER*)&qpc);
+	return (IUINT64)(qpc / freq) * 1000000 + (IUINT64)(qpc % freq) * 1000000 / freq;
+#endif
+}
+
+/* monotonic clock in microsecond 单调时钟（微秒） */
+IUINT64 iclock_us(void)
+{
+#if defined(ICLOCK_TSC) && defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	static IUINT64 base_us = 0, base_tsc = 0;
+	static double scale = 0;
+	if (scale == 0) {
+		IUINT64 us0 = iclock_mono(), tsc0 = iclock_tsc(), us1, tsc1;
+		do {
+			us1 = iclock_mono();
+			tsc1 = iclock_tsc();
+		} while (us1 - us0 < 10000);
+		base_us = us1;
+		base_tsc = tsc1;
+		scale = (double)(us1 - us0) / (double)(tsc1 - tsc0);
+	}
+	return base_us + (IUINT64)((double)(iclock_tsc() - base_tsc) * scale);
+#else
+	return iclock_mono();
+#endif
+}
+
+/* get clock in millisecond 64 获取时间（毫秒，单调时钟） */
 IINT64 iclock64(void)
 {
-	long s, u;
-	IINT64 value;
-	itimeofday(&s, &u);
-	value = ((IINT64)s) * 1000 + (u / 1000);
-	return value;
+	return (IINT64)(iclock_us() / 1000);
 }
 
 IUINT32 iclock()
@@ -45,16 +97,26 @@ IUINT32 iclock()
 	return (IUINT32)(iclock64() & 0xfffffffful);
 }
 
-/* sleep in millisecond ˯ߣ룩 */
+/* sleep in millisecond 睡眠（毫秒） */
 void isleep(unsigned long millisecond)
 {
-#ifdef __unix 	/* usleep( time * 1000 ); */
-	struct timespec ts;
-	ts.tv_sec = (time_t)(millisecond / 1000);
-	ts.tv_nsec = (long)((millisecond % 1000) * 1000000);
-	/*nanosleep(&ts, NULL);*/
-	usleep((millisecond << 10) - (millisecond << 4) - (millisecond << 3));
+#ifdef __unix
+	iusleep(millisecond * 1000);
 #elif defined(_WIN32)
 	Sleep(millisecond);
 #endif
-}
\ No newline at end of file
+}
+
+/* sleep in microsecond 睡眠（微秒），被信号打断时继续睡眠剩余的时间 */
+void iusleep(unsigned long microsecond)
+{
+#ifdef __unix
+	struct timespec ts, rem;
+	ts.tv_sec = (time_t)(microsecond / 1000000);
+	ts.tv_nsec = (long)((microsecond % 1000000) * 1000);
+	while (nanosleep(&ts, &rem) == -1 && errno == EINTR)
+		ts = rem;
+#elif defined(_WIN32)
+	Sleep((DWORD)((microsecond + 999) / 1000));
+#endif
+}
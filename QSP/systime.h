@@ -7,17 +7,24 @@
 extern "C" {
 #endif
 
-/* get system time ȡϵͳʱ */
+/* get system time 获取系统时间 */
 void itimeofday(long *sec, long *usec);
 
-/* get clock in millisecond 64 ȡʱ䣨룩 */
+/* monotonic clock in microsecond 单调时钟（微秒，不受系统时间调整影响；定义ICLOCK_TSC时使用校准过的TSC） */
+IUINT64 iclock_us(void);
+
+/* get clock in millisecond 64 获取时间（毫秒，单调时钟） */
 IINT64 iclock64(void);
 
+/* get clock in millisecond 32 获取时间（毫秒，32位回绕，用_itimediff比较） */
 IUINT32 iclock();
 
-/* sleep in millisecond ˯ߣ룩 */
+/* sleep in millisecond 睡眠（毫秒） */
 void isleep(unsigned long millisecond);
 
+/* sleep in microsecond 睡眠（微秒） */
+void iusleep(unsigned long microsecond);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "atomic.h"
+#include "systime.h"
+#include "log.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ITRACE_TLS __declspec(thread)
+#else
+#define ITRACE_TLS __thread
+#endif
+
+// 每个线程的环形缓冲区（只有所属线程写入，head在记录写完之后才增加）
+struct ITRACERING
+{
+	struct ITRACERING *next;		// 所有线程的缓冲区链表
+	IUINT16 tid;					// 线程编号
+	volatile IUINT64 head;			// 已经写入的记录数量
+	ITRACEREC rec[ITRACE_RING_SIZE];
+};
+
+typedef struct ITRACERING ITRACERING;
+
+volatile int itrace_enabled = 0;
+
+static ITRACERING * volatile itrace_rings = NULL;	// 缓冲区链表（只增加，不释放：线程退出后记录仍然可以导出）
+static volatile IUINT32 itrace_nring = 0;
+static volatile IUINT32 itrace_based = 0;
+static IUINT64 itrace_tick0, itrace_us0;			// 开始跟踪时的时间戳 / 微秒时间（用于换算时钟频率）
+static ITRACE_TLS ITRACERING *itrace_local = NULL;
+
+static const char *itrace_names[ITRACE_EVENT_NUM] = {
+	"none", "send", "resend", "again_send", "again_recv", "ack_send", "ack_recv", "recv",
+	"dup", "reject_wnd", "reject_mem", "expire", "deliver", "flush", "probe"
+};
+
+// 微秒时间
+static IUINT64 itrace_us(void)
+{
+	long s, u;
+	itimeofday(&s, &u);
+	return (IUINT64)s * 1000000 + u;
+}
+
+// 时间戳：x86上为时钟周期计数器（几纳秒），其他平台为微秒时间
+static IUINT64 itrace_tick(void)
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	return __rdtsc();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	IUINT32 lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((IUINT64)hi << 32) | lo;
+#else
+	return itrace_us();
+#endif
+}
+
+// 创建当前线程的缓冲区，加入链表
+static ITRACERING* itrace_ring_new(void)
+{
+	ITRACERING *ring = (ITRACERING*)malloc(sizeof(ITRACERING));
+	ITRACERING *head;
+
+	if (ring == NULL)
+	{
+		write_log("[itrace_ring_new : %d] : error, malloc function return NULL", __LINE__);
+		return NULL;
+	}
+
+	memset(ring, 0, sizeof(ITRACERING));
+	ring->tid = (IUINT16)iatomic_add32(&itrace_nring, 1);
+
+	// 第一个缓冲区记录开始的时间，导出时换算时钟频率
+	if (iatomic_cas32(&itrace_based, 0, 1))
+	{
+		itrace_us0 = itrace_us();
+		itrace_tick0 = itrace_tick();
+		iatomic_fence();
+		itrace_based = 2;
+	}
+
+	do {
+		head = itrace_rings;
+		ring->next = head;
+	} while (!iatomic_casptr(&itrace_rings, head, ring));
+
+	return ring;
+}
+
+/* 开启 / 关闭跟踪 */
+void itrace_enable(int enable)
+{
+	itrace_enabled = enable ? 1 : 0;
+}
+
+/* 写入一条记录（通过ITRACE宏调用） */
+void itrace_write(IUINT16 event, IUINT32 conv, IUINT16 sid, IUINT32 msn, IUINT32 frg, IUINT32 len)
+{
+	ITRACERING *ring = itrace_local;
+	ITRACEREC *rec;
+
+	if (ring == NULL)
+	{
+		ring = itrace_local = itrace_ring_new();
+		if (ring == NULL)
+			return;
+	}
+
+	rec = &ring->rec[ring->head & (ITRACE_RING_SIZE - 1)];
+	rec->ts = itrace_tick();
+	rec->conv = conv;
+	rec->msn = msn;
+	rec->frg = frg;
+	rec->len = len;
+	rec->event = event;
+	rec->sid = sid;
+	rec->tid = ring->tid;
+	rec->reserved = 0;
+
+	// 记录写完之后再发布
+	iatomic_fence();
+	ring->head++;
+}
+
+/* 把所有线程的记录写入文件，成功返回记录数量，失败返回-1 */
+int itrace_dump(const char *path)
+{
+	ITRACEHDR hdr;
+	ITRACERING *ring;
+	IUINT64 us, tick;
+	FILE *fp;
+
+	if (path == NULL)
+	{
+		write_log("[itrace_dump : %d] : error, argument error", __LINE__);
+		return -1;
+	}
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		write_log("[itrace_dump : %d] : error, open %s failed", __LINE__, path);
+		return -1;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = ITRACE_MAGIC;
+	hdr.version = ITRACE_VERSION;
+	hdr.recsize = sizeof(ITRACEREC);
+
+	// 换算时钟频率：至少间隔10毫秒，误差在千分之一以内
+	if (itrace_based == 2)
+	{
+		do {
+			us = itrace_us();
+			tick = itrace_tick();
+		} while (us - itrace_us0 < 10000);
+		hdr.tick_hz = (tick - itrace_tick0) * 1000000 / (us - itrace_us0);
+		hdr.tick_base = itrace_tick0;
+	}
+	else
+	{
+		hdr.tick_hz = 1000000;
+	}
+
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	// 正在写入的线程可能覆盖最早的记录：只导出距离head一个缓冲区以内的记录
+	for (ring = itrace_rings; ring != NULL; ring = ring->next)
+	{
+		IUINT64 head = ring->head;
+		IUINT64 tail = head > ITRACE_RING_SIZE ? head - ITRACE_RING_SIZE : 0;
+		IUINT64 i;
+
+		hdr.dropped += (IUINT32)tail;
+		for (i = tail; i < head; i++)
+		{
+			fwrite(&ring->rec[i & (ITRACE_RING_SIZE - 1)], sizeof(ITRACEREC), 1, fp);
+			hdr.count++;
+		}
+	}
+
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	fclose(fp);
+
+	return (int)hdr.count;
+}
+
+/* 事件名称 */
+const char* itrace_name(int event)
+{
+	if (event <= 0 || event >= ITRACE_EVENT_NUM)
+		return "unknown";
+	return itrace_names[event];
+}
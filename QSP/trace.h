@@ -0,0 +1,97 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include "typedef.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=====================================================================
+// 二进制事件跟踪
+//=====================================================================
+// 跟踪点把固定大小（32字节）的记录写入当前线程的环形缓冲区：不格式化、
+// 不加锁、不分配内存（每个线程第一次写入时分配一次），缓冲区满时覆盖
+// 最早的记录。itrace_dump把所有线程的记录写入文件，用离线解码工具
+// （tools/qsp_trace.c）转换为文本。
+// 编译时定义QSP_NO_TRACE，所有跟踪点编译为空；运行时默认关闭，
+// 关闭时每个跟踪点只判断一次全局开关。
+//=====================================================================
+#define ITRACE_RING_BITS 12
+#define ITRACE_RING_SIZE (1 << ITRACE_RING_BITS)	// 每个线程的记录数量
+#define ITRACE_MAGIC 0x54505351						// 文件标识"QSPT"
+#define ITRACE_VERSION 1
+
+// 事件编号
+#define ITRACE_SEND 1			// 第一次发送报文片段（len：数据长度）
+#define ITRACE_RESEND 2			// 超时重传报文片段（len：数据长度）
+#define ITRACE_AGAIN_SEND 3		// 发送重传请求
+#define ITRACE_AGAIN_RECV 4		// 收到重传请求并重传（len：重传的数据长度，没有找到片段为0）
+#define ITRACE_ACK_SEND 5		// 回应ACK
+#define ITRACE_ACK_RECV 6		// 收到ACK（len：RTT采样，毫秒，重传过的片段为-1）
+#define ITRACE_RECV 7			// 收到报文片段（len：数据长度）
+#define ITRACE_DUP 8			// 重复的报文片段
+#define ITRACE_REJECT_WND 9		// 接收窗口已满，丢弃报文片段
+#define ITRACE_REJECT_MEM 10	// 超过内存硬限制，丢弃报文片段
+#define ITRACE_EXPIRE 11		// 报文超过期限被放弃
+#define ITRACE_DELIVER 12		// qsp_recv交付报文（len：报文长度）
+#define ITRACE_FLUSH 13			// qsp_send_flush（len：snd_queue中的片段数）
+#define ITRACE_PROBE 14			// 发送窗口探测（len：0） / 保活探测（len：1） / 路径MTU探测（len：探测包大小）
+#define ITRACE_EVENT_NUM 15
+
+// 跟踪记录（32字节）
+struct ITRACEREC
+{
+	IUINT64 ts;				// 时间戳（时钟周期，文件头中的tick_hz换算）
+	IUINT32 conv;			// 会话编号
+	IUINT32 msn;			// 报文序号
+	IUINT32 frg;			// 报文片段序号
+	IUINT32 len;			// 长度等参数（见事件说明）
+	IUINT16 event;			// 事件编号
+	IUINT16 sid;			// 逻辑流编号
+	IUINT16 tid;			// 线程编号（环形缓冲区的创建顺序）
+	IUINT16 reserved;
+};
+
+// 跟踪文件头，之后是count个ITRACEREC（按线程分组，同一线程按时间排序）
+struct ITRACEHDR
+{
+	IUINT32 magic;			// ITRACE_MAGIC
+	IUINT16 version;		// ITRACE_VERSION
+	IUINT16 recsize;		// sizeof(ITRACEREC)
+	IUINT32 count;			// 记录数量
+	IUINT32 dropped;		// 被覆盖的记录数量
+	IUINT64 tick_hz;		// 时间戳每秒的周期数
+	IUINT64 tick_base;		// 开始跟踪时的时间戳
+};
+
+typedef struct ITRACEREC ITRACEREC;
+typedef struct ITRACEHDR ITRACEHDR;
+
+extern volatile int itrace_enabled;
+
+/* 开启 / 关闭跟踪 */
+void itrace_enable(int enable);
+
+/* 写入一条记录（通过ITRACE宏调用） */
+void itrace_write(IUINT16 event, IUINT32 conv, IUINT16 sid, IUINT32 msn, IUINT32 frg, IUINT32 len);
+
+/* 把所有线程的记录写入文件，成功返回记录数量，失败返回-1 */
+int itrace_dump(const char *path);
+
+/* 事件名称 */
+const char* itrace_name(int event);
+
+#ifdef QSP_NO_TRACE
+#define ITRACE(event, conv, sid, msn, frg, len) ((void)0)
+#else
+#define ITRACE(event, conv, sid, msn, frg, len) do { \
+		if (itrace_enabled) itrace_write((event), (conv), (sid), (msn), (frg), (len)); \
+	} while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !__TRACE_H_
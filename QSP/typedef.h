@@ -6,11 +6,11 @@ extern "C" {
 #endif
 
 //=====================================================================
-// 32bitζ
+// 32bit整形定义
 //=====================================================================
-// ̨
-// ISTDUINT32(32bit)	޷32bit
-// ISTDINT32(32bit)	з32bit
+// 跨屏台处理定义
+// ISTDUINT32(32bit)：	无符号32bit整形
+// ISTDINT32(32bit)：	有符号32bit整形
 //=====================================================================
 #ifndef __INTEGER_32_BITS__
 #define __INTEGER_32_BITS__
@@ -56,18 +56,18 @@ typedef long ISTDINT32;
 #endif // !__INTEGER_32_BITS__
 
 //=====================================================================
-// ζ
+// 整形定义
 //=====================================================================
-// 
-// IINT8(8bit)	з8bit
-// IUINT8(8bit)	޷8bit
-// IINT16(16bit)	з16bit
-// IUINT16(16bit)	޷16bit
-// IINT32(32bit)	з32bit
-// IUINT32(32bit)	޷32bit
-// IINT64(64bit)	з64bit
-// IUINT64(64bit)	޷64bit
-// INLINE:			
+// 定义类型
+// IINT8(8bit)：	有符号8bit整形
+// IUINT8(8bit)：	无符号8bit整形
+// IINT16(16bit)：	有符号16bit整形
+// IUINT16(16bit)：	无符号16bit整形
+// IINT32(32bit)：	有符号32bit整形
+// IUINT32(32bit)：	无符号32bit整形
+// IINT64(64bit)：	有符号64bit整形
+// IUINT64(64bit)：	无符号64bit整形
+// INLINE:			定义内联函数宏
 //=====================================================================
 #ifndef __INTEGER_ALL_BITS__
 #define __INTEGER_ALL_BITS__
@@ -0,0 +1,506 @@
+//=====================================================================
+// QSP端到端性能测试
+//=====================================================================
+// 遍历通信模式（half/weak/single）、报文大小（8B ~ 16MB）、丢包率（0 ~ 20%），
+// 分别在模拟网络（虚拟时钟）与本机UDP回环上单向发送报文，结果输出为JSON：
+//	goodput		有效吞吐量（接收到的报文字节数 / 用时）
+//	latency		报文从qsp_send到接收完整的延迟（p50/p99/p999/max，微秒）
+//	ack_rtt		片段发送到收到ACK的时间（发送方各报文大小分类的直方图合并，p50/p99，毫秒）
+//	retrans		重传的报文片段 / 第一次发送的报文片段
+//	packets		每个报文的数据包数量（发送方 / 接收方）
+//	cpu_ms		进程CPU时间
+//	rcv_mem		接收方rcv_buf与rcv_queue占用内存的峰值（字节）与结束时的接收窗口
+// -c指定加密算法时两端开启加密（微双工模式不支持加密，跳过）。
+// -M设置两端的MTU，-P开启路径MTU探测（上限），模拟网络的路径MTU为BENCH_PATH_MTU。
+// -p指定两端的预设参数（qsp_setprofile），-p all对比各预设在延迟、吞吐量、重传比例与CPU时间上的取舍。
+// -d限制接收方读取的速度（慢速消费者，字节/秒），-a开启接收方的自动接收窗口：发送方持续发送，
+// 接收方的内存峰值应当受接收窗口限制而不随发送量增长，例如：qsp_bench -t sim -m half -s 4096 -l 0 -d 0 -d 200000 -a
+// 报文片段数超过接收窗口时各模式都应当完整接收（单工模式不重传，接收方不能按窗口丢弃片段），
+// 例如256KB报文（192个片段，默认接收窗口128）：qsp_bench -t sim -m all -s 262144 -l 0
+// 丢包率为0时没有完整接收全部报文的测试记为失败，结束时返回非0。
+//
+// 编译：
+//	gcc -O2 -c QSP/qsp.c QSP/log.c QSP/network.c QSP/systime.c QSP/histogram.c QSP/trace.c QSP/capture.c QSP/cookie.c QSP/aead.c QSP/compress.c
+//	g++ -O2 -std=c++11 -IQSP bench/qsp_bench.cpp QSP/simulator.cpp *.o -o qsp_bench -lpthread
+// 用法：
+//	qsp_bench [-t sim|udp|all] [-m half|weak|single|all] [-s size] [-l loss]
+//	          [-c none|chacha|aes] [-M mtu] [-P maxmtu] [-p default|lowlat|balanced|bulk|all]
+//	          [-d rate] [-a] [-n count] [-S seed] [-q] [-o file]
+//=====================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "qsp.h"
+#include "log.h"
+#include "systime.h"
+#include "simulator.h"
+
+#define BENCH_TOTAL (4 << 20)		// 每组测试发送的总字节数（报文数量 = 总字节数 / 报文大小）
+#define BENCH_COUNT_MAX 2000		// 每组测试最多发送的报文数量
+#define BENCH_SIM_LIMIT 600000		// 模拟网络：每组测试的时间上限（虚拟时间，毫秒）
+#define BENCH_UDP_LIMIT 30000		// UDP回环：每组测试的时间上限（毫秒）
+#define BENCH_IDLE_LIMIT 2000		// UDP回环：单工模式全部发送之后没有新的报文到达的时间上限（毫秒）
+#define BENCH_SINGLE_RATE 4000000	// 单工模式没有流量控制，按固定的速率发送（字节/秒）
+#define BENCH_PATH_MTU 9000			// 模拟网络：路径MTU（巨型帧），更大的数据包被丢弃
+
+// 测试参数
+struct BenchConfig
+{
+	int sim;				// 1：模拟网络，0：UDP回环
+	int mode;				// 通信模式
+	int size;				// 报文大小
+	int loss;				// 单程丢包率（百分比）
+	int crypto;				// 加密算法（IAEAD_NONE等）
+	int mtu;				// 两端的MTU（0为默认值）
+	int pmtud;				// 路径MTU探测的上限（0为不探测）
+	int profile;			// 预设参数（QSP_PROFILE_DEFAULT等）
+	int drain;				// 接收方读取报文的速度（字节/秒，0为不限制）
+	int autownd;			// 接收方开启自动接收窗口
+	int count;				// 报文数量
+	IUINT32 seed;			// 随机数种子
+};
+
+// 测试结果
+struct BenchResult
+{
+	int skipped;			// 该模式不支持的报文大小
+	int sent, delivered;	// 发送 / 接收完整的报文数量
+	IUINT64 elapsed;		// 用时（微秒）
+	IUINT64 bytes;			// 接收到的报文字节数
+	IUINT64 p50, p99, p999, max;	// 延迟（微秒）
+	IUINT32 rtt_p50, rtt_p99;	// ACK往返时间（毫秒）
+	IUINT64 segs, resent;	// 第一次发送的报文片段 / 重传的报文片段
+	IUINT64 pkts[2];		// 发送方 / 接收方输出的数据包数量
+	IUINT32 mtu;			// 结束时发送方的MTU
+	IUINT64 rcv_peak;		// 接收方rcv_buf与rcv_queue占用内存的峰值（字节）
+	IUINT32 rcv_wnd;		// 结束时接收方的接收窗口
+	double cpu_ms;			// CPU时间
+};
+
+// 端点：qsp回调函数的user参数
+struct Endpoint
+{
+	int id;					// 0：发送方，1：接收方
+	int fd;					// UDP套接字（模拟网络为-1）
+	int loss;				// UDP回环模拟的丢包率（百分比）
+	LatencySimulator *sim;
+	Random *lost;
+	IUINT64 packets;
+};
+
+static int bench_output(const char *buf, int len, QSP *, void *user)
+{
+	Endpoint *ep = (Endpoint*)user;
+
+	ep->packets++;
+	if (ep->sim) {
+		ep->sim->send(ep->id, buf, len);
+		return len;
+	}
+	if (ep->lost->random() < ep->loss)
+		return len;
+	send(ep->fd, buf, len, 0);
+	return len;
+}
+
+static int bench_input(char *buf, int len, QSP *, void *user)
+{
+	Endpoint *ep = (Endpoint*)user;
+	int hr;
+
+	if (ep->sim) {
+		hr = ep->sim->recv(ep->id, buf, len);
+		return hr < 0 ? 0 : hr;
+	}
+	hr = (int)recv(ep->fd, buf, len, MSG_DONTWAIT);
+	return hr < 0 ? 0 : hr;
+}
+
+// 墙上时间（微秒）
+static IUINT64 bench_clock_us()
+{
+	return iclock_us();
+}
+
+// 打开绑定到本机回环地址的UDP套接字
+static int bench_udp_open(struct sockaddr_in *addr)
+{
+	socklen_t addrlen = sizeof(*addr);
+	int bufsize = 4 << 20;
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) return -1;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr->sin_port = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+	setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+#ifdef IP_MTU_DISCOVER
+	// 不分片：超过路径MTU的探测包发送失败，而不是分片后到达
+	int pmtudisc = IP_PMTUDISC_DO;
+	setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtudisc, sizeof(pmtudisc));
+#endif
+	if (bind(fd, (struct sockaddr*)addr, sizeof(*addr)) < 0 || getsockname(fd, (struct sockaddr*)addr, &addrlen) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static const char* bench_mode_name(int mode)
+{
+	switch (mode) {
+	case QSP_MODE_HALF: return "half";
+	case QSP_MODE_WEAK: return "weak";
+	case QSP_MODE_SINGLE: return "single";
+	}
+	return "unknown";
+}
+
+static int bench_run(const BenchConfig &cfg, BenchResult &res)
+{
+	memset(&res, 0, sizeof(res));
+
+	LatencySimulator *sim = NULL;
+	Random lost0(100, cfg.seed), lost1(100, cfg.seed + 1);
+	Endpoint ep[2] = { { 0, -1, cfg.loss, NULL, &lost0, 0 }, { 1, -1, cfg.loss, NULL, &lost1, 0 } };
+	QSP *qsp[2];
+	int i;
+
+	if (cfg.sim) {
+		// 模拟网络：RTT 20ms ~ 40ms，带宽100Mbit/s，队列不限制（单工模式整个报文一次发出）
+		SimLink link = { cfg.loss, 10, 20, 0, 0, 12500000, 0, BENCH_PATH_MTU };
+		sim = new LatencySimulator(0, 20, 40, 0, cfg.seed);
+		sim->setlink(0, link);
+		sim->setlink(1, link);
+		ep[0].sim = ep[1].sim = sim;
+	}
+	else {
+		struct sockaddr_in addr[2];
+		for (i = 0; i < 2; i++) {
+			ep[i].fd = bench_udp_open(&addr[i]);
+			if (ep[i].fd < 0) {
+				write_log("[bench_run : %d] : error, bench_udp_open return < 0", __LINE__);
+				if (i) close(ep[0].fd);
+				return -1;
+			}
+		}
+		connect(ep[0].fd, (struct sockaddr*)&addr[1], sizeof(addr[1]));
+		connect(ep[1].fd, (struct sockaddr*)&addr[0], sizeof(addr[0]));
+	}
+
+	for (i = 0; i < 2; i++) {
+		qsp[i] = qsp_create(0x11223344, &ep[i]);
+		qsp_setinput(qsp[i], bench_input);
+		qsp_setoutput(qsp[i], bench_output);
+		qsp_setsystime(qsp[i], sim ? LatencySimulator::systime : iclock);
+		qsp_setmode(qsp[i], cfg.mode);
+		qsp_setnonblock(qsp[i], 1);
+		qsp_sethist(qsp[i], 1);
+		qsp_setprofile(qsp[i], cfg.profile);
+		if (cfg.mtu > 0)
+			qsp_setmtu(qsp[i], cfg.mtu);
+		if (cfg.pmtud > 0)
+			qsp_setpmtud(qsp[i], cfg.pmtud);
+	}
+	if (cfg.autownd)
+		qsp_setautownd(qsp[1], 1);
+
+	// 微双工模式的报文最多QSP_WEAK_MAX个片段
+	int nseg = (cfg.size + qsp[0]->mss - 1) / qsp[0]->mss;
+	if (cfg.mode == QSP_MODE_WEAK && nseg > QSP_WEAK_MAX) {
+		res.skipped = 1;
+		goto cleanup;
+	}
+
+	// 加密：微双工模式不支持
+	if (cfg.crypto != IAEAD_NONE) {
+		static const unsigned char key[32] = "qsp-bench-crypto-key-0123456789";
+		int keylen = cfg.crypto == IAEAD_AES128_GCM ? 16 : 32;
+		if (qsp_setcrypto(qsp[0], cfg.crypto, key, keylen, 1) < 0 || qsp_setcrypto(qsp[1], cfg.crypto, key, keylen, 0) < 0) {
+			res.skipped = 1;
+			goto cleanup;
+		}
+		nseg = (cfg.size + qsp[0]->mss - 1) / qsp[0]->mss;	// MSS减去了加密开销
+	}
+
+	{
+		std::vector<char> sbuf(cfg.size, 'q'), rbuf(cfg.size);
+		std::vector<IUINT64> sent_ts(cfg.count);
+		IHISTOGRAM latency, rtt;
+		std::vector<char> seen(cfg.count, 0);
+		IUINT64 t0 = sim ? sim->clock_us() : bench_clock_us();
+		IUINT64 now = t0, progress = t0;
+		IUINT64 limit = (IUINT64)(sim ? BENCH_SIM_LIMIT : BENCH_UDP_LIMIT) * 1000;
+		clock_t cpu = clock();
+
+		ihist_init(&latency);
+
+		while (res.delivered < cfg.count) {
+			// 发送：每轮最多一个发送窗口的报文片段，可靠模式下待发送队列不超过一个发送窗口，单工模式按固定速率
+			int budget = (int)qsp[0]->snd_wnd;
+			while (res.sent < cfg.count && budget > 0 &&
+				(cfg.mode == QSP_MODE_SINGLE ? (IUINT64)res.sent * cfg.size <= (now - t0) * BENCH_SINGLE_RATE / 1000000
+				: qsp[0]->nsnd_que < qsp[0]->snd_wnd)) {
+				memcpy(&sbuf[0], &res.sent, sizeof(int));
+				sent_ts[res.sent] = now;
+				if (qsp_send(qsp[0], &sbuf[0], cfg.size) < 0)
+					break;
+				res.sent++;
+				budget -= nseg;
+			}
+
+			qsp_update(qsp[0]);
+			qsp_update(qsp[1]);
+
+			// 慢速消费者：已经读取的字节数不超过按读取速度计算的额度
+			QSPMEM mem;
+			qsp_memusage(qsp[1], &mem);
+			res.rcv_peak = std::max(res.rcv_peak, mem.bytes[QSP_MEM_RCV_BUF] + mem.bytes[QSP_MEM_RCV_QUEUE]);
+
+			int hr;
+			while ((cfg.drain == 0 || res.bytes < (IUINT64)cfg.drain * (now - t0) / 1000000)
+				&& (hr = qsp_recv(qsp[1], &rbuf[0], cfg.size)) > 0) {
+				int index;
+				memcpy(&index, &rbuf[0], sizeof(int));
+				now = sim ? sim->clock_us() : bench_clock_us();
+				if (index >= 0 && index < cfg.count && seen[index] == 0) {
+					seen[index] = 1;
+					ihist_record(&latency, (IUINT32)std::min<IUINT64>(now - sent_ts[index], 0xffffffff));
+					res.delivered++;
+					res.bytes += hr;
+				}
+				progress = now;
+			}
+
+			if (sim) sim->advance(1);
+			now = sim ? sim->clock_us() : bench_clock_us();
+
+			// 单工模式丢失的报文不会重传：模拟网络中没有数据包 / UDP回环一段时间没有新的报文时结束
+			if (cfg.mode == QSP_MODE_SINGLE && res.sent == cfg.count) {
+				if (sim ? sim->pending(1) == 0 : now - std::max(progress, sent_ts[cfg.count - 1]) > (IUINT64)BENCH_IDLE_LIMIT * 1000)
+					break;
+			}
+			if (now - t0 > limit)
+				break;
+		}
+
+		res.elapsed = (progress > t0 ? progress : now) - t0;
+		res.cpu_ms = (double)(clock() - cpu) * 1000 / CLOCKS_PER_SEC;
+
+		res.p50 = ihist_percentile(&latency, 50);
+		res.p99 = ihist_percentile(&latency, 99);
+		res.p999 = ihist_percentile(&latency, 99.9);
+		res.max = latency.max;
+
+		ihist_init(&rtt);
+		for (i = 0; i < QSP_SIZE_CLASS_NUM; i++)
+			ihist_merge(&rtt, qsp_hist(qsp[0], QSP_HIST_ACK_RTT, i));
+		res.rtt_p50 = ihist_percentile(&rtt, 50);
+		res.rtt_p99 = ihist_percentile(&rtt, 99);
+
+		for (i = 0; i < QSP_LANE_NUM; i++) {
+			QSPQUEUESTAT stat;
+			qsp_queuestat(qsp[0], (IUINT16)i, &stat);
+			res.segs += stat.sent;
+			res.resent += stat.resent;
+		}
+		res.pkts[0] = ep[0].packets;
+		res.pkts[1] = ep[1].packets;
+		res.mtu = qsp[0]->mtu;
+		res.rcv_wnd = qsp[1]->rcv_wnd;
+	}
+
+cleanup:
+	qsp_release(qsp[0]);
+	qsp_release(qsp[1]);
+	for (i = 0; i < 2; i++)
+		if (ep[i].fd >= 0) close(ep[i].fd);
+	delete sim;
+	return 0;
+}
+
+static const char* bench_crypto_name(int crypto)
+{
+	switch (crypto) {
+	case IAEAD_CHACHA20_POLY1305: return "chacha20-poly1305";
+	case IAEAD_AES128_GCM: return "aes128-gcm";
+	}
+	return "none";
+}
+
+static void bench_print(FILE *fp, const BenchConfig &cfg, const BenchResult &res, int first)
+{
+	double sec = res.elapsed / 1000000.0;
+	double msgs = res.delivered ? (double)res.delivered : 1.0;
+
+	fprintf(fp, "%s\n\t\t{\"transport\": \"%s\", \"mode\": \"%s\", \"crypto\": \"%s\", \"size\": %d, \"loss\": %d, \"count\": %d, \"pmtud\": %d, \"profile\": \"%s\", \"drain_bps\": %d, \"auto_wnd\": %s",
+		first ? "" : ",", cfg.sim ? "sim" : "udp", bench_mode_name(cfg.mode), bench_crypto_name(cfg.crypto), cfg.size, cfg.loss, cfg.count, cfg.pmtud,
+		qsp_profile_name(cfg.profile), cfg.drain, cfg.autownd ? "true" : "false");
+	if (res.skipped) {
+		fprintf(fp, ", \"skipped\": true}");
+		return;
+	}
+	fprintf(fp, ", \"sent\": %d, \"delivered\": %d, \"elapsed_ms\": %.3f, \"goodput_mbps\": %.3f",
+		res.sent, res.delivered, res.elapsed / 1000.0, sec > 0 ? res.bytes * 8 / sec / 1000000 : 0.0);
+	fprintf(fp, ", \"latency_us\": {\"p50\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+		(unsigned long long)res.p50, (unsigned long long)res.p99, (unsigned long long)res.p999, (unsigned long long)res.max);
+	fprintf(fp, ", \"ack_rtt_ms\": {\"p50\": %u, \"p99\": %u}", res.rtt_p50, res.rtt_p99);
+	fprintf(fp, ", \"mtu\": %u", res.mtu);
+	fprintf(fp, ", \"rcv_mem\": {\"peak\": %llu, \"wnd\": %u}", (unsigned long long)res.rcv_peak, res.rcv_wnd);
+	fprintf(fp, ", \"retrans_ratio\": %.4f, \"packets_per_msg\": %.2f, \"acks_per_msg\": %.2f, \"cpu_ms\": %.1f}",
+		res.segs ? (double)res.resent / res.segs : 0.0, res.pkts[0] / msgs, res.pkts[1] / msgs, res.cpu_ms);
+}
+
+static void bench_nolog(const char *)
+{
+}
+
+static void bench_usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t sim|udp|all] [-m half|weak|single|all] [-s size] [-l loss] [-c none|chacha|aes] [-M mtu] [-P maxmtu] [-p default|lowlat|balanced|bulk|all] [-d rate] [-a] [-n count] [-S seed] [-q] [-o file]\n", name);
+	fprintf(stderr, "  -q  quick sweep (8B/4KB/256KB, loss 0/5%%)\n");
+	fprintf(stderr, "  -d  receiver drain rate in bytes/s (slow consumer, 0 = unlimited), -a  receiver auto window\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const int all_sizes[] = { 8, 64, 512, 4096, 32768, 262144, 2097152, 16777216 };
+	static const int quick_sizes[] = { 8, 4096, 262144 };
+	static const int all_losses[] = { 0, 1, 5, 10, 20 };
+	static const int quick_losses[] = { 0, 5 };
+	static const int all_modes[] = { QSP_MODE_HALF, QSP_MODE_WEAK, QSP_MODE_SINGLE };
+
+	std::vector<int> transports, modes, sizes, losses, profiles, drains;
+	const char *output = "qsp_bench.json";
+	IUINT32 seed = 1;
+	int count = 0, quick = 0, crypto = IAEAD_NONE, mtu = 0, pmtud = 0, autownd = 0, opt, i;
+
+	while ((opt = getopt(argc, argv, "t:m:s:l:c:M:P:p:d:an:S:qo:h")) != -1) {
+		switch (opt) {
+		case 't':
+			if (strcmp(optarg, "sim") == 0 || strcmp(optarg, "all") == 0) transports.push_back(1);
+			if (strcmp(optarg, "udp") == 0 || strcmp(optarg, "all") == 0) transports.push_back(0);
+			break;
+		case 'm':
+			if (strcmp(optarg, "half") == 0) modes.push_back(QSP_MODE_HALF);
+			else if (strcmp(optarg, "weak") == 0) modes.push_back(QSP_MODE_WEAK);
+			else if (strcmp(optarg, "single") == 0) modes.push_back(QSP_MODE_SINGLE);
+			else modes.assign(all_modes, all_modes + 3);
+			break;
+		case 's': sizes.push_back(std::max(8, atoi(optarg))); break;
+		case 'l': losses.push_back(std::min(100, std::max(0, atoi(optarg)))); break;
+		case 'c':
+			if (strcmp(optarg, "chacha") == 0) crypto = IAEAD_CHACHA20_POLY1305;
+			else if (strcmp(optarg, "aes") == 0) crypto = IAEAD_AES128_GCM;
+			else crypto = IAEAD_NONE;
+			break;
+		case 'M': mtu = atoi(optarg); break;
+		case 'P': pmtud = atoi(optarg); break;
+		case 'p':
+			for (i = 0; i < QSP_PROFILE_NUM; i++)
+				if (strcmp(optarg, qsp_profile_name(i)) == 0 || strcmp(optarg, "all") == 0)
+					profiles.push_back(i);
+			break;
+		case 'd': drains.push_back(std::max(0, atoi(optarg))); break;
+		case 'a': autownd = 1; break;
+		case 'n': count = atoi(optarg); break;
+		case 'S': seed = (IUINT32)strtoul(optarg, NULL, 0); break;
+		case 'q': quick = 1; break;
+		case 'o': output = optarg; break;
+		default:
+			bench_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (transports.empty()) { transports.push_back(1); transports.push_back(0); }
+	if (modes.empty()) modes.assign(all_modes, all_modes + 3);
+	if (profiles.empty()) profiles.push_back(QSP_PROFILE_DEFAULT);
+	if (drains.empty()) drains.push_back(0);
+	if (sizes.empty()) {
+		if (quick) sizes.assign(quick_sizes, quick_sizes + 3);
+		else sizes.assign(all_sizes, all_sizes + 8);
+	}
+	if (losses.empty()) {
+		if (quick) losses.assign(quick_losses, quick_losses + 2);
+		else losses.assign(all_losses, all_losses + 5);
+	}
+
+	FILE *fp = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot open %s\n", output);
+		return EXIT_FAILURE;
+	}
+
+	// 协议内部的错误日志不计入测试
+	set_outlog(bench_nolog);
+
+	fprintf(fp, "{\n\t\"version\": %d,\n\t\"seed\": %u,\n\t\"results\": [", QSP_VERSION, seed);
+
+	int first = 1, failed = 0;
+	for (size_t t = 0; t < transports.size(); t++)
+	for (size_t p = 0; p < profiles.size(); p++)
+	for (size_t m = 0; m < modes.size(); m++)
+	for (size_t s = 0; s < sizes.size(); s++)
+	for (size_t l = 0; l < losses.size(); l++)
+	for (size_t d = 0; d < drains.size(); d++) {
+		BenchConfig cfg;
+		BenchResult res;
+		cfg.sim = transports[t];
+		cfg.mode = modes[m];
+		cfg.size = sizes[s];
+		cfg.loss = losses[l];
+		cfg.crypto = crypto;
+		cfg.mtu = mtu;
+		cfg.pmtud = pmtud;
+		cfg.profile = profiles[p];
+		cfg.drain = drains[d];
+		cfg.autownd = autownd;
+		cfg.count = count > 0 ? count : std::min(BENCH_COUNT_MAX, std::max(1, BENCH_TOTAL / cfg.size));
+		cfg.seed = seed;
+
+		if (bench_run(cfg, res) < 0)
+			continue;
+
+		bench_print(fp, cfg, res, first);
+		fflush(fp);
+		first = 0;
+
+		fprintf(stderr, "%s %-8s %-6s size=%-8d loss=%-2d%% ", cfg.sim ? "sim" : "udp", qsp_profile_name(cfg.profile), bench_mode_name(cfg.mode), cfg.size, cfg.loss);
+		if (cfg.drain > 0)
+			fprintf(stderr, "drain=%d%s ", cfg.drain, cfg.autownd ? "/auto" : "");
+		if (res.skipped) {
+			fprintf(stderr, "skipped\n");
+			continue;
+		}
+		fprintf(stderr, "delivered=%d/%d p50=%lluus rcv_mem=%llu", res.delivered, res.sent, (unsigned long long)res.p50, (unsigned long long)res.rcv_peak);
+
+		// 没有丢包时所有模式都应当完整接收全部报文
+		if (cfg.loss == 0 && res.delivered < res.sent) {
+			fprintf(stderr, " FAILED");
+			failed++;
+		}
+		fprintf(stderr, "\n");
+	}
+
+	fprintf(fp, "\n\t]\n}\n");
+	if (fp != stdout) fclose(fp);
+
+	if (failed > 0) {
+		fprintf(stderr, "%d test(s) failed: not all messages delivered without loss\n", failed);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+//=====================================================================
+// 协程接口的并发请求测试
+//=====================================================================
+// 一个线程上的qsp::EventLoop驱动flows个请求流：每个流是一对会话（客户端 /
+// 服务端，通过内存中的数据包队列相连），客户端协程依次发送requests个
+// 请求（co_await send）并等待回应（co_await recv），服务端协程原样返回。
+// 没有线程与回调函数，协程只占用协程帧。输出（JSON，-o -输出到stdout）：
+//	rps			每秒完成的请求数
+//	latency		请求的往返时间（p50/p99，微秒）
+//	cpu_ms		进程CPU时间
+//	mem_per_flow	每个流的会话占用的协议内存（字节，QSPMEM峰值 / 流数）
+//
+// 编译：
+//	gcc -O2 -c QSP/qsp.c QSP/log.c QSP/network.c QSP/systime.c QSP/histogram.c QSP/trace.c QSP/capture.c QSP/cookie.c QSP/aead.c QSP/compress.c
+//	g++ -O2 -std=c++20 -IQSP bench/qsp_coro.cpp *.o -o qsp_coro -lpthread
+// 用法：
+//	qsp_coro [-f flows] [-r requests] [-s size] [-a] [-o file]
+//	  -a  send等待报文被确认（默认进入发送窗口即恢复）
+//=====================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "qsp_coro.hpp"
+#include "log.h"
+
+#define CORO_FLOWS 1000				// 默认的请求流数量
+#define CORO_REQUESTS 100			// 默认每个流的请求数
+#define CORO_PIPE (16 << 10)		// 每个方向的数据包队列容量（字节）
+
+// 单向的数据包队列（环形，每个数据包前面是4字节长度），满了丢弃
+struct Pipe
+{
+	std::vector<char> ring;
+	size_t head, tail;
+
+	Pipe() : ring(CORO_PIPE), head(0), tail(0) {}
+
+	void copy_in(const char *buf, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			ring[(tail + i) % CORO_PIPE] = buf[i];
+		tail += size;
+	}
+
+	void copy_out(char *buf, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			buf[i] = ring[(head + i) % CORO_PIPE];
+		head += size;
+	}
+
+	int push(const char *buf, int size)
+	{
+		int len = size;
+		if (tail - head + sizeof(len) + size > CORO_PIPE)
+			return size;
+		copy_in((const char*)&len, sizeof(len));
+		copy_in(buf, size);
+		return size;
+	}
+
+	int pop(char *buf, int size)
+	{
+		int len;
+		if (head == tail)
+			return 0;
+		copy_out((char*)&len, sizeof(len));
+		if (len > size) {
+			head += len;	// 缓冲区不够：丢弃
+			return 0;
+		}
+		copy_out(buf, len);
+		return len;
+	}
+};
+
+struct PipeTransport
+{
+	Pipe *rx, *tx;
+
+	PipeTransport(Pipe *r = NULL, Pipe *t = NULL) : rx(r), tx(t) {}
+	int recv(char *buf, int len) { return rx->pop(buf, len); }
+	int send(const char *buf, int len) { return tx->push(buf, len); }
+};
+
+typedef qsp::EventLoop<qsp::SystemClock> Loop;
+typedef qsp::CoSession<PipeTransport, qsp::SystemClock> CoPipe;
+
+// 一个请求流：两个方向的队列与两端的会话
+struct Flow
+{
+	Pipe up, down;
+	CoPipe client, server;
+
+	Flow(Loop &loop, IUINT32 conv) :
+		client(loop, conv, PipeTransport(&down, &up)), server(loop, conv, PipeTransport(&up, &down)) {}
+};
+
+struct CoroStat
+{
+	IHISTOGRAM latency;
+	long done, failed;
+};
+
+static qsp::Task<> coro_server(CoPipe &s, int requests, int size)
+{
+	std::vector<char> buf(size);
+
+	for (int i = 0; i < requests; i++) {
+		int n = co_await s.recv(buf);
+		if (n < 0)
+			co_return;
+		if (co_await s.send(qsp::span<const char>(buf.data(), n)) < 0)
+			co_return;
+	}
+}
+
+static qsp::Task<> coro_client(CoPipe &s, int requests, int size, qsp::SendWait wait, CoroStat &stat)
+{
+	std::vector<char> req(size, 'q'), buf(size);
+
+	for (int i = 0; i < requests; i++) {
+		IUINT64 t0 = iclock_us();
+		memcpy(req.data(), &i, sizeof(i));
+		if (co_await s.send(req, wait) < 0) {
+			stat.failed++;
+			co_return;
+		}
+		int n = co_await s.recv(buf);
+		if (n != size || memcmp(buf.data(), &i, sizeof(i)) != 0) {
+			stat.failed++;
+			co_return;
+		}
+		ihist_record(&stat.latency, (IUINT32)(iclock_us() - t0));
+		stat.done++;
+	}
+}
+
+static void coro_nolog(const char *)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output = "qsp_coro.json";
+	int flows = CORO_FLOWS, requests = CORO_REQUESTS, size = 64, opt;
+	qsp::SendWait wait = qsp::accepted;
+
+	while ((opt = getopt(argc, argv, "f:r:s:ao:h")) != -1) {
+		switch (opt) {
+		case 'f': flows = std::max(1, atoi(optarg)); break;
+		case 'r': requests = std::max(1, atoi(optarg)); break;
+		case 's': size = std::max((int)sizeof(int), atoi(optarg)); break;
+		case 'a': wait = qsp::acked; break;
+		case 'o': output = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-f flows] [-r requests] [-s size] [-a] [-o file]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	FILE *fp = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot open %s\n", output);
+		return EXIT_FAILURE;
+	}
+
+	set_outlog(coro_nolog);
+
+	Loop loop;
+	CoroStat stat;
+	std::vector<std::unique_ptr<Flow> > list;
+	IUINT64 peak = 0;
+	long polls = 0;
+	int i;
+
+	ihist_init(&stat.latency);
+	stat.done = stat.failed = 0;
+
+	for (i = 0; i < flows; i++) {
+		list.emplace_back(new Flow(loop, (IUINT32)i + 1));
+		loop.spawn(coro_server(list[i]->server, requests, size));
+		loop.spawn(coro_client(list[i]->client, requests, size, wait, stat));
+	}
+
+	IUINT64 t0 = iclock_us();
+	clock_t cpu = clock();
+	while (loop.tasks() > 0) {
+		if (loop.poll() == 0)
+			isleep(1);
+		polls++;
+
+		QSPMEM mem;
+		qsp_memusage(NULL, &mem);
+		peak = std::max(peak, mem.total);
+	}
+	double sec = (iclock_us() - t0) / 1000000.0;
+	double cpu_ms = (double)(clock() - cpu) * 1000 / CLOCKS_PER_SEC;
+
+	fprintf(fp, "{\n\t\"version\": %d,\n\t\"flows\": %d, \"requests\": %d, \"size\": %d, \"wait\": \"%s\",\n", QSP_VERSION,
+		flows, requests, size, wait == qsp::acked ? "acked" : "accepted");
+	fprintf(fp, "\t\"done\": %ld, \"failed\": %ld, \"elapsed_ms\": %.1f, \"rps\": %.0f, \"polls\": %ld,\n",
+		stat.done, stat.failed, sec * 1000, sec > 0 ? stat.done / sec : 0.0, polls);
+	fprintf(fp, "\t\"latency_us\": {\"p50\": %u, \"p99\": %u, \"max\": %u}, \"cpu_ms\": %.1f, \"mem_per_flow\": %llu\n}\n",
+		(unsigned)ihist_percentile(&stat.latency, 50), (unsigned)ihist_percentile(&stat.latency, 99), (unsigned)stat.latency.max,
+		cpu_ms, (unsigned long long)(peak / flows));
+	if (fp != stdout) fclose(fp);
+
+	fprintf(stderr, "flows=%d requests=%d done=%ld failed=%ld %.0f req/s p50=%uus p99=%uus\n", flows, requests, stat.done, stat.failed,
+		sec > 0 ? stat.done / sec : 0.0, (unsigned)ihist_percentile(&stat.latency, 50), (unsigned)ihist_percentile(&stat.latency, 99));
+
+	return stat.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
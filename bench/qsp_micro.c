@@ -0,0 +1,445 @@
+//=====================================================================
+// QSP内部函数的微基准测试
+//=====================================================================
+// 直接包含qsp.c，测试协议热路径上的静态函数：
+//	encode / decode		报文头部编码 / 解码
+//	parse_data			解析数据报文（rcv_buf中已有depth个乱序片段，插入重复的中间片段）
+//	parse_ack			解析ACK（snd_buf中有depth个待确认片段，确认最后一个，再补回一个节点）
+//	recv				qsp_peeksize + qsp_recv拼接frags个片段的报文
+//	segment				qsp_segment_new + qsp_segment_delete
+//	trace				写入一条跟踪记录（跟踪开启时每个跟踪点的开销）
+//	admit				服务端准入检查（带有效cookie的HELLO，一次哈希计算）
+//	seal / open			加密 / 解密一个满MSS的数据包（depth：1 ChaCha20-Poly1305，2 AES-128-GCM），
+//						seal_c为ChaCha20-Poly1305的可移植实现
+// 每项输出ns/op、每个操作的内存分配次数、每字节的CPU周期数（JSON，-o -输出到stdout），
+// warm：连续执行（数据在缓存中），cold：每次执行前冲刷缓存。
+//
+// 编译：
+//	gcc -O2 -IQSP bench/qsp_micro.c QSP/log.c QSP/network.c QSP/systime.c QSP/histogram.c QSP/trace.c QSP/capture.c QSP/cookie.c QSP/aead.c QSP/compress.c -o qsp_micro -lpthread
+// 用法：
+//	qsp_micro [-n iterations] [-o file]
+//=====================================================================
+#include "qsp.c"
+#include "systime.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define micro_cycles() ((IUINT64)__rdtsc())
+#else
+#define micro_cycles() ((IUINT64)0)
+#endif
+
+#define MICRO_ITERATIONS 200000		// warm：每项测试的执行次数
+#define MICRO_COLD 500				// cold：每项测试的执行次数
+#define MICRO_FLUSH (32 << 20)		// 冲刷缓存时写入的字节数（大于末级缓存）
+
+// 测试上下文
+typedef struct MICROCTX
+{
+	QSP *qsp;
+	int depth;						// 队列深度 / 报文的片段数
+	IUINT32 msn;					// 下一个报文序号
+	QSPNODE *node;					// 编码的节点
+	QSPSEG seg;						// 解码的报文头部
+	char buf[QSP_BUF_SIZE];
+	char *msg;						// 拼接报文的缓冲区
+} MICROCTX;
+
+// 测试用例
+typedef struct MICROCASE
+{
+	const char *name;
+	int depth;
+	void(*setup)(MICROCTX *ctx);	// 测试开始前（不计时）
+	void(*prepare)(MICROCTX *ctx);	// 每次执行前（不计时，可以为NULL）
+	void(*op)(MICROCTX *ctx);		// 被测试的操作
+	int(*bytes)(const MICROCTX *ctx);	// 每次操作处理的字节数
+} MICROCASE;
+
+static IUINT64 micro_allocs = 0;
+static char *micro_flush_buf = NULL;
+
+static void* micro_malloc(size_t size)
+{
+	micro_allocs++;
+	return malloc(size);
+}
+
+static IUINT64 micro_clock_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (IUINT64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// 冲刷缓存：写一块大于末级缓存的内存
+static void micro_flush(void)
+{
+	size_t i;
+	for (i = 0; i < MICRO_FLUSH; i += 64)
+		micro_flush_buf[i]++;
+}
+
+static int micro_input(char *buf, int len, QSP *qsp, void *user)
+{
+	return 0;
+}
+
+static int micro_output(const char *buf, int len, QSP *qsp, void *user)
+{
+	return len;
+}
+
+// 创建一个片段（0号逻辑流，半双工）
+static QSPNODE* micro_node(const QSP *qsp, IUINT32 msn, IUINT32 sn, IUINT32 frg)
+{
+	QSPNODE *qnode = qsp_segment_new(qsp->mss);
+	qnode->seg.conv = qsp->conv;
+	qnode->seg.cmd = QSP_CMD_PUSH;
+	qnode->seg.mode = QSP_MODE_HALF;
+	qnode->seg.ver = QSP_VERSION;
+	qnode->seg.len = (IUINT16)qsp->mss;
+	qnode->seg.msn = msn;
+	qnode->seg.sn = sn;
+	qnode->seg.frg = frg;
+	return qnode;
+}
+
+static int micro_bytes_head(const MICROCTX *ctx) { return QSP_HEAD_SIZE; }
+static int micro_bytes_seg(const MICROCTX *ctx) { return (int)ctx->qsp->mss; }
+static int micro_bytes_msg(const MICROCTX *ctx) { return (int)ctx->qsp->mss * ctx->depth; }
+
+// 编码 / 解码
+static void micro_setup_codec(MICROCTX *ctx)
+{
+	ctx->node = micro_node(ctx->qsp, 1, 3, 2);
+	qsp_encode_seg(ctx->buf, ctx->node);
+}
+
+static void micro_op_encode(MICROCTX *ctx)
+{
+	qsp_encode_seg(ctx->buf, ctx->node);
+}
+
+static void micro_op_decode(MICROCTX *ctx)
+{
+	qsp_decode_seg(ctx->buf, &ctx->seg);
+}
+
+// 解析数据：rcv_buf中有depth个片段（报文的第一个片段没有到达），插入重复的中间片段
+static void micro_setup_data(MICROCTX *ctx)
+{
+	IUINT32 sn = ctx->depth + 2, frg;
+	for (frg = 1; frg <= (IUINT32)ctx->depth; frg++)
+		qsp_parse_data(ctx->qsp, micro_node(ctx->qsp, 0, sn, frg));
+}
+
+static void micro_op_data(MICROCTX *ctx)
+{
+	QSPLANE *lane = &ctx->qsp->lane[0];
+
+	if (ctx->depth > 0)
+	{
+		qsp_parse_data(ctx->qsp, micro_node(ctx->qsp, 0, ctx->depth + 2, ctx->depth / 2 + 1));
+		return;
+	}
+
+	// 深度为0：有序的单片段报文，移动到rcv_queue后直接删除
+	qsp_parse_data(ctx->qsp, micro_node(ctx->qsp, ctx->msn++, 1, 0));
+	while (!iqueue_is_empty(&lane->rcv_queue))
+	{
+		QSPNODE *qnode = iqueue_entry(lane->rcv_queue.next, QSPNODE, node);
+		iqueue_del(&qnode->node);
+		qsp_mem_dec(ctx->qsp, QSP_MEM_RCV_QUEUE, qnode);
+		qsp_segment_delete(qnode);
+		lane->nrcv_que--;
+		ctx->qsp->nrcv_que--;
+	}
+}
+
+// 解析ACK：snd_buf中有depth个片段，确认最后一个，再补回一个节点保持深度
+static void micro_snd_add(MICROCTX *ctx, IUINT32 frg)
+{
+	QSPNODE *qnode = micro_node(ctx->qsp, 0, QSP_STREAM_SN, frg);
+	iqueue_add_tail(&qnode->node, &ctx->qsp->snd_buf);
+	qsp_mem_inc(ctx->qsp, QSP_MEM_SND_BUF, qnode);
+	ctx->qsp->lane[0].nsnd_buf++;
+	ctx->qsp->nsnd_buf++;
+}
+
+static void micro_setup_ack(MICROCTX *ctx)
+{
+	IUINT32 frg;
+	for (frg = 0; frg < (IUINT32)ctx->depth; frg++)
+		micro_snd_add(ctx, frg);
+	ctx->msn = ctx->depth;
+}
+
+static void micro_op_ack(MICROCTX *ctx)
+{
+	QSPNODE *last = iqueue_entry(ctx->qsp->snd_buf.prev, QSPNODE, node);
+	qsp_parse_ack(ctx->qsp, 0, 0, last->seg.frg, 0xffffffff);
+	micro_snd_add(ctx, ctx->msn++);
+}
+
+// 报文拼接：rcv_queue中准备好depth个片段的报文，计时qsp_peeksize + qsp_recv
+static void micro_setup_recv(MICROCTX *ctx)
+{
+	ctx->msg = (char*)malloc(ctx->qsp->mss * ctx->depth);
+	qsp_setnonblock(ctx->qsp, 1);
+}
+
+static void micro_prepare_recv(MICROCTX *ctx)
+{
+	IUINT32 frg;
+	for (frg = ctx->depth; frg > 0; frg--)
+		qsp_parse_data(ctx->qsp, micro_node(ctx->qsp, ctx->msn, ctx->depth, frg - 1));
+	ctx->msn++;
+}
+
+static void micro_op_recv(MICROCTX *ctx)
+{
+	int size = qsp_peeksize(ctx->qsp);
+	if (qsp_recv(ctx->qsp, ctx->msg, size) != size)
+		write_log("[micro_op_recv : %d] : error, qsp_recv return length error", __LINE__);
+}
+
+// 分配 / 释放报文节点
+static void micro_setup_none(MICROCTX *ctx)
+{
+}
+
+static void micro_op_segment(MICROCTX *ctx)
+{
+	qsp_segment_delete(qsp_segment_new(ctx->qsp->mss));
+}
+
+// 写入跟踪记录
+static void micro_op_trace(MICROCTX *ctx)
+{
+	itrace_write(ITRACE_SEND, ctx->qsp->conv, 0, ctx->msn++, 0, ctx->qsp->mss);
+}
+
+// 准入检查：带有效cookie的HELLO
+static ICOOKIE micro_cookie;
+static const char micro_addr[] = "10.0.0.2:40002";
+
+static void micro_setup_admit(MICROCTX *ctx)
+{
+	QSPNODE *qnode = micro_node(ctx->qsp, 0, 1, 0);
+
+	icookie_init(&micro_cookie, NULL, 0);
+	qnode->seg.cmd = QSP_CMD_HELLO;
+	qnode->seg.len = ICOOKIE_SIZE;
+	icookie_make(&micro_cookie, qnode->seg.conv, micro_addr, sizeof(micro_addr), 0, qsp_encode_seg(ctx->buf, qnode));
+	qsp_segment_delete(qnode);
+}
+
+static void micro_op_admit(MICROCTX *ctx)
+{
+	char reply[QSP_HEAD_SIZE + ICOOKIE_SIZE];
+	IUINT32 conv;
+	int len;
+
+	if (qsp_admit(&micro_cookie, ctx->buf, QSP_HEAD_SIZE + ICOOKIE_SIZE, micro_addr, sizeof(micro_addr), 0,
+		&conv, reply, &len) != QSP_ADMIT_OK)
+		write_log("[micro_op_admit : %d] : error, qsp_admit return error", __LINE__);
+}
+
+// 加密 / 解密：满MSS的数据包（加密后为QSP_MTU_SIZE字节）
+static const unsigned char micro_key[32] = "qsp-micro-benchmark-key-0123456";
+
+static void micro_setup_seal(MICROCTX *ctx)
+{
+	QSPNODE *qnode;
+
+	if (qsp_setcrypto(ctx->qsp, ctx->depth, micro_key, ctx->depth == IAEAD_AES128_GCM ? 16 : 32, 1) < 0)
+	{
+		write_log("[micro_setup_seal : %d] : error, qsp_setcrypto return error", __LINE__);
+		exit(1);
+	}
+
+	qnode = micro_node(ctx->qsp, 0, 1, 0);
+	memset(qnode->seg.data, 0x5a, qnode->seg.len);
+	memcpy(qsp_encode_seg(ctx->buf, qnode), qnode->seg.data, qnode->seg.len);
+	qsp_segment_delete(qnode);
+}
+
+static void micro_setup_seal_c(MICROCTX *ctx)
+{
+	micro_setup_seal(ctx);
+	iaead_init(ctx->qsp->aead, IAEAD_CHACHA20_POLY1305, micro_key, 32, 0);
+}
+
+static void micro_op_seal(MICROCTX *ctx)
+{
+	qsp_seal(ctx->qsp, ctx->buf, QSP_HEAD_SIZE + ctx->qsp->mss);
+}
+
+// 解密：对端（响应方）加密的数据包，每次执行前恢复密文并清空防重放窗口
+static void micro_setup_open(MICROCTX *ctx)
+{
+	micro_setup_seal(ctx);
+	ctx->qsp->aead_role = 0;
+	qsp_seal(ctx->qsp, ctx->buf, QSP_HEAD_SIZE + ctx->qsp->mss);
+	ctx->qsp->aead_role = 1;
+	ctx->msg = (char*)malloc(QSP_MTU_SIZE);
+	memcpy(ctx->msg, ctx->buf, QSP_MTU_SIZE);
+}
+
+static void micro_prepare_open(MICROCTX *ctx)
+{
+	memcpy(ctx->buf, ctx->msg, QSP_MTU_SIZE);
+	ctx->qsp->aead_rcv = 0;
+	ctx->qsp->aead_win = 0;
+}
+
+static void micro_op_open(MICROCTX *ctx)
+{
+	if (qsp_open(ctx->qsp, ctx->buf, QSP_MTU_SIZE) < 0)
+		write_log("[micro_op_open : %d] : error, qsp_open return error", __LINE__);
+}
+
+static const MICROCASE micro_cases[] = {
+	{ "encode", 0, micro_setup_codec, NULL, micro_op_encode, micro_bytes_head },
+	{ "decode", 0, micro_setup_codec, NULL, micro_op_decode, micro_bytes_head },
+	{ "parse_data", 0, micro_setup_data, NULL, micro_op_data, micro_bytes_seg },
+	{ "parse_data", 16, micro_setup_data, NULL, micro_op_data, micro_bytes_seg },
+	{ "parse_data", 128, micro_setup_data, NULL, micro_op_data, micro_bytes_seg },
+	{ "parse_data", 1024, micro_setup_data, NULL, micro_op_data, micro_bytes_seg },
+	{ "parse_ack", 1, micro_setup_ack, NULL, micro_op_ack, micro_bytes_head },
+	{ "parse_ack", 32, micro_setup_ack, NULL, micro_op_ack, micro_bytes_head },
+	{ "parse_ack", 256, micro_setup_ack, NULL, micro_op_ack, micro_bytes_head },
+	{ "parse_ack", 1024, micro_setup_ack, NULL, micro_op_ack, micro_bytes_head },
+	{ "recv", 1, micro_setup_recv, micro_prepare_recv, micro_op_recv, micro_bytes_msg },
+	{ "recv", 16, micro_setup_recv, micro_prepare_recv, micro_op_recv, micro_bytes_msg },
+	{ "recv", 128, micro_setup_recv, micro_prepare_recv, micro_op_recv, micro_bytes_msg },
+	{ "segment", 0, micro_setup_none, NULL, micro_op_segment, micro_bytes_seg },
+	{ "trace", 0, micro_setup_none, NULL, micro_op_trace, micro_bytes_head },
+	{ "admit", 0, micro_setup_admit, NULL, micro_op_admit, micro_bytes_head },
+	{ "seal", IAEAD_CHACHA20_POLY1305, micro_setup_seal, NULL, micro_op_seal, micro_bytes_seg },
+	{ "seal_c", IAEAD_CHACHA20_POLY1305, micro_setup_seal_c, NULL, micro_op_seal, micro_bytes_seg },
+	{ "seal", IAEAD_AES128_GCM, micro_setup_seal, NULL, micro_op_seal, micro_bytes_seg },
+	{ "open", IAEAD_CHACHA20_POLY1305, micro_setup_open, micro_prepare_open, micro_op_open, micro_bytes_seg },
+	{ "open", IAEAD_AES128_GCM, micro_setup_open, micro_prepare_open, micro_op_open, micro_bytes_seg },
+};
+
+// 测试结果
+typedef struct MICRORESULT
+{
+	double ns, cycles, allocs;
+} MICRORESULT;
+
+// 执行一项测试（cold：每次执行前冲刷缓存）
+static void micro_run(const MICROCASE *mc, int iterations, int cold, MICRORESULT *res)
+{
+	MICROCTX ctx;
+	IUINT64 ns = 0, cycles = 0, allocs = 0;
+	int i;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.qsp = qsp_create(0x11223344, NULL);
+	ctx.depth = mc->depth;
+	qsp_setinput(ctx.qsp, micro_input);
+	qsp_setoutput(ctx.qsp, micro_output);
+	qsp_setsystime(ctx.qsp, iclock);
+	mc->setup(&ctx);
+
+	if (mc->prepare == NULL && !cold)
+	{
+		// 连续执行，整体计时
+		IUINT64 a = micro_allocs, c = micro_cycles(), t = micro_clock_ns();
+		for (i = 0; i < iterations; i++)
+			mc->op(&ctx);
+		ns = micro_clock_ns() - t;
+		cycles = micro_cycles() - c;
+		allocs = micro_allocs - a;
+	}
+	else
+	{
+		// 每次执行单独计时（准备与冲刷缓存不计时）
+		for (i = 0; i < iterations; i++)
+		{
+			IUINT64 a, c, t;
+			if (mc->prepare) mc->prepare(&ctx);
+			if (cold) micro_flush();
+			a = micro_allocs, c = micro_cycles(), t = micro_clock_ns();
+			mc->op(&ctx);
+			ns += micro_clock_ns() - t;
+			cycles += micro_cycles() - c;
+			allocs += micro_allocs - a;
+		}
+	}
+
+	res->ns = (double)ns / iterations;
+	res->cycles = (double)cycles / iterations / mc->bytes(&ctx);
+	res->allocs = (double)allocs / iterations;
+
+	if (ctx.node) qsp_segment_delete(ctx.node);
+	if (ctx.msg) free(ctx.msg);
+	qsp_release(ctx.qsp);
+}
+
+static void micro_nolog(const char *log)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output = "qsp_micro.json";
+	int iterations = MICRO_ITERATIONS, opt;
+	size_t i;
+	FILE *fp;
+
+	while ((opt = getopt(argc, argv, "n:o:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': iterations = atoi(optarg) > 0 ? atoi(optarg) : MICRO_ITERATIONS; break;
+		case 'o': output = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] [-o file]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fp = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "cannot open %s\n", output);
+		return EXIT_FAILURE;
+	}
+
+	micro_flush_buf = (char*)calloc(1, MICRO_FLUSH);
+	set_allocator(micro_malloc, free);
+	set_outlog(micro_nolog);
+
+	fprintf(fp, "{\n\t\"version\": %d,\n\t\"results\": [", QSP_VERSION);
+	for (i = 0; i < sizeof(micro_cases) / sizeof(micro_cases[0]); i++)
+	{
+		const MICROCASE *mc = &micro_cases[i];
+		MICRORESULT warm, cold;
+
+		micro_run(mc, iterations, 0, &warm);
+		micro_run(mc, MICRO_COLD, 1, &cold);
+
+		fprintf(fp, "%s\n\t\t{\"name\": \"%s\", \"depth\": %d, \"allocs_per_op\": %.2f"
+			", \"warm\": {\"ns_per_op\": %.1f, \"cycles_per_byte\": %.3f}"
+			", \"cold\": {\"ns_per_op\": %.1f, \"cycles_per_byte\": %.3f}}",
+			i ? "," : "", mc->name, mc->depth, warm.allocs, warm.ns, warm.cycles, cold.ns, cold.cycles);
+		fflush(fp);
+
+		fprintf(stderr, "%-10s depth=%-5d allocs/op=%.2f warm %8.1f ns/op %7.3f cyc/B  cold %8.1f ns/op %7.3f cyc/B\n",
+			mc->name, mc->depth, warm.allocs, warm.ns, warm.cycles, cold.ns, cold.cycles);
+	}
+	fprintf(fp, "\n\t]\n}\n");
+
+	if (fp != stdout) fclose(fp);
+	free(micro_flush_buf);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,323 @@
+//=====================================================================
+// qsp::Session（C++封装）与C回调函数的对比测试
+//=====================================================================
+// 两个端点通过内存中的数据包队列相连（没有丢包与延迟，时钟为每轮加1的
+// 计数器），只测量协议与回调的开销：
+//	c		C接口：input / output / systime函数指针，user指向端点
+//	session	qsp::Session<Transport, Clock>：Transport与Clock是模板参数
+// 测试项：
+//	echo	端点0发送一个报文，端点1收到后原样返回，端点0收到后再发送下一个
+//	burst	端点0每轮发送一个窗口的报文，端点1全部接收
+// 每项重复多次取最快的一次，输出每个报文的ns（JSON，-o -输出到stdout）。
+//
+// 编译：
+//	gcc -O2 -c QSP/qsp.c QSP/log.c QSP/network.c QSP/systime.c QSP/histogram.c QSP/trace.c QSP/capture.c QSP/cookie.c QSP/aead.c QSP/compress.c
+//	g++ -O2 -std=c++17 -IQSP bench/qsp_session.cpp *.o -o qsp_session -lpthread
+// 用法：
+//	qsp_session [-n count] [-r repeat] [-o file]
+//=====================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "qsp.hpp"
+#include "log.h"
+
+#define SESSION_COUNT 100000		// 每项测试的报文数量
+#define SESSION_REPEAT 5			// 每项测试的重复次数（取最快的一次）
+#define SESSION_PIPE 4096			// 数据包队列的容量
+#define SESSION_BURST 32			// burst：每轮发送的报文数量（默认发送窗口）
+
+// 单向的数据包队列（环形，预先分配）
+struct Pipe
+{
+	std::vector<char> data;
+	std::vector<int> len;
+	unsigned head, tail;
+
+	Pipe() : data((size_t)SESSION_PIPE * QSP_MTU_SIZE), len(SESSION_PIPE), head(0), tail(0) {}
+
+	int push(const char *buf, int size)
+	{
+		if (tail - head >= SESSION_PIPE || size > QSP_MTU_SIZE)
+			return size;	// 队列满：丢弃（同UDP）
+		memcpy(&data[(size_t)(tail % SESSION_PIPE) * QSP_MTU_SIZE], buf, size);
+		len[tail % SESSION_PIPE] = size;
+		tail++;
+		return size;
+	}
+
+	int pop(char *buf, int size)
+	{
+		if (head == tail)
+			return 0;
+		int n = std::min(size, len[head % SESSION_PIPE]);
+		memcpy(buf, &data[(size_t)(head % SESSION_PIPE) * QSP_MTU_SIZE], n);
+		head++;
+		return n;
+	}
+};
+
+// 计数器时钟：每轮事件循环加1毫秒
+static IUINT32 session_ticks = 0;
+
+static IUINT32 session_systime(void)
+{
+	return session_ticks;
+}
+
+struct TickClock
+{
+	static IUINT32 now() { return session_ticks; }
+};
+
+// C接口的端点：user指向它，回调函数通过函数指针调用
+struct CEndpoint
+{
+	Pipe *rx, *tx;
+};
+
+static int session_input(char *buf, int len, QSP *, void *user)
+{
+	return ((CEndpoint*)user)->rx->pop(buf, len);
+}
+
+static int session_output(const char *buf, int len, QSP *, void *user)
+{
+	return ((CEndpoint*)user)->tx->push(buf, len);
+}
+
+// Session的传输层：编译时绑定
+struct PipeTransport
+{
+	Pipe *rx, *tx;
+
+	PipeTransport(Pipe *r = NULL, Pipe *t = NULL) : rx(r), tx(t) {}
+	int recv(char *buf, int len) { return rx->pop(buf, len); }
+	int send(const char *buf, int len) { return tx->push(buf, len); }
+};
+
+typedef qsp::Session<PipeTransport, TickClock> PipeSession;
+
+static IUINT64 session_clock_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (IUINT64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// echo：返回用时（纳秒），出错返回0
+static IUINT64 session_echo_c(int size, int count)
+{
+	Pipe p01, p10;
+	CEndpoint ep[2] = { { &p10, &p01 }, { &p01, &p10 } };
+	QSP *qsp[2];
+	std::vector<char> msg(size, 'q'), buf(size);
+	int i, sent = 0, done = 0, hr;
+
+	for (i = 0; i < 2; i++)
+	{
+		qsp[i] = qsp_create(0x11223344, &ep[i]);
+		qsp_setinput(qsp[i], session_input);
+		qsp_setoutput(qsp[i], session_output);
+		qsp_setsystime(qsp[i], session_systime);
+		qsp_setnonblock(qsp[i], 1);
+	}
+
+	IUINT64 t0 = session_clock_ns();
+	while (done < count)
+	{
+		if (sent == done && qsp_send(qsp[0], &msg[0], size) == size)
+			sent++;
+		session_ticks++;
+		qsp_update(qsp[0]);
+		qsp_update(qsp[1]);
+		while ((hr = qsp_recv(qsp[1], &buf[0], size)) > 0)
+			qsp_send(qsp[1], &buf[0], hr);
+		while ((hr = qsp_recv(qsp[0], &buf[0], size)) > 0)
+			done++;
+		if (qsp_isdead(qsp[0]) || qsp_isdead(qsp[1]))
+			break;
+	}
+	IUINT64 elapsed = session_clock_ns() - t0;
+
+	qsp_release(qsp[0]);
+	qsp_release(qsp[1]);
+
+	return done == count ? elapsed : 0;
+}
+
+static IUINT64 session_echo_cpp(int size, int count)
+{
+	Pipe p01, p10;
+	PipeSession s0(0x11223344, PipeTransport(&p10, &p01)), s1(0x11223344, PipeTransport(&p01, &p10));
+	std::vector<char> msg(size, 'q'), buf(size);
+	int sent = 0, done = 0, hr;
+
+	IUINT64 t0 = session_clock_ns();
+	while (done < count)
+	{
+		if (sent == done && s0.send(msg) == size)
+			sent++;
+		session_ticks++;
+		s0.update();
+		s1.update();
+		while ((hr = s1.recv(buf)) > 0)
+			s1.send(qsp::span<const char>(&buf[0], hr));
+		while ((hr = s0.recv(buf)) > 0)
+			done++;
+		if (s0.dead() || s1.dead())
+			break;
+	}
+
+	return done == count ? session_clock_ns() - t0 : 0;
+}
+
+// burst：每轮发送SESSION_BURST个报文（不超过发送窗口），端点1全部接收
+static IUINT64 session_burst_c(int size, int count)
+{
+	Pipe p01, p10;
+	CEndpoint ep[2] = { { &p10, &p01 }, { &p01, &p10 } };
+	QSP *qsp[2];
+	std::vector<char> msg(size, 'q'), buf(size);
+	int i, sent = 0, done = 0;
+
+	for (i = 0; i < 2; i++)
+	{
+		qsp[i] = qsp_create(0x11223344, &ep[i]);
+		qsp_setinput(qsp[i], session_input);
+		qsp_setoutput(qsp[i], session_output);
+		qsp_setsystime(qsp[i], session_systime);
+		qsp_setnonblock(qsp[i], 1);
+	}
+
+	IUINT64 t0 = session_clock_ns();
+	while (done < count)
+	{
+		for (i = 0; i < SESSION_BURST && sent < count && qsp[0]->nsnd_que < qsp[0]->snd_wnd; i++)
+		{
+			if (qsp_send(qsp[0], &msg[0], size) != size)
+				break;
+			sent++;
+		}
+		session_ticks++;
+		qsp_update(qsp[0]);
+		qsp_update(qsp[1]);
+		while (qsp_recv(qsp[1], &buf[0], size) > 0)
+			done++;
+		if (qsp_isdead(qsp[0]) || qsp_isdead(qsp[1]))
+			break;
+	}
+	IUINT64 elapsed = session_clock_ns() - t0;
+
+	qsp_release(qsp[0]);
+	qsp_release(qsp[1]);
+
+	return done == count ? elapsed : 0;
+}
+
+static IUINT64 session_burst_cpp(int size, int count)
+{
+	Pipe p01, p10;
+	PipeSession s0(0x11223344, PipeTransport(&p10, &p01)), s1(0x11223344, PipeTransport(&p01, &p10));
+	std::vector<char> msg(size, 'q'), buf(size);
+	int i, sent = 0, done = 0;
+
+	IUINT64 t0 = session_clock_ns();
+	while (done < count)
+	{
+		for (i = 0; i < SESSION_BURST && sent < count && s0.native()->nsnd_que < s0.native()->snd_wnd; i++)
+		{
+			if (s0.send(msg) != size)
+				break;
+			sent++;
+		}
+		session_ticks++;
+		s0.update();
+		s1.update();
+		while (s1.recv(buf) > 0)
+			done++;
+		if (s0.dead() || s1.dead())
+			break;
+	}
+
+	return done == count ? session_clock_ns() - t0 : 0;
+}
+
+// 测试项
+struct SessionCase
+{
+	const char *name;
+	const char *api;
+	IUINT64(*run)(int size, int count);
+};
+
+static const SessionCase session_cases[] = {
+	{ "echo", "c", session_echo_c },
+	{ "echo", "session", session_echo_cpp },
+	{ "burst", "c", session_burst_c },
+	{ "burst", "session", session_burst_cpp },
+};
+
+static void session_nolog(const char *)
+{
+}
+
+int main(int argc, char *argv[])
+{
+	static const int sizes[] = { 16, 1024, 16384 };
+	const char *output = "qsp_session.json";
+	int count = SESSION_COUNT, repeat = SESSION_REPEAT, opt, first = 1;
+
+	while ((opt = getopt(argc, argv, "n:r:o:h")) != -1) {
+		switch (opt) {
+		case 'n': count = atoi(optarg) > 0 ? atoi(optarg) : SESSION_COUNT; break;
+		case 'r': repeat = atoi(optarg) > 0 ? atoi(optarg) : SESSION_REPEAT; break;
+		case 'o': output = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-n count] [-r repeat] [-o file]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	FILE *fp = strcmp(output, "-") == 0 ? stdout : fopen(output, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "cannot open %s\n", output);
+		return EXIT_FAILURE;
+	}
+
+	set_outlog(session_nolog);
+
+	fprintf(fp, "{\n\t\"version\": %d,\n\t\"results\": [", QSP_VERSION);
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	for (size_t c = 0; c < sizeof(session_cases) / sizeof(session_cases[0]); c++) {
+		const SessionCase &sc = session_cases[c];
+		int n = std::max(1, count / (sizes[s] > 1024 ? 16 : 1));
+		IUINT64 best = 0;
+
+		// 第一次运行预热（不计入）
+		sc.run(sizes[s], std::min(n, 1000));
+		for (int r = 0; r < repeat; r++) {
+			IUINT64 ns = sc.run(sizes[s], n);
+			if (ns != 0 && (best == 0 || ns < best))
+				best = ns;
+		}
+
+		fprintf(fp, "%s\n\t\t{\"name\": \"%s\", \"api\": \"%s\", \"size\": %d, \"count\": %d, \"ns_per_msg\": %.1f}",
+			first ? "" : ",", sc.name, sc.api, sizes[s], n, best ? (double)best / n : 0.0);
+		fflush(fp);
+		first = 0;
+
+		fprintf(stderr, "%-6s %-8s size=%-6d %8.1f ns/msg\n", sc.name, sc.api, sizes[s], best ? (double)best / n : 0.0);
+	}
+	fprintf(fp, "\n\t]\n}\n");
+
+	if (fp != stdout) fclose(fp);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+-- QSP报文头部解析（Wireshark Lua插件）
+-- 用法：wireshark -X lua_script:tools/qsp.lua capture.pcap
+-- 默认解析UDP端口40001 / 40002（qsp_setcapture生成的抓包），其他端口用“Decode As...”选择QSP。
+
+local qsp = Proto("qsp", "Quick Stable Protocol")
+
+local cmds = { [81] = "PUSH", [82] = "ACK", [83] = "AGAIN", [84] = "WASK", [85] = "WINS", [86] = "DGRAM", [87] = "DROP", [88] = "HELLO", [89] = "COOKIE", [90] = "PMTU" }
+local modes = { [91] = "half", [92] = "weak", [93] = "single" }
+
+local f = qsp.fields
+f.conv = ProtoField.uint32("qsp.conv", "Conv", base.HEX)
+f.frg = ProtoField.uint32("qsp.frg", "Fragment")
+f.ts = ProtoField.uint32("qsp.ts", "Timestamp")
+f.sn = ProtoField.uint32("qsp.sn", "Fragments")
+f.cmd = ProtoField.uint16("qsp.cmd", "Command", base.DEC, cmds)
+f.mode = ProtoField.uint8("qsp.mode", "Mode", base.DEC, modes)
+f.flags = ProtoField.uint8("qsp.flags", "Flags", base.HEX)
+f.zip = ProtoField.bool("qsp.flags.zip", "Compressed", 8, nil, 0x01)
+f.ver = ProtoField.uint16("qsp.ver", "Version")
+f.len = ProtoField.uint16("qsp.len", "Length")
+f.wnd = ProtoField.uint16("qsp.wnd", "Window")
+f.sid = ProtoField.uint16("qsp.sid", "Lane")
+f.msn = ProtoField.uint32("qsp.msn", "Message")
+f.ack = ProtoField.uint8("qsp.weak_ack", "Weak ACK fragment")
+f.data = ProtoField.bytes("qsp.data", "Data")
+
+-- 头部32字节，小端
+function qsp.dissector(buf, pinfo, tree)
+	pinfo.cols.protocol = "QSP"
+	local t = tree:add(qsp, buf())
+
+	if buf:len() == 1 then
+		t:add(f.ack, buf(0, 1))
+		pinfo.cols.info = "WEAK ACK frg=" .. buf(0, 1):uint()
+		return
+	end
+	if buf:len() < 32 then
+		return
+	end
+
+	t:add_le(f.conv, buf(0, 4))
+	t:add_le(f.frg, buf(4, 4))
+	t:add_le(f.ts, buf(8, 4))
+	t:add_le(f.sn, buf(12, 4))
+	t:add_le(f.cmd, buf(16, 2))
+	t:add(f.mode, buf(18, 1))
+	local ft = t:add(f.flags, buf(19, 1))
+	ft:add(f.zip, buf(19, 1))
+	t:add_le(f.ver, buf(20, 2))
+	t:add_le(f.len, buf(22, 2))
+	t:add_le(f.wnd, buf(24, 2))
+	t:add_le(f.sid, buf(26, 2))
+	t:add_le(f.msn, buf(28, 4))
+	if buf:len() > 32 then
+		t:add(f.data, buf(32))
+	end
+
+	local cmd = buf(16, 2):le_uint()
+	pinfo.cols.info = string.format("%s sid=%d msn=%d frg=%d/%d len=%d wnd=%d",
+		cmds[cmd] or tostring(cmd), buf(26, 2):le_uint(), buf(28, 4):le_uint(),
+		buf(4, 4):le_uint(), buf(12, 4):le_uint(), buf(22, 2):le_uint(), buf(24, 2):le_uint())
+end
+
+local udp = DissectorTable.get("udp.port")
+udp:add(40001, qsp)
+udp:add(40002, qsp)
@@ -0,0 +1,51 @@
+//=====================================================================
+// QSP抓包文件解析（qsp_setcapture输出的pcap文件 -> 文本）
+//=====================================================================
+// 每行一个数据包：时间（毫秒，相对第一个数据包）、方向、长度、报文头部，
+// 最后输出各方向的数据包数量与字节数。
+//
+// 编译：
+//	gcc -O2 -IQSP tools/qsp_pcap.c QSP/capture.c QSP/network.c QSP/log.c QSP/systime.c -o qsp_pcap -lpthread
+// 用法：
+//	qsp_pcap file
+//=====================================================================
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "capture.h"
+#include "qsp.h"
+
+int main(int argc, char *argv[])
+{
+	static char buf[ICAP_SNAPLEN];
+	char text[256];
+	IUINT64 us, first = 0, count[2] = { 0, 0 }, bytes[2] = { 0, 0 };
+	ICAPTURE *cap;
+	int dir, len;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s file\n", argv[0]);
+		return 1;
+	}
+
+	cap = icap_open(argv[1]);
+	if (cap == NULL) {
+		fprintf(stderr, "open %s failed\n", argv[1]);
+		return 1;
+	}
+
+	while ((len = icap_read(cap, &dir, buf, sizeof(buf), &us)) > 0) {
+		if (cap->count == 1) first = us;
+		icap_dissect(buf, len, text, sizeof(text));
+		printf("%12.3f %s %5d %s\n", (double)(us - first) / 1000, dir == ICAP_OUT ? "->" : "<-", len, text);
+		count[dir]++;
+		bytes[dir] += len;
+	}
+
+	fprintf(stderr, "out %llu packets %llu bytes, in %llu packets %llu bytes%s\n",
+		(unsigned long long)count[ICAP_OUT], (unsigned long long)bytes[ICAP_OUT],
+		(unsigned long long)count[ICAP_IN], (unsigned long long)bytes[ICAP_IN], len < 0 ? " (read error)" : "");
+
+	icap_close(cap);
+	return len < 0 ? 1 : 0;
+}
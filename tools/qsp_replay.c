@@ -0,0 +1,213 @@
+//=====================================================================
+// QSP抓包回放（qsp_setcapture输出的pcap文件）
+//=====================================================================
+// 把抓包中本端接收的数据包按原来的时间顺序输入新的QSP会话，时钟为
+// 虚拟时钟（跳到下一个数据包的时间），不等待真实时间，按CPU的速度
+// 执行。会话编号、通信模式、流模式从抓包中取得（抓包要从会话开始）。输出：
+//	交付的报文数量 / 字节数 / 校验和（相同的抓包与协议实现结果相同）
+//	会话产生的数据包数量（与抓包中本端发送的数据包数量对比）
+//	每秒处理的数据包数量
+//
+// 编译：
+//	gcc -O2 -IQSP tools/qsp_replay.c QSP/qsp.c QSP/capture.c QSP/cookie.c QSP/aead.c QSP/compress.c QSP/network.c QSP/log.c QSP/systime.c
+//		QSP/histogram.c QSP/trace.c -o qsp_replay -lpthread
+// 用法：
+//	qsp_replay [-n loops] [-w rcv_wnd] file
+//=====================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qsp.h"
+#include "systime.h"
+
+// 抓包中本端接收的数据包
+typedef struct REPLAYPKT
+{
+	IUINT32 ts;				// 时间（毫秒，相对第一个数据包）
+	int len;
+	char *data;
+} REPLAYPKT;
+
+static REPLAYPKT *replay_pkts = NULL;
+static int replay_count = 0, replay_next = 0;
+static IUINT32 replay_now = 0;
+static IUINT64 replay_out = 0;
+
+static IUINT32 replay_systime(void)
+{
+	return replay_now;
+}
+
+// 输入时间已经到达的下一个数据包
+static int replay_input(char *buf, int len, QSP *qsp, void *user)
+{
+	REPLAYPKT *pkt = &replay_pkts[replay_next];
+
+	(void)qsp;
+	(void)user;
+
+	if (replay_next >= replay_count || pkt->ts > replay_now)
+		return 0;
+	if (pkt->len > len)
+		return -1;
+
+	memcpy(buf, pkt->data, pkt->len);
+	replay_next++;
+	return pkt->len;
+}
+
+static int replay_output(const char *buf, int len, QSP *qsp, void *user)
+{
+	(void)buf;
+	(void)qsp;
+	(void)user;
+
+	replay_out++;
+	return len;
+}
+
+static void replay_nolog(const char *log)
+{
+	(void)log;
+}
+
+int main(int argc, char *argv[])
+{
+	static char buf[ICAP_SNAPLEN];
+	const char *path = NULL;
+	IUINT64 us, first = 0, captured_out = 0;
+	IUINT32 conv = 0, mode = 0, stream = 0;
+	int loops = 1, rcv_wnd = QSP_WND_MAX, maxlen = 0, dir, len, i;
+	ICAPTURE *cap;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) loops = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) rcv_wnd = atoi(argv[++i]);
+		else path = argv[i];
+	}
+	if (path == NULL || loops <= 0) {
+		fprintf(stderr, "usage: %s [-n loops] [-w rcv_wnd] file\n", argv[0]);
+		return 1;
+	}
+
+	cap = icap_open(path);
+	if (cap == NULL) {
+		fprintf(stderr, "open %s failed\n", path);
+		return 1;
+	}
+
+	// 读取本端接收的数据包，取得会话参数
+	while ((len = icap_read(cap, &dir, buf, sizeof(buf), &us)) > 0) {
+		if (cap->count == 1) first = us;
+		if (dir == ICAP_OUT) {
+			captured_out++;
+			continue;
+		}
+
+		if (len == 1 && mode == 0) mode = QSP_MODE_WEAK;
+		if (len >= (int)QSP_HEAD_SIZE) {
+			QSPSEG seg;
+			const char *p = buf;
+			p = qsp_decode32u(p, &seg.conv);
+			p = qsp_decode32u(p, &seg.frg);
+			p = qsp_decode32u(p, &seg.ts);
+			p = qsp_decode32u(p, &seg.sn);
+			p = qsp_decode16u(p, &seg.cmd);
+			p = qsp_decode8u(p, &seg.mode);
+			if (conv == 0) conv = seg.conv;
+			if (mode == 0 || mode == QSP_MODE_WEAK) mode = seg.mode;
+			if (seg.cmd == QSP_CMD_PUSH && seg.sn == QSP_STREAM_SN) stream = 1;
+		}
+
+		replay_pkts = (REPLAYPKT*)realloc(replay_pkts, sizeof(REPLAYPKT) * (replay_count + 1));
+		replay_pkts[replay_count].ts = (IUINT32)((us - first) / 1000);
+		replay_pkts[replay_count].len = len;
+		if (len > maxlen) maxlen = len;
+		replay_pkts[replay_count].data = (char*)malloc(len);
+		memcpy(replay_pkts[replay_count].data, buf, len);
+		replay_count++;
+	}
+	icap_close(cap);
+
+	if (len < 0 || replay_count == 0) {
+		fprintf(stderr, "%s has no input packets\n", path);
+		return 1;
+	}
+
+	set_outlog(replay_nolog);
+
+	{
+		IUINT64 delivered = 0, bytes = 0, sum = 0xcbf29ce484222325ULL;
+		int msgsize = QSP_BUF_SIZE;
+		char *msg = (char*)malloc(msgsize);
+		IINT64 t0 = iclock64();
+		clock_t cpu = clock();
+		int loop;
+
+		for (loop = 0; loop < loops; loop++) {
+			QSP *qsp = qsp_create(conv, NULL);
+			qsp_setinput(qsp, replay_input);
+			qsp_setoutput(qsp, replay_output);
+			qsp_setsystime(qsp, replay_systime);
+			qsp_setmode(qsp, mode ? mode : QSP_MODE_HALF);
+			qsp_setstream(qsp, (int)stream);
+			qsp_setnonblock(qsp, 1);
+			qsp_wndsize(qsp, QSP_SND_WND, rcv_wnd);
+			if (maxlen > QSP_MTU_SIZE)
+				qsp_setmtu(qsp, maxlen < QSP_MTU_MAX ? maxlen : QSP_MTU_MAX);	// 抓包中有更大的数据包（调整过MTU的会话）
+
+			replay_next = 0;
+			replay_now = 0;
+			replay_out = 0;
+			delivered = bytes = 0;
+			sum = 0xcbf29ce484222325ULL;
+
+			while (1) {
+				int hr;
+				if (replay_next < replay_count && replay_pkts[replay_next].ts > replay_now)
+					replay_now = replay_pkts[replay_next].ts;
+
+				qsp_update(qsp);
+
+				while ((hr = qsp_peeksize(qsp)) > 0) {
+					if (hr > msgsize) {
+						msgsize = hr;
+						msg = (char*)realloc(msg, msgsize);
+					}
+					hr = qsp_recv(qsp, msg, msgsize);
+					if (hr <= 0)
+						break;
+					delivered++;
+					bytes += hr;
+					for (i = 0; i < hr; i++)
+						sum = (sum ^ (unsigned char)msg[i]) * 0x100000001b3ULL;
+				}
+
+				if (replay_next >= replay_count)
+					break;
+			}
+
+			qsp_release(qsp);
+		}
+
+		{
+			double sec = (double)(clock() - cpu) / CLOCKS_PER_SEC;
+			printf("conv 0x%08X mode %u %s, %d input packets over %u ms\n", conv, mode,
+				stream ? "stream" : "message", replay_count, replay_pkts[replay_count - 1].ts);
+			printf("delivered %llu messages %llu bytes checksum %016llx\n",
+				(unsigned long long)delivered, (unsigned long long)bytes, (unsigned long long)sum);
+			printf("output %llu packets (captured %llu)\n", (unsigned long long)replay_out, (unsigned long long)captured_out);
+			printf("%d loops in %.3f s cpu (%lld ms wall), %.0f packets/s\n", loops, sec,
+				(long long)(iclock64() - t0), sec > 0 ? (double)replay_count * loops / sec : 0.0);
+		}
+
+		free(msg);
+	}
+
+	for (i = 0; i < replay_count; i++)
+		free(replay_pkts[i].data);
+	free(replay_pkts);
+	return 0;
+}
@@ -0,0 +1,89 @@
+//=====================================================================
+// QSP跟踪文件解码（itrace_dump输出的二进制文件 -> 文本）
+//=====================================================================
+// 合并所有线程的记录，按时间排序输出，每行一条记录：
+//	时间（微秒，相对开始跟踪）	线程	会话	逻辑流	事件	报文序号	片段序号	长度
+// -s只输出各事件的数量。
+//
+// 编译：
+//	gcc -O2 -IQSP tools/qsp_trace.c QSP/trace.c QSP/log.c QSP/systime.c -o qsp_trace -lpthread
+// 用法：
+//	qsp_trace [-s] file
+//=====================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+static int trace_compare(const void *a, const void *b)
+{
+	const ITRACEREC *x = (const ITRACEREC*)a;
+	const ITRACEREC *y = (const ITRACEREC*)b;
+
+	if (x->ts != y->ts) return x->ts < y->ts ? -1 : 1;
+	if (x->tid != y->tid) return x->tid < y->tid ? -1 : 1;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	ITRACEHDR hdr;
+	ITRACEREC *rec;
+	IUINT64 count[ITRACE_EVENT_NUM];
+	const char *path = NULL;
+	int summary = 0;
+	IUINT32 i, n;
+	FILE *fp;
+
+	for (i = 1; i < (IUINT32)argc; i++) {
+		if (strcmp(argv[i], "-s") == 0) summary = 1;
+		else path = argv[i];
+	}
+	if (path == NULL) {
+		fprintf(stderr, "usage: %s [-s] file\n", argv[0]);
+		return 1;
+	}
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "open %s failed\n", path);
+		return 1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != ITRACE_MAGIC ||
+		hdr.version != ITRACE_VERSION || hdr.recsize != sizeof(ITRACEREC)) {
+		fprintf(stderr, "%s is not a trace file (version %d)\n", path, ITRACE_VERSION);
+		fclose(fp);
+		return 1;
+	}
+
+	rec = (ITRACEREC*)malloc(sizeof(ITRACEREC) * (hdr.count + 1));
+	n = (IUINT32)fread(rec, sizeof(ITRACEREC), hdr.count, fp);
+	fclose(fp);
+	if (n != hdr.count)
+		fprintf(stderr, "warning, file is truncated (%u/%u records)\n", n, hdr.count);
+
+	qsort(rec, n, sizeof(ITRACEREC), trace_compare);
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < n; i++) {
+		if (rec[i].event < ITRACE_EVENT_NUM)
+			count[rec[i].event]++;
+		if (summary)
+			continue;
+		printf("%14.3f\tt%u\t0x%08X\t%u\t%-10s\t%u\t%u\t%d\n",
+			hdr.tick_hz ? (double)(IINT64)(rec[i].ts - hdr.tick_base) * 1000000.0 / hdr.tick_hz : 0.0,
+			rec[i].tid, rec[i].conv, rec[i].sid, itrace_name(rec[i].event),
+			rec[i].msn, rec[i].frg, (int)rec[i].len);
+	}
+
+	fprintf(summary ? stdout : stderr, "records %u, overwritten %u, tick %llu Hz\n",
+		n, hdr.dropped, (unsigned long long)hdr.tick_hz);
+	for (i = 1; i < ITRACE_EVENT_NUM; i++) {
+		if (count[i])
+			fprintf(summary ? stdout : stderr, "  %-10s %llu\n", itrace_name(i), (unsigned long long)count[i]);
+	}
+
+	free(rec);
+	return 0;
+}